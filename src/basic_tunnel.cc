@@ -24,26 +24,53 @@
 #include "rtc_base/third_party/base64/base64.h"
 #include "tincan_control.h"
 #include "buffer_pool.h"
+#include "rtc_base/event.h"
 
 namespace tincan
 {
     extern BufferPool<Iob> bp;
     BasicTunnel::BasicTunnel(
         unique_ptr<TunnelDesc> descriptor,
-        shared_ptr<ControllerCommsChannel> ctrl_handle) : descriptor_(std::move(descriptor)),
-                                                          ctrl_link_(ctrl_handle),
-                                                          worker_(make_unique<rtc::Thread>(rtc::SocketServer::CreateDefault())),
-                                                          tdev_(make_shared<TapDev>())
+        shared_ptr<ControllerCommsChannel> ctrl_handle,
+        shared_ptr<NetworkThreadPool> thread_pool,
+        shared_ptr<NetworkResources> net_resources,
+        shared_ptr<IdentityPool> identity_pool) : descriptor_(std::move(descriptor)),
+                                                  ctrl_link_(ctrl_handle),
+                                                  thread_pool_(thread_pool),
+                                                  net_resources_(net_resources),
+                                                  identity_pool_(identity_pool),
+                                                  worker_(thread_pool_->Acquire(descriptor_->uid)),
+                                                  tdev_(make_shared<TapDev>()),
+                                                  pool_gen_(0),
+                                                  park_gen_(0),
+                                                  timer_guard_(make_shared<bool>(true))
     {
     }
 
     BasicTunnel::~BasicTunnel()
     {
+        // The network thread is shared with other tunnels, drain the tasks
+        // already posted for this one before tearing it down.
+        rtc::Event flushed;
+        NetworkThread()->PostTask(RTC_FROM_HERE, [&flushed]()
+                                  { flushed.Set(); });
+        flushed.Wait(rtc::Event::kForever);
         if (vlink_)
         {
             NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this]()
                                           {vlink_->Disconnect(); vlink_.reset(); });
         }
+        NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this]()
+                                      {
+                                          if (parked_vlink_)
+                                          {
+                                              parked_vlink_->Disconnect();
+                                              parked_vlink_.reset();
+                                          }
+                                          timer_guard_.reset();
+                                          pool_allocator_.reset();
+                                          pool_net_manager_.reset(); });
+        thread_pool_->Release(worker_);
     }
 
     int BasicTunnel::Configure(
@@ -52,10 +79,15 @@ namespace tincan
         tap_desc_ = std::move(tap_desc);
         if (tdev_->Open(*tap_desc_.get()) == -1)
             return -1;
+        if (descriptor_->mss_clamp)
+        {
+            const uint32_t mtu = descriptor_->mss_clamp_mtu ? descriptor_->mss_clamp_mtu : tap_desc_->mtu;
+            mss_clamper_ = make_shared<MssClamper>(mtu);
+        }
 
-        // create X509 identity for secure connections
-        string sslid_name = descriptor_->node_id + descriptor_->uid;
-        sslid_ = rtc::SSLIdentity::Create(sslid_name, rtc::KT_RSA);
+        // take a pre-generated X509 identity for secure connections
+        rtc::KeyType key_type = descriptor_->key_type == "ECDSA" ? rtc::KT_ECDSA : rtc::KT_RSA;
+        sslid_ = identity_pool_->Get(key_type);
         if (!sslid_)
         {
             RTC_LOG(LS_ERROR) << "Failed to generate SSL Identity";
@@ -74,44 +106,174 @@ namespace tincan
     {
         tdev_->read_completion = [this](Iob &&iob)
         { TapReadComplete(std::move(iob)); };
+        tdev_->read_batch_complete = [this]()
+        { TapBatchComplete(); };
         // TD<decltype(tdev_->read_completion)> td;
+        if (descriptor_->pre_gather)
+        {
+            NetworkThread()->PostTask(RTC_FROM_HERE, [this]()
+                                      { PreGather(); });
+        }
+    }
+
+    /* Starts gathering host, srflx and relay candidates into a pooled
+    allocator session before any vlink exists. The next vlink takes the
+    session over and answers CreateLink with the candidates already
+    gathered. Runs on the network thread.
+    */
+    void BasicTunnel::PreGather()
+    {
+        VlinkDescriptor vlink_desc;
+        vlink_desc.stun_servers.assign(descriptor_->stun_servers.begin(),
+                                       descriptor_->stun_servers.end());
+        vlink_desc.turn_descs.assign(descriptor_->turn_descs.begin(),
+                                     descriptor_->turn_descs.end());
+        vlink_desc.socket_options = descriptor_->socket_options;
+        pool_allocator_.reset();
+        pool_net_manager_ = net_resources_->NetworkManager(
+            NetworkThread(), descriptor_->ignored_net_interfaces);
+        pool_allocator_ = VirtualLink::CreatePortAllocator(
+            *net_resources_, NetworkThread(), pool_net_manager_.get(),
+            vlink_desc, kCandidatePoolSize);
+        ScheduleCandidatePoolRefresh(++pool_gen_);
+    }
+
+    void BasicTunnel::ScheduleCandidatePoolRefresh(
+        uint32_t pool_gen)
+    {
+        weak_ptr<bool> guard = timer_guard_;
+        NetworkThread()->PostDelayedTask(
+            RTC_FROM_HERE, [this, guard, pool_gen]()
+            {
+                // stop once the tunnel is gone, the pool was claimed, or a
+                // newer pre-gather replaced this one
+                if (guard.expired() || !pool_allocator_ || pool_gen != pool_gen_)
+                    return;
+                PreGather(); },
+            kCandidatePoolRefreshInterval);
+    }
+
+    void BasicTunnel::ParkVlink()
+    {
+        if (parked_vlink_)
+        {
+            parked_vlink_->Disconnect();
+            parked_vlink_.reset();
+        }
+        // keep the ICE/DTLS state but stop delivering its frames and
+        // reporting link events for it
+        vlink_->SignalMessageReceived.disconnect(this);
+        vlink_->SignalLinkUp.disconnect(this);
+        vlink_->SignalLinkDown.disconnect(this);
+        vlink_->SignalLocalCasUpdated.disconnect(this);
+        parked_vlink_ = std::move(vlink_);
+        RTC_LOG(LS_INFO) << "Parked vlink " << parked_vlink_->Id() << " to peer "
+                         << parked_vlink_->PeerInfo().uid << " for "
+                         << descriptor_->link_resume_window << " s";
+        weak_ptr<bool> guard = timer_guard_;
+        const uint32_t park_gen = ++park_gen_;
+        NetworkThread()->PostDelayedTask(
+            RTC_FROM_HERE, [this, guard, park_gen]()
+            {
+                if (guard.expired() || !parked_vlink_ || park_gen != park_gen_)
+                    return;
+                RTC_LOG(LS_INFO) << "Resume window expired for vlink " << parked_vlink_->Id();
+                parked_vlink_->Disconnect();
+                parked_vlink_.reset(); },
+            descriptor_->link_resume_window * 1000);
+    }
+
+    bool BasicTunnel::ResumeVlink(
+        const PeerDescriptor &peer_desc,
+        const VlinkDescriptor &vlink_desc,
+        cricket::IceRole ice_role)
+    {
+        // anything else than the same setup with the same peer starts over
+        if (!parked_vlink_->CanResume(peer_desc, vlink_desc, ice_role))
+        {
+            parked_vlink_->Disconnect();
+            parked_vlink_.reset();
+            return false;
+        }
+        vlink_ = std::move(parked_vlink_);
+        vlink_->SignalMessageReceived.connect(this, &BasicTunnel::VlinkReadComplete);
+        vlink_->SignalLinkUp.connect(this, &BasicTunnel::OnVLinkUp);
+        vlink_->SignalLinkDown.connect(this, &BasicTunnel::OnVLinkDown);
+        vlink_->SignalLocalCasUpdated.connect(this, &BasicTunnel::OnVLinkCasUpdated);
+        vlink_->Resume();
+        // a writable link will not fire SignalLinkUp again, one that flapped
+        // does once ICE recovers it
+        if (vlink_->IsReady())
+        {
+            weak_ptr<bool> guard = timer_guard_;
+            const string vlink_id = vlink_->Id();
+            NetworkThread()->PostTask(RTC_FROM_HERE, [this, guard, vlink_id]()
+                                      {
+                                          if (!guard.expired() && vlink_)
+                                              OnVLinkUp(vlink_id); });
+        }
+        return true;
     }
 
     rtc::Thread *BasicTunnel::SignalThread()
     {
-        return worker_.get();
+        return worker_;
     }
 
     rtc::Thread *BasicTunnel::NetworkThread()
     {
-        return worker_.get();
+        return worker_;
     }
 
     weak_ptr<VirtualLink>
     BasicTunnel::CreateVlink(
-        unique_ptr<PeerDescriptor> peer_desc, bool role, const vector<string> &ignored_list)
+        unique_ptr<VlinkDescriptor> vlink_desc,
+        unique_ptr<PeerDescriptor> peer_desc, bool role)
     {
+        const cricket::IceRole ice_role = role ? cricket::ICEROLE_CONTROLLED : cricket::ICEROLE_CONTROLLING;
+        // a batch is never larger than the biggest frame the TAP emits,
+        // so batching does not push records past the configured MTU
+        if (vlink_desc->options.batch_limit == 0 && tap_desc_)
+            vlink_desc->options.batch_limit = tap_desc_->mtu + kEthernetHeaderSz;
+        if (!vlink_ && parked_vlink_)
+        {
+            bool resumed = false;
+            NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &resumed, &peer_desc, &vlink_desc, ice_role]()
+                                          { resumed = ResumeVlink(*peer_desc, *vlink_desc, ice_role); });
+            if (resumed)
+                return vlink_;
+        }
         if (!vlink_)
         {
-            unique_ptr<VlinkDescriptor> vlink_desc = make_unique<VlinkDescriptor>();
+            const webrtc::PortPrunePolicy prune_policy = vlink_desc->ice_profile.prune_policy;
             vlink_desc->uid = descriptor_->uid;
             vlink_desc->stun_servers.assign(descriptor_->stun_servers.begin(),
                                             descriptor_->stun_servers.end());
 
             vlink_desc->turn_descs.assign(descriptor_->turn_descs.begin(),
                                           descriptor_->turn_descs.end());
-            NetworkThread()->SetName("NetworkThread", this);
-            NetworkThread()->Start();
+            vlink_desc->socket_options = descriptor_->socket_options;
+            if (tdev_)
+                vlink_desc->local_mac = tdev_->MacAddress();
+            vlink_desc->mss_clamper = mss_clamper_;
             vlink_ = make_unique<VirtualLink>(
-                std::move(vlink_desc), std::move(peer_desc), SignalThread(), NetworkThread());
+                std::move(vlink_desc), std::move(peer_desc), SignalThread(), NetworkThread(),
+                net_resources_);
             unique_ptr<SSLIdentity> sslid_copy(sslid_->Clone());
+            unique_ptr<cricket::PortAllocator> port_allocator;
+            NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &port_allocator, prune_policy]()
+                                          {
+                                              if (pool_allocator_ && pool_allocator_->turn_port_prune_policy() == prune_policy)
+                                                  port_allocator = std::move(pool_allocator_); });
             vlink_->Initialize(std::move(sslid_copy),
                                make_unique<rtc::SSLFingerprint>(*local_fingerprint_.get()),
-                               role ? cricket::ICEROLE_CONTROLLED : cricket::ICEROLE_CONTROLLING,
-                               ignored_list);
+                               ice_role,
+                               descriptor_->ignored_net_interfaces,
+                               std::move(port_allocator));
             vlink_->SignalMessageReceived.connect(this, &BasicTunnel::VlinkReadComplete);
             vlink_->SignalLinkUp.connect(this, &BasicTunnel::OnVLinkUp);
             vlink_->SignalLinkDown.connect(this, &BasicTunnel::OnVLinkDown);
+            vlink_->SignalLocalCasUpdated.connect(this, &BasicTunnel::OnVLinkCasUpdated);
         }
         return vlink_;
     }
@@ -127,6 +289,27 @@ namespace tincan
         }
     }
 
+    void BasicTunnel::PeerCandidates(
+        const string &peer_cas)
+    {
+        if (!vlink_)
+            return;
+        NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &peer_cas]()
+                                      { vlink_->PeerCandidates(peer_cas); });
+    }
+
+    bool BasicTunnel::IceRestart(
+        const string &peer_cas,
+        uint64_t cas_ready_id)
+    {
+        if (!vlink_)
+            throw TCEXCEPT("No vlink exists to restart");
+        bool restarted = false;
+        NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &peer_cas, cas_ready_id, &restarted]()
+                                      { restarted = vlink_->IceRestart(peer_cas, cas_ready_id); });
+        return restarted;
+    }
+
     void BasicTunnel::QueryInfo(
         Json::Value &tnl_info)
     {
@@ -139,6 +322,8 @@ namespace tincan
         {
             tnl_info["LinkIds"].append(vlink_->Id());
         }
+        if (mss_clamper_)
+            mss_clamper_->QueryInfo(tnl_info["MssClamp"]);
     }
 
     void BasicTunnel::QueryLinkCas(
@@ -171,10 +356,14 @@ namespace tincan
                 vlink_info[TincanControl::IceRole] = TincanControl::Controlling;
             else
                 vlink_info[TincanControl::IceRole] = TincanControl::Controlled;
+            NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &vlink_info]()
+                                          { vlink_->GetSetupInfo(vlink_info); });
             if (vlink_->IsReady())
             {
-                NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &info = vlink_info[TincanControl::Stats]]()
-                                              { vlink_->GetStats(info); });
+                NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, &vlink_info]()
+                                              {
+                                                  vlink_->GetStats(vlink_info[TincanControl::Stats]);
+                                                  vlink_->GetDatapathInfo(vlink_info["Datapath"]); });
                 vlink_info[TincanControl::Status] = "ONLINE";
             }
             else
@@ -195,20 +384,61 @@ namespace tincan
         if (vlink_)
         {
             NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this]()
-                                          { vlink_->Disconnect(); vlink_.reset(); });
+                                          {
+                                              if (descriptor_->link_resume_window > 0 && vlink_->HasConnected())
+                                              {
+                                                  ParkVlink();
+                                              }
+                                              else
+                                              {
+                                                  vlink_->Disconnect();
+                                                  vlink_.reset();
+                                              }
+                                              if (descriptor_->pre_gather && !pool_allocator_)
+                                                  PreGather(); });
         }
     }
 
+    void
+    BasicTunnel::SetLinkRate(
+        uint64_t rate,
+        size_t burst)
+    {
+        if (!vlink_)
+            throw TCEXCEPT("The tunnel has no vlink to shape");
+        NetworkThread()->Invoke<void>(RTC_FROM_HERE, [this, rate, burst]()
+                                      { vlink_->SetRate(rate, burst); });
+    }
+
     void BasicTunnel::VlinkReadComplete(
         const char *data,
         size_t data_len)
     {
-        auto frame = bp.get();
-        frame.data(data, data_len);
-        // tdev_->QueueWrite(std::move(frame));
+        if (mss_clamper_ && MssClamper::IsSyn(data, data_len))
+        {
+            // only a SYN is copied to be rewritten
+            auto frame = bp.get();
+            frame.data(data, data_len);
+            mss_clamper_->Clamp(frame.buf(), frame.size(), MssClamper::kIngress);
+            tdev_->WriteDirect(frame.data(), frame.size());
+            bp.put(std::move(frame));
+            return;
+        }
         tdev_->WriteDirect(data, data_len);
     }
 
+    void BasicTunnel::TapBatchComplete()
+    {
+        // a queued link flushes its batch after each drain
+        if (!vlink_ || vlink_->EgressQueued())
+            return;
+        // queued behind the frames of the burst
+        NetworkThread()->PostTask(RTC_FROM_HERE, [this]()
+                                  {
+                                      if (vlink_)
+                                          vlink_->FlushBatch(); });
+    }
+
     void BasicTunnel::TapReadComplete(
         Iob &&iob)
     {
@@ -218,12 +448,20 @@ namespace tincan
             bp.put(std::move(iob));
             return;
         }
-        if (NetworkThread()->IsCurrent())
+        if (mss_clamper_)
+            mss_clamper_->Clamp(iob.buf(), iob.size(), MssClamper::kEgress);
+        if (vlink_->EgressQueued())
+            vlink_->Enqueue(std::move(iob));
+        else if (NetworkThread()->IsCurrent())
             vlink_->Transmit(std::move(iob));
         else
         {
             NetworkThread()->PostTask(RTC_FROM_HERE, [this, riob = std::move(iob)]() mutable
-                                      { vlink_->Transmit(std::move(riob)); });
+                                      {
+                                          if (vlink_)
+                                              vlink_->Transmit(std::move(riob));
+                                          else
+                                              bp.put(std::move(riob)); });
         }
     }
 
@@ -254,6 +492,23 @@ namespace tincan
         ctrl_link_->Deliver(std::move(ctrl));
     }
 
+    void
+    BasicTunnel::OnVLinkCasUpdated(
+        string vlink_id,
+        string lcas,
+        bool complete)
+    {
+        unique_ptr<TincanControl> ctrl = make_unique<TincanControl>();
+        ctrl->SetControlType(TincanControl::CTTincanRequest);
+        Json::Value &req = ctrl->GetRequest();
+        req[TincanControl::Command] = TincanControl::LinkCasUpdated;
+        req[TincanControl::TunnelId] = descriptor_->uid;
+        req[TincanControl::LinkId] = vlink_id;
+        req[TincanControl::CAS] = lcas;
+        req[TincanControl::GatheringComplete] = complete;
+        ctrl_link_->Deliver(std::move(ctrl));
+    }
+
     TunnelDesc &
     BasicTunnel::Descriptor()
     {
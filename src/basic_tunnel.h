@@ -31,6 +31,8 @@
 #include "tunnel_descriptor.h"
 #include "virtual_link.h"
 #include "controller_comms.h"
+#include "identity_pool.h"
+#include "network_thread_pool.h"
 namespace tincan
 {
     class BasicTunnel : public sigslot::has_slots<>
@@ -39,7 +41,10 @@ namespace tincan
         BasicTunnel()=delete;
         BasicTunnel(
             unique_ptr<TunnelDesc> descriptor,
-            shared_ptr<ControllerCommsChannel> ctrl_handle);
+            shared_ptr<ControllerCommsChannel> ctrl_handle,
+            shared_ptr<NetworkThreadPool> thread_pool,
+            shared_ptr<NetworkResources> net_resources,
+            shared_ptr<IdentityPool> identity_pool);
         BasicTunnel(const BasicTunnel &)=delete;
         BasicTunnel& operator=(const BasicTunnel &)=delete;
         BasicTunnel(BasicTunnel &&rhs);
@@ -50,8 +55,8 @@ namespace tincan
             unique_ptr<TapDescriptor> tap_desc);
 
         weak_ptr<VirtualLink> CreateVlink(
-            unique_ptr<PeerDescriptor> peer_desc, bool role,
-            const vector<string> &ignored_list);
+            unique_ptr<VlinkDescriptor> vlink_desc,
+            unique_ptr<PeerDescriptor> peer_desc, bool role);
 
         TunnelDesc &Descriptor();
 
@@ -63,6 +68,13 @@ namespace tincan
 
         void StartConnections();
 
+        void PeerCandidates(
+            const string &peer_cas);
+
+        bool IceRestart(
+            const string &peer_cas,
+            uint64_t cas_ready_id);
+
         shared_ptr<EpollChannel> TapChannel() { return tdev_; }
 
         void QueryInfo(
@@ -80,6 +92,11 @@ namespace tincan
         void Start();
 
         void RemoveLink();
+
+        // Shapes the vlink egress, a rate of 0 removes the limit.
+        void SetLinkRate(
+            uint64_t rate,
+            size_t burst);
         //
         void VlinkReadComplete(
             const char *data,
@@ -88,6 +105,8 @@ namespace tincan
         void TapReadComplete(
             Iob&& iob);
 
+        void TapBatchComplete();
+
         weak_ptr<VirtualLink> Vlink() { return vlink_; }
 
     private:
@@ -98,17 +117,49 @@ namespace tincan
         void OnVLinkDown(
             string vlink_id);
 
+        void OnVLinkCasUpdated(
+            string vlink_id,
+            string lcas,
+            bool complete);
+
+        void PreGather();
+
+        void ScheduleCandidatePoolRefresh(
+            uint32_t pool_gen);
+
+        void ParkVlink();
+
+        bool ResumeVlink(
+            const PeerDescriptor &peer_desc,
+            const VlinkDescriptor &vlink_desc,
+            cricket::IceRole ice_role);
+
         rtc::Thread *SignalThread();
         rtc::Thread *NetworkThread();
 
+        static const int kCandidatePoolSize = 1;
+        static const uint32_t kCandidatePoolRefreshInterval = 60000;
+
         unique_ptr<TapDescriptor> tap_desc_;
         unique_ptr<TunnelDesc> descriptor_;
         shared_ptr<ControllerCommsChannel> ctrl_link_;
         unique_ptr<rtc::SSLIdentity> sslid_;
         unique_ptr<rtc::SSLFingerprint> local_fingerprint_;
-        unique_ptr<rtc::Thread>worker_;
+        shared_ptr<NetworkThreadPool> thread_pool_;
+        shared_ptr<NetworkResources> net_resources_;
+        shared_ptr<IdentityPool> identity_pool_;
+        rtc::Thread *worker_;
         shared_ptr<TapDev> tdev_;
         shared_ptr<VirtualLink> vlink_;
+        // pre-gathered candidates waiting to be claimed by the next vlink
+        shared_ptr<rtc::BasicNetworkManager> pool_net_manager_;
+        unique_ptr<cricket::PortAllocator> pool_allocator_;
+        uint32_t pool_gen_;
+        // a removed but still connected vlink, kept for a quick reconnect
+        shared_ptr<VirtualLink> parked_vlink_;
+        uint32_t park_gen_;
+        shared_ptr<bool> timer_guard_;
+        shared_ptr<MssClamper> mss_clamper_;
     };
 } // namespace tincan
 #endif // BASIC_TUNNEL_H_
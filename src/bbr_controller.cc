@@ -0,0 +1,309 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "bbr_controller.h"
+namespace tincan
+{
+    namespace
+    {
+        // 2/ln(2), the least gain that doubles the delivery rate each round
+        const double kHighGain = 2.885;
+        const double kCycleGains[] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+        const size_t kCycleLen = sizeof(kCycleGains) / sizeof(kCycleGains[0]);
+        // the bandwidth must grow by this much a round while filling the pipe
+        const double kFullBwGrowth = 1.25;
+        const int kFullBwRounds = 3;
+        // assumed until the first RTT sample
+        const int64_t kInitialRttUs = 100000;
+    } // namespace
+
+    BbrController::BbrController() : ping_id_(0),
+                                     first_ping_us_(0),
+                                     tx_bytes_(0),
+                                     delivered_(0),
+                                     lost_(0),
+                                     have_feedback_(false),
+                                     last_feedback_us_(0),
+                                     last_rx_bytes_(0),
+                                     sample_rx_bytes_(0),
+                                     sample_rx_time_us_(0),
+                                     rtt_us_(0),
+                                     min_rtt_us_(0),
+                                     min_rtt_stamp_us_(0),
+                                     round_bw_{},
+                                     btl_bw_(0),
+                                     round_count_(0),
+                                     bw_round_(0),
+                                     round_end_tx_(0),
+                                     state_(kStartup),
+                                     pacing_gain_(kHighGain),
+                                     cwnd_gain_(kHighGain),
+                                     full_bw_(0),
+                                     full_bw_rounds_(0),
+                                     filled_pipe_(false),
+                                     cycle_index_(0),
+                                     cycle_start_us_(0),
+                                     probe_rtt_done_us_(0),
+                                     probe_min_rtt_us_(0),
+                                     app_limited_(false),
+                                     feedbacks_(0),
+                                     rate_samples_(0)
+    {
+    }
+
+    uint16_t
+    BbrController::OnPing(
+        int64_t now_us)
+    {
+        if (first_ping_us_ == 0)
+            first_ping_us_ = now_us;
+        const uint16_t id = ++ping_id_;
+        Ping &ping = pings_[id % kPingSlots];
+        ping.used = true;
+        ping.id = id;
+        ping.sent_us = now_us;
+        ping.tx_bytes = tx_bytes_;
+        // the rate is held down while probing the RTT, do not sample it
+        ping.app_limited = app_limited_ || state_ == kProbeRtt;
+        return id;
+    }
+
+    void
+    BbrController::OnSent(
+        size_t bytes)
+    {
+        tx_bytes_ += bytes;
+    }
+
+    void
+    BbrController::OnFeedback(
+        uint16_t ping_id,
+        uint32_t rx_bytes,
+        uint32_t rx_time_us,
+        int64_t now_us)
+    {
+        Ping &ping = pings_[ping_id % kPingSlots];
+        if (!ping.used || ping.id != ping_id)
+            return;
+        ping.used = false;
+        ++feedbacks_;
+        last_feedback_us_ = now_us;
+        rtt_us_ = now_us - ping.sent_us;
+        if (min_rtt_us_ == 0 || rtt_us_ <= min_rtt_us_)
+        {
+            min_rtt_us_ = std::max<int64_t>(rtt_us_, 1);
+            min_rtt_stamp_us_ = now_us;
+        }
+        if (state_ == kProbeRtt)
+            probe_min_rtt_us_ = std::min(probe_min_rtt_us_, rtt_us_);
+        if (!have_feedback_)
+        {
+            // whatever was sent before the first answered ping is settled
+            have_feedback_ = true;
+            delivered_ = ping.tx_bytes;
+            lost_ = 0;
+            last_rx_bytes_ = sample_rx_bytes_ = rx_bytes;
+            sample_rx_time_us_ = rx_time_us;
+            round_end_tx_ = tx_bytes_;
+            return;
+        }
+        delivered_ += static_cast<uint32_t>(rx_bytes - last_rx_bytes_);
+        last_rx_bytes_ = rx_bytes;
+        // sent before the ping and not received by the time it was answered
+        if (ping.tx_bytes > delivered_)
+            lost_ = std::max(lost_, ping.tx_bytes - delivered_);
+        if (ping.tx_bytes >= round_end_tx_)
+        {
+            round_end_tx_ = tx_bytes_;
+            OnRoundStart();
+        }
+        const uint32_t elapsed_us = rx_time_us - sample_rx_time_us_;
+        if (elapsed_us >= std::max(min_rtt_us_, int64_t{kMinSampleUs}))
+        {
+            const uint64_t bw = static_cast<uint64_t>(
+                static_cast<uint32_t>(rx_bytes - sample_rx_bytes_) * 8e6 / elapsed_us);
+            // a sample taken short of data only counts if it is higher
+            if (!ping.app_limited || bw > btl_bw_)
+            {
+                // the rounds since the last sample age out only now, so
+                // the estimate holds over a spell without samples
+                const uint64_t stale = std::min<uint64_t>(round_count_ - bw_round_, kBwRounds);
+                for (uint64_t i = 0; i < stale; ++i)
+                    round_bw_[(round_count_ - i) % kBwRounds] = 0;
+                bw_round_ = round_count_;
+                uint64_t &round_bw = round_bw_[round_count_ % kBwRounds];
+                round_bw = std::max(round_bw, bw);
+                btl_bw_ = *std::max_element(round_bw_.begin(), round_bw_.end());
+            }
+            sample_rx_bytes_ = rx_bytes;
+            sample_rx_time_us_ = rx_time_us;
+            ++rate_samples_;
+        }
+        UpdateState(now_us);
+        if (state_ != kProbeRtt && now_us > min_rtt_stamp_us_ + kMinRttWindowUs)
+        {
+            // drain the queue at half the rate for a fresh look at the
+            // path RTT, the old one stands until then
+            state_ = kProbeRtt;
+            pacing_gain_ = 0.5;
+            cwnd_gain_ = 0.5;
+            probe_min_rtt_us_ = rtt_us_;
+            probe_rtt_done_us_ = now_us + std::max(int64_t{kProbeRttUs}, min_rtt_us_);
+        }
+    }
+
+    void
+    BbrController::OnRoundStart()
+    {
+        ++round_count_;
+        if (filled_pipe_ || app_limited_)
+            return;
+        if (btl_bw_ >= full_bw_ * kFullBwGrowth)
+        {
+            full_bw_ = btl_bw_;
+            full_bw_rounds_ = 0;
+        }
+        else if (++full_bw_rounds_ >= kFullBwRounds)
+            filled_pipe_ = true;
+    }
+
+    void
+    BbrController::UpdateState(
+        int64_t now_us)
+    {
+        switch (state_)
+        {
+        case kStartup:
+            if (filled_pipe_)
+            {
+                state_ = kDrain;
+                pacing_gain_ = 1 / kHighGain;
+                cwnd_gain_ = kHighGain;
+            }
+            break;
+        case kDrain:
+            if (InFlight() <= Bdp())
+                EnterProbeBw(now_us);
+            break;
+        case kProbeBw:
+            if (now_us - cycle_start_us_ > min_rtt_us_)
+            {
+                cycle_index_ = (cycle_index_ + 1) % kCycleLen;
+                pacing_gain_ = kCycleGains[cycle_index_];
+                cycle_start_us_ = now_us;
+            }
+            break;
+        case kProbeRtt:
+            if (now_us >= probe_rtt_done_us_)
+            {
+                min_rtt_us_ = std::max<int64_t>(probe_min_rtt_us_, 1);
+                min_rtt_stamp_us_ = now_us;
+                if (filled_pipe_)
+                    EnterProbeBw(now_us);
+                else
+                {
+                    state_ = kStartup;
+                    pacing_gain_ = cwnd_gain_ = kHighGain;
+                }
+            }
+            break;
+        }
+    }
+
+    void
+    BbrController::EnterProbeBw(
+        int64_t now_us)
+    {
+        state_ = kProbeBw;
+        cwnd_gain_ = 2;
+        // start anywhere but the draining phase
+        cycle_index_ = ping_id_ % kCycleLen;
+        if (cycle_index_ == 1)
+            cycle_index_ = 2;
+        pacing_gain_ = kCycleGains[cycle_index_];
+        cycle_start_us_ = now_us;
+    }
+
+    bool
+    BbrController::Active(
+        int64_t now_us) const
+    {
+        if (!have_feedback_)
+            return first_ping_us_ == 0 || now_us - first_ping_us_ < kFeedbackTimeoutUs;
+        return now_us - last_feedback_us_ < kFeedbackTimeoutUs;
+    }
+
+    bool
+    BbrController::CanSend(
+        int64_t now_us) const
+    {
+        return !Active(now_us) || InFlight() < Cwnd();
+    }
+
+    uint64_t BbrController::Bdp() const
+    {
+        if (btl_bw_ == 0 || min_rtt_us_ == 0)
+            return kInitialCwnd;
+        return static_cast<uint64_t>(btl_bw_ / 8e6 * min_rtt_us_);
+    }
+
+    uint64_t BbrController::Cwnd() const
+    {
+        // bytes are only seen delivered at the next ping, allow for the wait
+        const uint64_t ping_wait = static_cast<uint64_t>(btl_bw_ / 8e6 * kPingIntervalUs);
+        return std::max(uint64_t{kMinCwnd}, static_cast<uint64_t>(cwnd_gain_ * Bdp()) + ping_wait);
+    }
+
+    uint64_t BbrController::PacingRate() const
+    {
+        // never slower than an initial window per RTT
+        const int64_t rtt_us = min_rtt_us_ ? min_rtt_us_ : kInitialRttUs;
+        const double floor = kInitialCwnd * 8e6 / rtt_us;
+        return static_cast<uint64_t>(pacing_gain_ * std::max(double(btl_bw_), floor));
+    }
+
+    uint64_t BbrController::InFlight() const
+    {
+        const uint64_t settled = delivered_ + lost_;
+        return tx_bytes_ > settled ? tx_bytes_ - settled : 0;
+    }
+
+    void
+    BbrController::QueryInfo(
+        Json::Value &info)
+    {
+        static const char *const kStateNames[] = {"Startup", "Drain", "ProbeBw", "ProbeRtt"};
+        info["State"] = kStateNames[state_];
+        info["BtlBwBps"] = (Json::UInt64)btl_bw_;
+        info["PacingRateBps"] = (Json::UInt64)PacingRate();
+        info["CwndBytes"] = (Json::UInt64)Cwnd();
+        info["InFlightBytes"] = (Json::UInt64)InFlight();
+        info["RttUs"] = (Json::Int64)rtt_us_;
+        info["MinRttUs"] = (Json::Int64)min_rtt_us_;
+        info["TxBytes"] = (Json::UInt64)tx_bytes_;
+        info["DeliveredBytes"] = (Json::UInt64)delivered_;
+        info["LostBytes"] = (Json::UInt64)lost_;
+        info["Rounds"] = (Json::UInt64)round_count_;
+        info["Feedbacks"] = (Json::UInt64)feedbacks_;
+        info["RateSamples"] = (Json::UInt64)rate_samples_;
+    }
+} // namespace tincan
@@ -0,0 +1,169 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_BBR_CONTROLLER_H_
+#define TINCAN_BBR_CONTROLLER_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* A BBR style congestion controller for the records a vlink sends. The
+    owner pings the peer periodically and the peer answers with the bytes
+    it has received and when, by its own clock. The echo gives the RTT, the
+    received bytes over the peer's elapsed time give the delivery rate and
+    bytes sent before a ping but still not received when it is answered
+    are taken as lost. The bottleneck bandwidth is the largest delivery
+    rate of the last kBwRounds rounds and the path RTT the least RTT of the
+    last kMinRttWindowUs. Egress is paced at a gain times the bandwidth and
+    the bytes in flight are held to a gain times the BDP, with the gains
+    following the BBR startup, drain, probe bandwidth and probe RTT states.
+    Until the first feedback the bytes in flight are held to an initial
+    window. Without feedback for kFeedbackTimeoutUs, from a peer that does
+    not answer or over a dead path, the controller stands aside rather
+    than stall the link. Only used on the network thread.
+    */
+    class BbrController
+    {
+    public:
+        // the owner pings the peer this often while it has data to send
+        static const int64_t kPingIntervalUs = 10000;
+
+        BbrController();
+        BbrController(const BbrController &) = delete;
+        BbrController &operator=(const BbrController &) = delete;
+
+        // Returns the id of a ping sent now.
+        uint16_t OnPing(
+            int64_t now_us);
+
+        void OnSent(
+            size_t bytes);
+
+        void OnFeedback(
+            uint16_t ping_id,
+            uint32_t rx_bytes,
+            uint32_t rx_time_us,
+            int64_t now_us);
+
+        // The owner ran out of data to send.
+        void SetAppLimited(
+            bool app_limited)
+        {
+            app_limited_ = app_limited;
+        }
+
+        bool Active(
+            int64_t now_us) const;
+
+        bool CanSend(
+            int64_t now_us) const;
+
+        // bits per second
+        uint64_t PacingRate() const;
+
+        uint64_t Cwnd() const;
+
+        uint64_t InFlight() const;
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        enum State
+        {
+            kStartup,
+            kDrain,
+            kProbeBw,
+            kProbeRtt,
+        };
+
+        struct Ping
+        {
+            bool used = false;
+            uint16_t id = 0;
+            int64_t sent_us = 0;
+            uint64_t tx_bytes = 0;
+            bool app_limited = false;
+        };
+
+        uint64_t Bdp() const;
+
+        void OnRoundStart();
+
+        void UpdateState(
+            int64_t now_us);
+
+        void EnterProbeBw(
+            int64_t now_us);
+
+        // enough to match the answers to a ping every 10ms for a second
+        static const size_t kPingSlots = 128;
+        static const size_t kBwRounds = 10;
+        static const int64_t kMinRttWindowUs = 10000000;
+        static const int64_t kProbeRttUs = 200000;
+        // rate samples span at least this long
+        static const int64_t kMinSampleUs = 10000;
+        // no feedback for this long and the controller stands aside
+        static const int64_t kFeedbackTimeoutUs = 1000000;
+        static const uint64_t kMss = 1500;
+        static const uint64_t kMinCwnd = 4 * kMss;
+        static const uint64_t kInitialCwnd = 10 * kMss;
+
+        array<Ping, kPingSlots> pings_;
+        uint16_t ping_id_;
+        // 0 until the first ping
+        int64_t first_ping_us_;
+        uint64_t tx_bytes_;
+        uint64_t delivered_;
+        uint64_t lost_;
+        bool have_feedback_;
+        int64_t last_feedback_us_;
+        uint32_t last_rx_bytes_;
+        // the start of the current rate sample
+        uint32_t sample_rx_bytes_;
+        uint32_t sample_rx_time_us_;
+        int64_t rtt_us_;
+        int64_t min_rtt_us_;
+        int64_t min_rtt_stamp_us_;
+        array<uint64_t, kBwRounds> round_bw_;
+        uint64_t btl_bw_;
+        uint64_t round_count_;
+        // the round of the last bandwidth sample
+        uint64_t bw_round_;
+        uint64_t round_end_tx_;
+        State state_;
+        double pacing_gain_;
+        double cwnd_gain_;
+        uint64_t full_bw_;
+        int full_bw_rounds_;
+        bool filled_pipe_;
+        size_t cycle_index_;
+        int64_t cycle_start_us_;
+        int64_t probe_rtt_done_us_;
+        // the least RTT seen in kProbeRtt
+        int64_t probe_min_rtt_us_;
+        bool app_limited_;
+        uint64_t feedbacks_;
+        uint64_t rate_samples_;
+    };
+} // namespace tincan
+#endif // TINCAN_BBR_CONTROLLER_H_
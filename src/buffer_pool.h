@@ -29,7 +29,8 @@ namespace tincan
     class Iob
     {
     public:
-        static const uint16_t kFrameBufferSz = 1500;
+        // room for a full frame of a 9000 byte jumbo TAP MTU
+        static const uint16_t kFrameBufferSz = 9216;
         Iob() : iob_(new char[kFrameBufferSz])
         {
         }
@@ -150,7 +151,10 @@ public:
 			pool_.push_back(std::move(iob));
 		}
         else
-            iob.~Iob();
+        {
+            // freed here, the caller still destroys the moved-from iob
+            Tb discard(std::move(iob));
+        }
 	}
 
 	void put(Tb& iob) = delete;
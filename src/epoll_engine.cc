@@ -75,13 +75,26 @@ namespace tincan
 
     void EpollEngine::HandleWrite_(int fd)
     {
-        auto ch = comm_channels_.at(fd);
-        ch->WriteNext();
+        auto ch = Channel_(fd);
+        if (ch)
+            ch->WriteNext();
     }
     void EpollEngine::HandleRead_(int fd)
     {
-        auto ch = comm_channels_.at(fd);
-        ch->ReadNext();
+        auto ch = Channel_(fd);
+        if (ch)
+            ch->ReadNext();
+    }
+
+    // A handler earlier in the same epoll batch may have deregistered the
+    // channel, e.g. a RemoveTunnel request closing a TAP device, its
+    // pending events are then skipped.
+    shared_ptr<EpollChannel> EpollEngine::Channel_(int fd)
+    {
+        auto it = comm_channels_.find(fd);
+        if (it == comm_channels_.end())
+            return nullptr;
+        return it->second;
     }
 
     void EpollEngine::Epoll()
@@ -105,14 +118,18 @@ namespace tincan
             }
             else if (ev[num_fd].events & EPOLLRDHUP)
             {
-                auto ch = comm_channels_.at(ev[num_fd].data.fd);
-                DisableEpollIn(ch->ChannelEvent());
+                auto ch = Channel_(ev[num_fd].data.fd);
+                if (ch)
+                    DisableEpollIn(ch->ChannelEvent());
             }
             else if (ev[num_fd].events & EPOLLHUP)
             {
-                auto ch = comm_channels_.at(ev[num_fd].data.fd);
-                ch->Close();
-                Deregister(ev[num_fd].data.fd);
+                auto ch = Channel_(ev[num_fd].data.fd);
+                if (ch)
+                {
+                    ch->Close();
+                    Deregister(ev[num_fd].data.fd);
+                }
             }
         }
     }
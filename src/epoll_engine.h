@@ -83,6 +83,7 @@ namespace tincan
         bool HandleSignal_();
         void HandleRead_(int fd);
         void HandleWrite_(int fd);
+        shared_ptr<EpollChannel> Channel_(int fd);
         void SetupSignalHandler_();
 
     public:
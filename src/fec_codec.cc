@@ -0,0 +1,365 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "fec_codec.h"
+#include "gf256.h"
+#include "link_record.h"
+#include "rtc_base/time_utils.h"
+namespace tincan
+{
+    namespace
+    {
+        size_t
+        PopCount(
+            uint32_t v)
+        {
+            return static_cast<size_t>(__builtin_popcount(v));
+        }
+
+        struct CoefficientTable
+        {
+            CoefficientTable()
+            {
+                // Cauchy rows 1 / (x_j + y_i) with x_j = 16 + j and y_i = i,
+                // each column scaled by the inverse of its first row
+                for (size_t i = 0; i < FecEncoder::kMaxK; ++i)
+                {
+                    const uint8_t first = Gf256::Inv(static_cast<uint8_t>(16 ^ i));
+                    const uint8_t scale = Gf256::Inv(first);
+                    for (size_t j = 0; j < FecEncoder::kMaxM; ++j)
+                    {
+                        const uint8_t c = Gf256::Inv(static_cast<uint8_t>((16 + j) ^ i));
+                        coef[j][i] = Gf256::Mul(c, scale);
+                    }
+                }
+            }
+            array<array<uint8_t, FecEncoder::kMaxK>, FecEncoder::kMaxM> coef;
+        };
+    } // namespace
+
+    const size_t FecEncoder::kMaxK;
+    const size_t FecEncoder::kMaxM;
+
+    FecEncoder::FecEncoder(
+        size_t k,
+        size_t m) : k_(std::min(std::max<size_t>(k, 1), kMaxK)),
+                    m_(std::min(m, kMaxM)),
+                    group_m_(m_),
+                    group_(0),
+                    count_(0),
+                    sym_len_(0),
+                    groups_(0),
+                    data_records_(0),
+                    parity_records_(0),
+                    parity_bytes_(0),
+                    nanos_(0)
+    {
+    }
+
+    uint8_t
+    FecEncoder::Coefficient(
+        size_t row,
+        size_t col)
+    {
+        static const CoefficientTable table;
+        return table.coef[row][col];
+    }
+
+    void
+    FecEncoder::SetRedundancy(
+        size_t m)
+    {
+        m_ = std::min(m, kMaxM);
+    }
+
+    size_t
+    FecEncoder::RedundancyForLoss(
+        double loss,
+        size_t k)
+    {
+        size_t m = 4;
+        if (loss < 0.005)
+            m = 0;
+        else if (loss < 0.02)
+            m = 1;
+        else if (loss < 0.05)
+            m = 2;
+        else if (loss < 0.1)
+            m = 3;
+        // the steps are for groups of 8
+        return std::min((m * k + 7) / 8, kMaxM);
+    }
+
+    void
+    FecEncoder::Protect(
+        const char *record,
+        size_t len)
+    {
+        if (count_ == 0)
+            group_m_ = m_;
+        vector<uint8_t> &sym = symbols_[count_];
+        sym.resize(LinkRecord::kLenSz + len);
+        LinkRecord::WriteLength(reinterpret_cast<char *>(sym.data()), len);
+        memcpy(sym.data() + LinkRecord::kLenSz, record, len);
+        sym_len_ = std::max(sym_len_, sym.size());
+        out_.resize(1 + LinkRecord::kFecHeaderSz + len);
+        out_[0] = static_cast<char>(LinkRecord::kFec);
+        LinkRecord::WriteFecHeader(out_.data() + 1, group_, static_cast<uint8_t>(count_),
+                                   static_cast<uint8_t>(k_), static_cast<uint8_t>(group_m_));
+        memcpy(out_.data() + 1 + LinkRecord::kFecHeaderSz, record, len);
+        ++count_;
+        ++data_records_;
+        SignalSend(out_.data(), out_.size());
+        if (count_ == k_)
+            CloseGroup();
+    }
+
+    void FecEncoder::CloseGroup()
+    {
+        if (count_ == 0)
+            return;
+        const int64_t start = rtc::TimeNanos();
+        for (size_t j = 0; j < group_m_; ++j)
+        {
+            out_.assign(1 + LinkRecord::kFecHeaderSz + sym_len_, 0);
+            out_[0] = static_cast<char>(LinkRecord::kFec);
+            LinkRecord::WriteFecHeader(out_.data() + 1, group_, static_cast<uint8_t>(count_ + j),
+                                       static_cast<uint8_t>(count_), static_cast<uint8_t>(group_m_));
+            uint8_t *parity = reinterpret_cast<uint8_t *>(out_.data()) + 1 + LinkRecord::kFecHeaderSz;
+            for (size_t i = 0; i < count_; ++i)
+                Gf256::MulAdd(parity, symbols_[i].data(), Coefficient(j, i), symbols_[i].size());
+            ++parity_records_;
+            parity_bytes_ += out_.size();
+            SignalSend(out_.data(), out_.size());
+        }
+        nanos_ += rtc::TimeNanos() - start;
+        ++groups_;
+        ++group_;
+        count_ = 0;
+        sym_len_ = 0;
+    }
+
+    void
+    FecEncoder::QueryInfo(
+        Json::Value &info)
+    {
+        info["K"] = (Json::UInt64)k_;
+        info["M"] = (Json::UInt64)m_;
+        info["Kernel"] = Gf256::Kernel();
+        info["TxGroups"] = (Json::UInt64)groups_;
+        info["TxDataRecords"] = (Json::UInt64)data_records_;
+        info["TxParityRecords"] = (Json::UInt64)parity_records_;
+        info["TxParityBytes"] = (Json::UInt64)parity_bytes_;
+        info["TxEncodeUs"] = (Json::UInt64)(nanos_ / 1000);
+    }
+
+    FecDecoder::FecDecoder() : data_records_(0),
+                               parity_records_(0),
+                               recovered_(0),
+                               unrecoverable_(0),
+                               malformed_(0),
+                               duplicates_(0),
+                               stale_(0),
+                               nanos_(0)
+    {
+    }
+
+    bool
+    FecDecoder::Push(
+        const char *data,
+        size_t len,
+        const char *&record,
+        size_t &record_len)
+    {
+        uint16_t id = 0;
+        uint8_t index = 0, k = 0, m = 0;
+        if (!LinkRecord::ReadFecHeader(data, len, id, index, k, m) || k == 0 ||
+            k > FecEncoder::kMaxK || m > FecEncoder::kMaxM)
+        {
+            ++malformed_;
+            return false;
+        }
+        data += LinkRecord::kFecHeaderSz;
+        len -= LinkRecord::kFecHeaderSz;
+        Group &group = groups_[id % kGroupSlots];
+        // a late record of a group whose slot was taken by a newer one
+        // would wipe that group's state, it is dropped instead
+        if (group.used && static_cast<int16_t>(id - group.id) < 0)
+        {
+            ++stale_;
+            return false;
+        }
+        if (!group.used || group.id != id)
+        {
+            if (group.used && !group.done && group.k > 0)
+                ++unrecoverable_;
+            group.used = true;
+            group.done = false;
+            group.id = id;
+            group.k = 0;
+            group.data_mask = 0;
+            group.parity_mask = 0;
+            group.parity_len = 0;
+        }
+        if (index < k)
+        {
+            // a protected record is never itself a kFec record
+            if (len == 0 || (data[0] & LinkRecord::kFec))
+            {
+                ++malformed_;
+                return false;
+            }
+            const uint32_t bit = 1u << index;
+            // already delivered, either as itself or rebuilt from parity
+            if (group.data_mask & bit)
+            {
+                ++duplicates_;
+                return false;
+            }
+            vector<uint8_t> &sym = group.symbols[index];
+            sym.resize(LinkRecord::kLenSz + len);
+            LinkRecord::WriteLength(reinterpret_cast<char *>(sym.data()), len);
+            memcpy(sym.data() + LinkRecord::kLenSz, data, len);
+            group.data_mask |= bit;
+            ++data_records_;
+            TryRecover(group);
+            record = data;
+            record_len = len;
+            return true;
+        }
+        const size_t row = index - k;
+        if (row >= m || (group.k && group.k != k) || (group.parity_len && group.parity_len != len))
+        {
+            ++malformed_;
+            return false;
+        }
+        ++parity_records_;
+        group.k = k;
+        group.parity_len = len;
+        if (!(group.parity_mask & (1u << row)))
+        {
+            group.symbols[FecEncoder::kMaxK + row].assign(data, data + len);
+            group.parity_mask |= 1u << row;
+        }
+        TryRecover(group);
+        return false;
+    }
+
+    void
+    FecDecoder::TryRecover(
+        Group &group)
+    {
+        if (group.done || group.k == 0)
+            return;
+        const size_t k = group.k;
+        const uint32_t want = (1u << k) - 1;
+        const size_t have = PopCount(group.data_mask & want);
+        if (have == k)
+        {
+            group.done = true;
+            return;
+        }
+        const size_t missing = k - have;
+        if (PopCount(group.parity_mask) < missing)
+            return;
+        const int64_t start = rtc::TimeNanos();
+        const size_t len = group.parity_len;
+        array<size_t, FecEncoder::kMaxM> rows, cols;
+        for (size_t j = 0, n = 0; n < missing; ++j)
+        {
+            if (group.parity_mask & (1u << j))
+                rows[n++] = j;
+        }
+        for (size_t i = 0, n = 0; i < k; ++i)
+        {
+            if (!(group.data_mask & (1u << i)))
+                cols[n++] = i;
+        }
+        // the parity rows less the data that arrived leave missing x missing
+        // equations in the missing symbols
+        array<uint8_t, FecEncoder::kMaxM * FecEncoder::kMaxM> a;
+        for (size_t r = 0; r < missing; ++r)
+        {
+            for (size_t c = 0; c < missing; ++c)
+                a[r * missing + c] = FecEncoder::Coefficient(rows[r], cols[c]);
+            vector<uint8_t> &rhs = rhs_[r];
+            const vector<uint8_t> &parity = group.symbols[FecEncoder::kMaxK + rows[r]];
+            rhs.assign(parity.begin(), parity.end());
+            for (size_t i = 0; i < k; ++i)
+            {
+                if (!(group.data_mask & (1u << i)))
+                    continue;
+                const vector<uint8_t> &sym = group.symbols[i];
+                if (sym.size() > len)
+                {
+                    ++malformed_;
+                    group.done = true;
+                    return;
+                }
+                Gf256::MulAdd(rhs.data(), sym.data(), FecEncoder::Coefficient(rows[r], i), sym.size());
+            }
+        }
+        if (!Gf256::Invert(a.data(), missing))
+        {
+            ++malformed_;
+            group.done = true;
+            return;
+        }
+        for (size_t c = 0; c < missing; ++c)
+        {
+            vector<uint8_t> &sym = group.symbols[cols[c]];
+            sym.assign(len, 0);
+            for (size_t r = 0; r < missing; ++r)
+                Gf256::MulAdd(sym.data(), rhs_[r].data(), a[c * missing + r], len);
+            group.data_mask |= 1u << cols[c];
+        }
+        nanos_ += rtc::TimeNanos() - start;
+        group.done = true;
+        for (size_t c = 0; c < missing; ++c)
+        {
+            const vector<uint8_t> &sym = group.symbols[cols[c]];
+            const size_t record_len = LinkRecord::ReadLength(reinterpret_cast<const char *>(sym.data()));
+            if (record_len == 0 || LinkRecord::kLenSz + record_len > len ||
+                (sym[LinkRecord::kLenSz] & LinkRecord::kFec))
+            {
+                ++malformed_;
+                continue;
+            }
+            ++recovered_;
+            SignalRecovered(reinterpret_cast<const char *>(sym.data()) + LinkRecord::kLenSz, record_len);
+        }
+    }
+
+    void
+    FecDecoder::QueryInfo(
+        Json::Value &info)
+    {
+        info["RxDataRecords"] = (Json::UInt64)data_records_;
+        info["RxParityRecords"] = (Json::UInt64)parity_records_;
+        info["RxRecovered"] = (Json::UInt64)recovered_;
+        info["RxUnrecoverable"] = (Json::UInt64)unrecoverable_;
+        info["RxMalformed"] = (Json::UInt64)malformed_;
+        info["RxDuplicates"] = (Json::UInt64)duplicates_;
+        info["RxStale"] = (Json::UInt64)stale_;
+        info["RxDecodeUs"] = (Json::UInt64)(nanos_ / 1000);
+    }
+} // namespace tincan
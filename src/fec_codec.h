@@ -0,0 +1,155 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_FEC_CODEC_H_
+#define TINCAN_FEC_CODEC_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+namespace tincan
+{
+    /* Forward error correction over groups of up to k vlink records. Each
+    record is sent at once, wrapped in a LinkRecord::kFec record, and a
+    copy of it is kept as the symbol [length][record]. When the group is
+    full, or closed early, m parity records follow. Parity row j holds
+    sum(P[j][i] * symbol[i]) over GF(2^8), where P is a Cauchy matrix
+    scaled so the first row is all ones, so a single parity record is a
+    plain XOR. Any k of the k + m records rebuild the group.
+    Only used on the network thread.
+    */
+    class FecEncoder
+    {
+    public:
+        static const size_t kMaxK = 15;
+        static const size_t kMaxM = 8;
+
+        FecEncoder(
+            size_t k,
+            size_t m);
+        FecEncoder(const FecEncoder &) = delete;
+        FecEncoder &operator=(const FecEncoder &) = delete;
+
+        // Takes effect with the next group.
+        void SetRedundancy(
+            size_t m);
+
+        size_t Redundancy() const { return m_; }
+
+        void Protect(
+            const char *record,
+            size_t len);
+
+        // Sends the parity of a partly filled group.
+        void CloseGroup();
+
+        uint16_t Group() const { return group_; }
+
+        size_t Pending() const { return count_; }
+
+        void QueryInfo(
+            Json::Value &info);
+
+        // parity records for the loss rate seen on the path
+        static size_t RedundancyForLoss(
+            double loss,
+            size_t k);
+
+        static uint8_t Coefficient(
+            size_t row,
+            size_t col);
+
+        // the wrapped data records and the parity records to send
+        sigslot::signal2<const char *, size_t> SignalSend;
+
+    private:
+        const size_t k_;
+        size_t m_;
+        size_t group_m_;
+        uint16_t group_;
+        size_t count_;
+        size_t sym_len_;
+        array<vector<uint8_t>, kMaxK> symbols_;
+        vector<char> out_;
+        uint64_t groups_;
+        uint64_t data_records_;
+        uint64_t parity_records_;
+        uint64_t parity_bytes_;
+        uint64_t nanos_;
+    };
+
+    /* The receiving side of FecEncoder. Data records are passed on as they
+    arrive, records rebuilt from parity are emitted through SignalRecovered
+    and may arrive after later records of their group. Group ids are
+    compared in serial order, a record of a group older than the one
+    holding its slot is dropped.
+    */
+    class FecDecoder
+    {
+    public:
+        FecDecoder();
+        FecDecoder(const FecDecoder &) = delete;
+        FecDecoder &operator=(const FecDecoder &) = delete;
+
+        // Takes a kFec record without its flags byte. Returns true with the
+        // wrapped record if it is a data record not delivered before.
+        bool Push(
+            const char *data,
+            size_t len,
+            const char *&record,
+            size_t &record_len);
+
+        void QueryInfo(
+            Json::Value &info);
+
+        sigslot::signal2<const char *, size_t> SignalRecovered;
+
+    private:
+        static const size_t kGroupSlots = 8;
+
+        struct Group
+        {
+            bool used = false;
+            bool done = false;
+            uint16_t id = 0;
+            uint8_t k = 0;
+            uint32_t data_mask = 0;
+            uint32_t parity_mask = 0;
+            size_t parity_len = 0;
+            array<vector<uint8_t>, FecEncoder::kMaxK + FecEncoder::kMaxM> symbols;
+        };
+
+        void TryRecover(
+            Group &group);
+
+        array<Group, kGroupSlots> groups_;
+        array<vector<uint8_t>, FecEncoder::kMaxM> rhs_;
+        uint64_t data_records_;
+        uint64_t parity_records_;
+        uint64_t recovered_;
+        uint64_t unrecoverable_;
+        uint64_t malformed_;
+        uint64_t duplicates_;
+        uint64_t stale_;
+        uint64_t nanos_;
+    };
+} // namespace tincan
+#endif // TINCAN_FEC_CODEC_H_
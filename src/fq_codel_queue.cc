@@ -0,0 +1,539 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <cmath>
+#include "fq_codel_queue.h"
+namespace tincan
+{
+    extern BufferPool<Iob> bp;
+
+    FqCodelQueue::FqCodelQueue(
+        const Params &params) : params_(params),
+                                tins_((params.diffserv ? kTins : 1) + (params.ack_priority ? 1 : 0)),
+                                next_tin_(params.diffserv ? kVideo : 0),
+                                ack_tin_(tins_.size() - 1),
+                                length_(0),
+                                enqueued_(0),
+                                dequeued_(0),
+                                codel_drops_(0),
+                                overlimit_drops_(0),
+                                ecn_marks_(0),
+                                acks_filtered_(0),
+                                new_flow_count_(0),
+                                avg_sojourn_us_(0),
+                                max_sojourn_us_(0)
+    {
+        flows_per_tin_ = std::max<size_t>(params_.flows / tins_.size(), 1);
+        flows_.resize(flows_per_tin_ * tins_.size());
+        entries_.reserve(params_.limit + 1);
+        const int64_t quantum = static_cast<int64_t>(params_.quantum);
+        if (params_.diffserv)
+        {
+            tins_[kVideo].quantum = 3 * quantum;
+            tins_[kBestEffort].quantum = 2 * quantum;
+            tins_[kBulk].quantum = quantum;
+        }
+        else
+            tins_[0].quantum = quantum;
+    }
+
+    bool
+    FqCodelQueue::ParseAck(
+        const char *frame,
+        const FrameInfo &info,
+        AckInfo &ack)
+    {
+        if (!info.IsTcp() || info.payload_offset < info.ip_end ||
+            info.payload_offset < info.l4_offset + 20)
+            return false;
+        const uint8_t *tcp = reinterpret_cast<const uint8_t *>(frame) + info.l4_offset;
+        // ACK, and none of URG, RST, SYN or FIN
+        if ((tcp[13] & 0x37) != 0x10)
+            return false;
+        ack.l3_offset = static_cast<uint16_t>(info.l3_offset);
+        ack.l4_offset = static_cast<uint16_t>(info.l4_offset);
+        ack.ack_seq = FrameInfo::Read32(tcp + 8);
+        const uint8_t *opt = tcp + 20;
+        const uint8_t *end = reinterpret_cast<const uint8_t *>(frame) + info.payload_offset;
+        while (opt < end && *opt != 0)
+        {
+            if (*opt == 1)
+            {
+                ++opt;
+                continue;
+            }
+            if (opt + 1 >= end || opt[1] < 2)
+                break;
+            if (*opt == 5)
+                ack.sack = true;
+            opt += opt[1];
+        }
+        return true;
+    }
+
+    bool
+    FqCodelQueue::SameConnection(
+        const Entry &a,
+        const Entry &b)
+    {
+        const uint8_t *pa = reinterpret_cast<const uint8_t *>(a.frame.data());
+        const uint8_t *pb = reinterpret_cast<const uint8_t *>(b.frame.data());
+        const uint8_t *ipa = pa + a.ack.l3_offset, *ipb = pb + b.ack.l3_offset;
+        const uint8_t *tcpa = pa + a.ack.l4_offset, *tcpb = pb + b.ack.l4_offset;
+        if ((ipa[0] >> 4) != (ipb[0] >> 4) || tcpa[13] != tcpb[13] ||
+            memcmp(tcpa, tcpb, 4) != 0)
+            return false;
+        if ((ipa[0] >> 4) == 4)
+            return memcmp(ipa + 12, ipb + 12, 8) == 0;
+        return memcmp(ipa + 8, ipb + 8, 32) == 0;
+    }
+
+    /* Only a strictly newer cumulative ACK replaces a queued one, duplicate
+    ACKs are how the sender detects loss. An ACK carrying SACK blocks or
+    different ECN flags is kept.
+    */
+    void
+    FqCodelQueue::FilterAcks(
+        Flow &flow,
+        int32_t idx)
+    {
+        const Entry &latest = entries_[idx];
+        int32_t prev = -1;
+        for (int32_t cur = flow.head; cur >= 0; prev = cur, cur = entries_[cur].next)
+        {
+            const Entry &entry = entries_[cur];
+            if (!entry.ack.l4_offset || entry.ack.sack ||
+                static_cast<int32_t>(latest.ack.ack_seq - entry.ack.ack_seq) <= 0 ||
+                !SameConnection(entry, latest))
+                continue;
+            if (prev < 0)
+                flow.head = entry.next;
+            else
+                entries_[prev].next = entry.next;
+            if (flow.tail == cur)
+                flow.tail = prev;
+            flow.backlog -= entry.frame.size();
+            --length_;
+            ++acks_filtered_;
+            Release(cur);
+            return;
+        }
+    }
+
+    FqCodelQueue::Tin
+    FqCodelQueue::TinForDscp(
+        uint8_t dscp)
+    {
+        switch (dscp)
+        {
+        case 40: // CS5
+        case 44: // VA
+        case 46: // EF
+        case 48: // CS6
+        case 56: // CS7
+            return kVoice;
+        case 24: // CS3
+        case 26: // AF31
+        case 28: // AF32
+        case 30: // AF33
+        case 32: // CS4
+        case 34: // AF41
+        case 36: // AF42
+        case 38: // AF43
+            return kVideo;
+        case 1: // LE
+        case 8: // CS1
+            return kBulk;
+        default:
+            return kBestEffort;
+        }
+    }
+
+    FqCodelQueue::~FqCodelQueue()
+    {
+        // only the entries still linked into a flow hold a buffer
+        for (Flow &flow : flows_)
+        {
+            while (flow.head >= 0)
+            {
+                const int32_t idx = flow.head;
+                flow.head = entries_[idx].next;
+                bp.put(std::move(entries_[idx].frame));
+            }
+        }
+    }
+
+    void
+    FqCodelQueue::Enqueue(
+        Iob &&frame,
+        int64_t now_us)
+    {
+        FrameInfo info;
+        uint16_t ecn_offset = 0;
+        AckInfo ack;
+        bool pure_ack = false;
+        if (FrameInfo::Parse(frame.data(), frame.size(), info))
+        {
+            if (params_.ack_priority || params_.ack_filter)
+                pure_ack = ParseAck(frame.data(), info, ack);
+            const uint8_t *ip = reinterpret_cast<const uint8_t *>(frame.data()) + info.l3_offset;
+            // ECT(0), ECT(1) or already CE
+            if ((info.IsIPv4() && info.l4_offset && (ip[1] & 0x03)) ||
+                (info.IsIPv6() && info.l4_offset && (ip[1] & 0x30)))
+                ecn_offset = static_cast<uint16_t>(info.l3_offset);
+        }
+        lock_guard<mutex> lg(mtx_);
+        if (length_ >= params_.limit)
+            DropFromFattest();
+        int32_t idx;
+        if (!free_.empty())
+        {
+            idx = free_.back();
+            free_.pop_back();
+            entries_[idx] = Entry{std::move(frame), now_us, -1, ecn_offset, ack};
+        }
+        else
+        {
+            idx = static_cast<int32_t>(entries_.size());
+            entries_.push_back(Entry{std::move(frame), now_us, -1, ecn_offset, ack});
+        }
+        uint8_t tin = 0;
+        if (pure_ack && params_.ack_priority)
+            tin = static_cast<uint8_t>(ack_tin_);
+        else if (params_.diffserv)
+            tin = TinForDscp(info.dscp);
+        const uint32_t fi = static_cast<uint32_t>(tin * flows_per_tin_ + info.flow_hash % flows_per_tin_);
+        Flow &flow = flows_[fi];
+        flow.tin = tin;
+        if (pure_ack && params_.ack_filter)
+            FilterAcks(flow, idx);
+        if (flow.tail >= 0)
+            entries_[flow.tail].next = idx;
+        else
+            flow.head = idx;
+        flow.tail = idx;
+        flow.backlog += entries_[idx].frame.size();
+        ++length_;
+        ++enqueued_;
+        ++tins_[tin].enqueued;
+        if (flow.list == kIdle)
+        {
+            flow.list = kNewList;
+            flow.deficit = static_cast<int64_t>(params_.quantum);
+            tins_[tin].new_flows.push_back(fi);
+            ++new_flow_count_;
+        }
+    }
+
+    size_t
+    FqCodelQueue::Dequeue(
+        int64_t now_us,
+        size_t max,
+        vector<Iob> &frames)
+    {
+        lock_guard<mutex> lg(mtx_);
+        size_t n = 0;
+        while (n < max)
+        {
+            TinState *tin = PickTin();
+            if (!tin)
+                break;
+            const int32_t idx = DequeueTin(*tin, now_us);
+            if (idx < 0)
+                continue;
+            tin->deficit -= static_cast<int64_t>(entries_[idx].frame.size());
+            ++tin->dequeued;
+            frames.push_back(std::move(entries_[idx].frame));
+            free_.push_back(idx);
+            ++dequeued_;
+            ++n;
+        }
+        return n;
+    }
+
+    FqCodelQueue::TinState *
+    FqCodelQueue::PickTin()
+    {
+        if (params_.diffserv && tins_[kVoice].Active())
+            return &tins_[kVoice];
+        if (params_.ack_priority && tins_[ack_tin_].Active())
+            return &tins_[ack_tin_];
+        if (!params_.diffserv)
+            return tins_[0].Active() ? &tins_[0] : nullptr;
+        if (!tins_[kVideo].Active() && !tins_[kBestEffort].Active() && !tins_[kBulk].Active())
+            return nullptr;
+        // deficit round robin over the weighted tins
+        for (;;)
+        {
+            TinState &tin = tins_[next_tin_];
+            if (tin.Active() && tin.deficit > 0)
+                return &tin;
+            if (tin.Active())
+                tin.deficit += tin.quantum;
+            else
+                tin.deficit = 0;
+            next_tin_ = next_tin_ == kBulk ? static_cast<size_t>(kVideo) : next_tin_ + 1;
+        }
+    }
+
+    int32_t
+    FqCodelQueue::DequeueTin(
+        TinState &tin,
+        int64_t now_us)
+    {
+        for (;;)
+        {
+            deque<uint32_t> *list = !tin.new_flows.empty() ? &tin.new_flows : (!tin.old_flows.empty() ? &tin.old_flows : nullptr);
+            if (!list)
+                return -1;
+            const uint32_t fi = list->front();
+            Flow &flow = flows_[fi];
+            if (flow.deficit <= 0)
+            {
+                flow.deficit += static_cast<int64_t>(params_.quantum);
+                list->pop_front();
+                tin.old_flows.push_back(fi);
+                flow.list = kOldList;
+                continue;
+            }
+            const int32_t idx = CodelDequeue(flow, now_us);
+            if (idx < 0)
+            {
+                // an emptied new flow goes to the back of the old ones so it
+                // cannot win priority again by going idle briefly
+                list->pop_front();
+                if (list == &tin.new_flows && !tin.old_flows.empty())
+                {
+                    tin.old_flows.push_back(fi);
+                    flow.list = kOldList;
+                }
+                else
+                    flow.list = kIdle;
+                continue;
+            }
+            flow.deficit -= static_cast<int64_t>(entries_[idx].frame.size());
+            return idx;
+        }
+    }
+
+    size_t FqCodelQueue::Length()
+    {
+        lock_guard<mutex> lg(mtx_);
+        return length_;
+    }
+
+    int32_t
+    FqCodelQueue::Pop(
+        Flow &flow,
+        int64_t now_us,
+        bool &ok_to_drop)
+    {
+        ok_to_drop = false;
+        const int32_t idx = flow.head;
+        if (idx < 0)
+        {
+            flow.first_above_us = 0;
+            return -1;
+        }
+        Entry &entry = entries_[idx];
+        flow.head = entry.next;
+        if (flow.head < 0)
+            flow.tail = -1;
+        flow.backlog -= entry.frame.size();
+        --length_;
+        const int64_t sojourn = now_us - entry.enqueue_us;
+        avg_sojourn_us_ += (sojourn - avg_sojourn_us_) / 16;
+        max_sojourn_us_ = std::max(max_sojourn_us_, sojourn);
+        // a flow with less than a frame queued is not building a standing queue
+        if (sojourn < params_.target_us || flow.backlog <= params_.quantum)
+            flow.first_above_us = 0;
+        else if (flow.first_above_us == 0)
+            flow.first_above_us = now_us + params_.interval_us;
+        else if (now_us >= flow.first_above_us)
+            ok_to_drop = true;
+        return idx;
+    }
+
+    int32_t
+    FqCodelQueue::CodelDequeue(
+        Flow &flow,
+        int64_t now_us)
+    {
+        bool ok_to_drop = false;
+        int32_t idx = Pop(flow, now_us, ok_to_drop);
+        if (idx < 0)
+        {
+            flow.dropping = false;
+            return -1;
+        }
+        if (flow.dropping)
+        {
+            if (!ok_to_drop)
+            {
+                flow.dropping = false;
+                return idx;
+            }
+            while (flow.dropping && now_us >= flow.drop_next_us)
+            {
+                ++flow.count;
+                if (DropOrMark(flow, idx))
+                {
+                    flow.drop_next_us = ControlLaw(flow.drop_next_us, flow.count);
+                    return idx;
+                }
+                idx = Pop(flow, now_us, ok_to_drop);
+                if (!ok_to_drop)
+                    flow.dropping = false;
+                else
+                    flow.drop_next_us = ControlLaw(flow.drop_next_us, flow.count);
+            }
+        }
+        else if (ok_to_drop)
+        {
+            if (!DropOrMark(flow, idx))
+                idx = Pop(flow, now_us, ok_to_drop);
+            flow.dropping = true;
+            // resume near the drop rate that last controlled the queue
+            const uint32_t delta = flow.count - flow.last_count;
+            flow.count = (delta > 1 && now_us - flow.drop_next_us < 16 * params_.interval_us) ? delta : 1;
+            flow.last_count = flow.count;
+            flow.drop_next_us = ControlLaw(now_us, flow.count);
+        }
+        return idx;
+    }
+
+    bool
+    FqCodelQueue::DropOrMark(
+        Flow &flow,
+        int32_t idx)
+    {
+        Entry &entry = entries_[idx];
+        if (params_.ecn && entry.ecn_offset)
+        {
+            MarkCe(entry.frame.buf(), entry.ecn_offset);
+            ++ecn_marks_;
+            return true;
+        }
+        ++codel_drops_;
+        ++tins_[flow.tin].drops;
+        Release(idx);
+        return false;
+    }
+
+    void
+    FqCodelQueue::Release(
+        int32_t idx)
+    {
+        bp.put(std::move(entries_[idx].frame));
+        free_.push_back(idx);
+    }
+
+    void FqCodelQueue::DropFromFattest()
+    {
+        Flow *fattest = nullptr;
+        for (Flow &flow : flows_)
+        {
+            if (flow.head >= 0 && (!fattest || flow.backlog > fattest->backlog))
+                fattest = &flow;
+        }
+        if (!fattest)
+            return;
+        const int32_t idx = fattest->head;
+        fattest->head = entries_[idx].next;
+        if (fattest->head < 0)
+            fattest->tail = -1;
+        fattest->backlog -= entries_[idx].frame.size();
+        --length_;
+        ++overlimit_drops_;
+        ++tins_[fattest->tin].drops;
+        Release(idx);
+    }
+
+    int64_t
+    FqCodelQueue::ControlLaw(
+        int64_t t,
+        uint32_t count) const
+    {
+        return t + static_cast<int64_t>(params_.interval_us / std::sqrt(double(count)));
+    }
+
+    void
+    FqCodelQueue::MarkCe(
+        char *frame,
+        uint16_t offset)
+    {
+        uint8_t *ip = reinterpret_cast<uint8_t *>(frame) + offset;
+        if ((ip[0] >> 4) == 4)
+        {
+            const uint16_t old_word = FrameInfo::Read16(ip);
+            const uint16_t new_word = old_word | 0x0003;
+            const uint16_t csum = FrameInfo::UpdateChecksum(FrameInfo::Read16(ip + 10), old_word, new_word);
+            ip[1] = static_cast<uint8_t>(new_word);
+            ip[10] = static_cast<uint8_t>(csum >> 8);
+            ip[11] = static_cast<uint8_t>(csum);
+        }
+        else
+            ip[1] |= 0x30;
+    }
+
+    void
+    FqCodelQueue::QueryInfo(
+        Json::Value &info)
+    {
+        lock_guard<mutex> lg(mtx_);
+        info["Limit"] = (Json::UInt64)params_.limit;
+        info["TargetUs"] = (Json::Int64)params_.target_us;
+        info["IntervalUs"] = (Json::Int64)params_.interval_us;
+        info["Ecn"] = params_.ecn;
+        info["Backlog"] = (Json::UInt64)length_;
+        size_t active = 0;
+        for (const TinState &tin : tins_)
+            active += tin.new_flows.size() + tin.old_flows.size();
+        info["ActiveFlows"] = (Json::UInt64)active;
+        info["NewFlows"] = (Json::UInt64)new_flow_count_;
+        info["Enqueued"] = (Json::UInt64)enqueued_;
+        info["Dequeued"] = (Json::UInt64)dequeued_;
+        info["CodelDrops"] = (Json::UInt64)codel_drops_;
+        info["OverlimitDrops"] = (Json::UInt64)overlimit_drops_;
+        info["EcnMarks"] = (Json::UInt64)ecn_marks_;
+        if (params_.ack_filter)
+            info["AcksFiltered"] = (Json::UInt64)acks_filtered_;
+        info["AvgSojournUs"] = avg_sojourn_us_;
+        info["MaxSojournUs"] = (Json::Int64)max_sojourn_us_;
+        if (tins_.size() == 1)
+            return;
+        static const char *const kTinNames[kTins] = {"Voice", "Video", "BestEffort", "Bulk"};
+        for (size_t i = 0; i < tins_.size(); ++i)
+        {
+            const char *name = "Default";
+            if (params_.ack_priority && i == ack_tin_)
+                name = "Ack";
+            else if (params_.diffserv)
+                name = kTinNames[i];
+            Json::Value &tin_info = info["Tins"][name];
+            tin_info["Enqueued"] = (Json::UInt64)tins_[i].enqueued;
+            tin_info["Dequeued"] = (Json::UInt64)tins_[i].dequeued;
+            tin_info["Drops"] = (Json::UInt64)tins_[i].drops;
+            tin_info["ActiveFlows"] = (Json::UInt64)(tins_[i].new_flows.size() + tins_[i].old_flows.size());
+        }
+    }
+} // namespace tincan
@@ -0,0 +1,227 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_FQ_CODEL_QUEUE_H_
+#define TINCAN_FQ_CODEL_QUEUE_H_
+#include "tincan_base.h"
+#include "buffer_pool.h"
+#include "frame_parser.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* FQ-CoDel (RFC 8290) between the TAP and a vlink. Frames are hashed on
+    their inner 5-tuple into flows that are served round robin by deficit,
+    new flows first, so a bulk transfer cannot starve an interactive one.
+    Each flow runs CoDel (RFC 8289) on the time its frames spent queued and
+    drops, or marks CE on ECN capable frames, once that stays above the
+    target for an interval. Above the frame limit the head of the largest
+    flow is dropped. With diffserv the flows are split into tins by the
+    inner DSCP, like the diffserv4 mode of CAKE. Voice is served with
+    strict priority, the other tins share what is left by weight. Pure TCP
+    ACKs may get a lane of their own, served right after voice, so the
+    ACKs of a download do not wait behind an upload on a narrow uplink.
+    An ACK filter drops a queued ACK once a later cumulative ACK of the
+    same connection is queued behind it. The TAP thread enqueues and the
+    network thread dequeues.
+    */
+    class FqCodelQueue
+    {
+    public:
+        struct Params
+        {
+            size_t flows = 1024;
+            size_t limit = 1000;
+            // bytes a flow may send per round
+            size_t quantum = 1514;
+            int64_t target_us = 5000;
+            int64_t interval_us = 100000;
+            bool ecn = true;
+            bool diffserv = false;
+            bool ack_priority = false;
+            bool ack_filter = false;
+        };
+
+        enum Tin : uint8_t
+        {
+            // EF, VA and CS5 to CS7, strict priority
+            kVoice,
+            // AF3x, AF4x, CS3 and CS4, weight 3
+            kVideo,
+            // weight 2
+            kBestEffort,
+            // CS1 and LE, weight 1
+            kBulk,
+            kTins,
+        };
+
+        static Tin TinForDscp(
+            uint8_t dscp);
+
+        explicit FqCodelQueue(
+            const Params &params);
+        FqCodelQueue(const FqCodelQueue &) = delete;
+        FqCodelQueue &operator=(const FqCodelQueue &) = delete;
+        ~FqCodelQueue();
+
+        void Enqueue(
+            Iob &&frame,
+            int64_t now_us);
+
+        // Appends up to max frames to frames and returns how many.
+        size_t Dequeue(
+            int64_t now_us,
+            size_t max,
+            vector<Iob> &frames);
+
+        size_t Length();
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        enum ListState : uint8_t
+        {
+            kIdle,
+            kNewList,
+            kOldList,
+        };
+
+        struct AckInfo
+        {
+            uint16_t l3_offset = 0;
+            // offset of the TCP header of a pure ACK, or 0
+            uint16_t l4_offset = 0;
+            uint32_t ack_seq = 0;
+            // SACK blocks make an ACK worth keeping
+            bool sack = false;
+        };
+
+        struct Entry
+        {
+            Iob frame;
+            int64_t enqueue_us;
+            int32_t next;
+            // offset of the IP header of an ECN capable frame, or 0
+            uint16_t ecn_offset;
+            AckInfo ack;
+        };
+
+        struct Flow
+        {
+            int32_t head = -1;
+            int32_t tail = -1;
+            size_t backlog = 0;
+            int64_t deficit = 0;
+            ListState list = kIdle;
+            uint8_t tin = 0;
+            // CoDel state
+            bool dropping = false;
+            uint32_t count = 0;
+            uint32_t last_count = 0;
+            int64_t first_above_us = 0;
+            int64_t drop_next_us = 0;
+        };
+
+        struct TinState
+        {
+            deque<uint32_t> new_flows;
+            deque<uint32_t> old_flows;
+            int64_t quantum = 0;
+            int64_t deficit = 0;
+            uint64_t enqueued = 0;
+            uint64_t dequeued = 0;
+            uint64_t drops = 0;
+
+            bool Active() const { return !new_flows.empty() || !old_flows.empty(); }
+        };
+
+        static bool ParseAck(
+            const char *frame,
+            const FrameInfo &info,
+            AckInfo &ack);
+
+        static bool SameConnection(
+            const Entry &a,
+            const Entry &b);
+
+        // Drops a queued ACK of the flow that the one at idx supersedes.
+        void FilterAcks(
+            Flow &flow,
+            int32_t idx);
+
+        TinState *PickTin();
+
+        // Returns the entry dequeued from the tin, or -1 once it is empty.
+        int32_t DequeueTin(
+            TinState &tin,
+            int64_t now_us);
+
+        int32_t Pop(
+            Flow &flow,
+            int64_t now_us,
+            bool &ok_to_drop);
+
+        int32_t CodelDequeue(
+            Flow &flow,
+            int64_t now_us);
+
+        // Returns true if the frame was marked CE rather than dropped.
+        bool DropOrMark(
+            Flow &flow,
+            int32_t idx);
+
+        void Release(
+            int32_t idx);
+
+        void DropFromFattest();
+
+        int64_t ControlLaw(
+            int64_t t,
+            uint32_t count) const;
+
+        static void MarkCe(
+            char *frame,
+            uint16_t offset);
+
+        const Params params_;
+        mutex mtx_;
+        vector<Flow> flows_;
+        vector<Entry> entries_;
+        vector<int32_t> free_;
+        vector<TinState> tins_;
+        size_t flows_per_tin_;
+        size_t next_tin_;
+        // the last tin when ACKs have a lane
+        size_t ack_tin_;
+        size_t length_;
+        uint64_t enqueued_;
+        uint64_t dequeued_;
+        uint64_t codel_drops_;
+        uint64_t overlimit_drops_;
+        uint64_t ecn_marks_;
+        uint64_t acks_filtered_;
+        uint64_t new_flow_count_;
+        double avg_sojourn_us_;
+        int64_t max_sojourn_us_;
+    };
+} // namespace tincan
+#endif // TINCAN_FQ_CODEL_QUEUE_H_
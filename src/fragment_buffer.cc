@@ -0,0 +1,134 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "fragment_buffer.h"
+#include "link_record.h"
+#include <algorithm>
+namespace tincan
+{
+    FragmentBuffer::FragmentBuffer(
+        size_t slots,
+        int64_t timeout_ms,
+        size_t max_record) : slots_(slots),
+                             timeout_ms_(timeout_ms),
+                             max_record_(max_record),
+                             fragments_(0),
+                             reassembled_(0),
+                             dropped_(0),
+                             malformed_(0),
+                             duplicates_(0)
+    {
+    }
+
+    bool
+    FragmentBuffer::Push(
+        const char *data,
+        size_t len,
+        int64_t now_ms,
+        const char *&record,
+        size_t &record_len)
+    {
+        uint16_t id = 0;
+        size_t offset = 0;
+        bool last = false;
+        if (!LinkRecord::ReadFragmentHeader(data, len, id, offset, last) ||
+            len == LinkRecord::kFragmentHeaderSz ||
+            offset + len - LinkRecord::kFragmentHeaderSz > max_record_)
+        {
+            ++malformed_;
+            return false;
+        }
+        ++fragments_;
+        data += LinkRecord::kFragmentHeaderSz;
+        len -= LinkRecord::kFragmentHeaderSz;
+        Slot *slot = nullptr;
+        Slot *victim = nullptr;
+        for (Slot &s : slots_)
+        {
+            if (s.used && now_ms - s.first_ms > timeout_ms_)
+            {
+                s.used = false;
+                ++dropped_;
+            }
+            if (s.used && s.id == id)
+                slot = &s;
+            else if (!victim || (victim->used && (!s.used || s.first_ms < victim->first_ms)))
+                victim = &s;
+        }
+        if (!slot)
+        {
+            slot = victim;
+            if (slot->used)
+                ++dropped_;
+            slot->used = true;
+            slot->id = id;
+            slot->first_ms = now_ms;
+            slot->received = 0;
+            slot->total = 0;
+            // both keep their capacity between uses
+            slot->pieces.clear();
+            slot->record.resize(max_record_);
+        }
+        const size_t end = offset + len;
+        for (const auto &piece : slot->pieces)
+        {
+            // a repeat, it must not count towards the record twice
+            if (offset < piece.second && piece.first < end)
+            {
+                ++duplicates_;
+                return false;
+            }
+        }
+        memcpy(slot->record.data() + offset, data, len);
+        slot->pieces.emplace_back(offset, end);
+        slot->received += len;
+        if (last)
+            slot->total = end;
+        if (slot->total == 0 || slot->received < slot->total)
+            return false;
+        slot->used = false;
+        // disjoint pieces that add up to the total cover it unless one lies
+        // past the end
+        if (slot->received != slot->total ||
+            std::any_of(slot->pieces.begin(), slot->pieces.end(), [slot](const pair<size_t, size_t> &piece)
+                        { return piece.second > slot->total; }))
+        {
+            ++malformed_;
+            return false;
+        }
+        ++reassembled_;
+        record = slot->record.data();
+        record_len = slot->total;
+        return true;
+    }
+
+    void
+    FragmentBuffer::QueryInfo(
+        Json::Value &info)
+    {
+        info["RxFragments"] = (Json::UInt64)fragments_;
+        info["RxReassembled"] = (Json::UInt64)reassembled_;
+        info["RxDropped"] = (Json::UInt64)dropped_;
+        info["RxMalformed"] = (Json::UInt64)malformed_;
+        info["RxDuplicates"] = (Json::UInt64)duplicates_;
+    }
+} // namespace tincan
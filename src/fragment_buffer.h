@@ -0,0 +1,81 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_FRAGMENT_BUFFER_H_
+#define TINCAN_FRAGMENT_BUFFER_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* Reassembles vlink records that were sent in LinkRecord::kFragment
+    pieces. A few records can be in progress at once, one that is not
+    complete within the timeout, or whose slot is needed for a newer
+    record, is dropped. Only used on the network thread.
+    */
+    class FragmentBuffer
+    {
+    public:
+        FragmentBuffer(
+            size_t slots,
+            int64_t timeout_ms,
+            size_t max_record);
+        FragmentBuffer(const FragmentBuffer &) = delete;
+        FragmentBuffer &operator=(const FragmentBuffer &) = delete;
+
+        // Adds a fragment, starting with its fragment header. Returns true
+        // when it completes a record, which stays valid in record and
+        // record_len until the next call.
+        bool Push(
+            const char *data,
+            size_t len,
+            int64_t now_ms,
+            const char *&record,
+            size_t &record_len);
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        struct Slot
+        {
+            bool used = false;
+            uint16_t id = 0;
+            int64_t first_ms = 0;
+            size_t received = 0;
+            // known once the last piece arrived
+            size_t total = 0;
+            // [offset, end) of the pieces received, they never overlap
+            vector<pair<size_t, size_t>> pieces;
+            vector<char> record;
+        };
+
+        vector<Slot> slots_;
+        const int64_t timeout_ms_;
+        const size_t max_record_;
+        uint64_t fragments_;
+        uint64_t reassembled_;
+        uint64_t dropped_;
+        uint64_t malformed_;
+        uint64_t duplicates_;
+    };
+} // namespace tincan
+#endif // TINCAN_FRAGMENT_BUFFER_H_
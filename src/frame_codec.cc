@@ -0,0 +1,161 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "frame_codec.h"
+namespace tincan
+{
+    FrameCodec::FrameCodec(
+        bool header_compression,
+        bool payload_compression,
+        bool elide_macs,
+        const MacAddressType &local_mac,
+        const MacAddressType &peer_mac) : elide_macs_(elide_macs),
+                                          local_mac_(local_mac),
+                                          peer_mac_(peer_mac),
+                                          compress_headers_(false)
+    {
+        if (header_compression)
+            EnableHeaderCompression();
+        if (payload_compression)
+            payload_ = make_unique<PayloadCompressor>();
+    }
+
+    void
+    FrameCodec::EnableHeaderCompression()
+    {
+        compress_headers_ = true;
+        if (!headers_)
+            headers_ = make_unique<HeaderCompressor>(elide_macs_, local_mac_, peer_mac_);
+    }
+
+    size_t
+    FrameCodec::Encode(
+        const char *frame,
+        size_t len,
+        char *out,
+        size_t cap)
+    {
+        FrameInfo info;
+        if (!FrameInfo::Parse(frame, len, info))
+        {
+            out[0] = HeaderCompressor::kNone;
+            memcpy(out + 1, frame, len);
+            return len + 1;
+        }
+        uint8_t encoding = HeaderCompressor::kNone;
+        size_t consumed = 0;
+        size_t pos = 1;
+        if (compress_headers_)
+        {
+            // room left once the rest of the frame is copied as is
+            const size_t room = cap - 1 - (len - std::min(len, info.payload_offset));
+            pos += headers_->Compress(info, frame, len, out + pos, room, consumed, encoding);
+        }
+        size_t clen = 0;
+        if (payload_)
+            clen = payload_->Encode(info, frame, len, consumed, out + pos, cap - pos);
+        if (clen > 0)
+        {
+            encoding |= kPayloadCompressed;
+            pos += clen;
+        }
+        else
+        {
+            memcpy(out + pos, frame + consumed, len - consumed);
+            pos += len - consumed;
+        }
+        out[0] = static_cast<char>(encoding);
+        return pos;
+    }
+
+    size_t
+    FrameCodec::Decode(
+        const char *data,
+        size_t len,
+        char *out,
+        size_t out_cap)
+    {
+        if (len < 1)
+            return 0;
+        const uint8_t encoding = static_cast<uint8_t>(data[0]);
+        const uint8_t hdr_encoding = encoding & kHeaderMask;
+        size_t pos = 1;
+        size_t hdr_len = 0;
+        if (hdr_encoding != HeaderCompressor::kNone)
+        {
+            // the peer may compress even if this side does not
+            if (!headers_)
+                headers_ = make_unique<HeaderCompressor>(elide_macs_, local_mac_, peer_mac_);
+            size_t used = 0;
+            hdr_len = headers_->Decompress(hdr_encoding, data + pos, len - pos, used, out, out_cap);
+            if (hdr_len == 0)
+                return 0;
+            pos += used;
+        }
+        size_t rest = len - pos;
+        if (encoding & kPayloadCompressed)
+        {
+            if (!payload_)
+                payload_ = make_unique<PayloadCompressor>();
+            rest = payload_->Decode(data + pos, len - pos, out + hdr_len, out_cap - hdr_len);
+            if (rest == 0)
+                return 0;
+        }
+        else
+        {
+            if (rest > out_cap - hdr_len)
+                return 0;
+            memcpy(out + hdr_len, data + pos, rest);
+        }
+        if (hdr_encoding != HeaderCompressor::kNone)
+            headers_->Finish(hdr_encoding, out, hdr_len + rest);
+        return hdr_len + rest;
+    }
+
+    bool
+    FrameCodec::TakeContextRequest(
+        uint16_t &request)
+    {
+        return headers_ && headers_->TakeContextRequest(request);
+    }
+
+    void
+    FrameCodec::OnContextRequest(
+        uint16_t request)
+    {
+        if (headers_)
+            headers_->OnContextRequest(request);
+    }
+
+    void
+    FrameCodec::QueryInfo(
+        Json::Value &dp_info)
+    {
+        if (headers_)
+        {
+            headers_->QueryInfo(dp_info["HeaderCompressor"]);
+            dp_info["HeaderCompressor"]["Tx"] = compress_headers_;
+        }
+        if (payload_)
+            payload_->QueryInfo(dp_info["Compressor"]);
+    }
+} // namespace tincan
@@ -0,0 +1,92 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_FRAME_CODEC_H_
+#define TINCAN_FRAME_CODEC_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "header_compressor.h"
+#include "payload_compressor.h"
+namespace tincan
+{
+    /* Encodes the frames of a vlink that has header or payload compression
+    enabled. Headers are only compressed once EnableHeaderCompression is
+    called, after the peer advertised it can decode them. Every encoded
+    frame starts with one byte, the low bits hold the
+    HeaderCompressor::Encoding of the header section that follows and
+    kPayloadCompressed marks the remaining frame bytes as an LZ4 section.
+    Only used on the network thread.
+    */
+    class FrameCodec
+    {
+    public:
+        static const uint8_t kHeaderMask = 0x0f;
+        static const uint8_t kPayloadCompressed = 0x10;
+
+        FrameCodec(
+            bool header_compression,
+            bool payload_compression,
+            bool elide_macs,
+            const MacAddressType &local_mac,
+            const MacAddressType &peer_mac);
+        FrameCodec(const FrameCodec &) = delete;
+        FrameCodec &operator=(const FrameCodec &) = delete;
+
+        void EnableHeaderCompression();
+
+        // Writes the encoded frame to out and returns its length. A header
+        // definition can make the result larger than the frame, cap bounds
+        // that growth and must be at least len + 1.
+        size_t Encode(
+            const char *frame,
+            size_t len,
+            char *out,
+            size_t cap);
+
+        // Returns the decoded length, or 0 if the frame cannot be decoded.
+        size_t Decode(
+            const char *data,
+            size_t len,
+            char *out,
+            size_t out_cap);
+
+        // header context requests for the peer, see HeaderCompressor
+        bool TakeContextRequest(
+            uint16_t &request);
+
+        void OnContextRequest(
+            uint16_t request);
+
+        void QueryInfo(
+            Json::Value &dp_info);
+
+    private:
+        const bool elide_macs_;
+        const MacAddressType local_mac_;
+        const MacAddressType peer_mac_;
+        // the decoder is created for any peer, the encoder needs its consent
+        bool compress_headers_;
+        unique_ptr<HeaderCompressor> headers_;
+        unique_ptr<PayloadCompressor> payload_;
+    };
+} // namespace tincan
+#endif // TINCAN_FRAME_CODEC_H_
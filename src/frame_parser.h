@@ -0,0 +1,164 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_FRAME_PARSER_H_
+#define TINCAN_FRAME_PARSER_H_
+#include "tincan_base.h"
+namespace tincan
+{
+    /* Locates the L3/L4 headers of an Ethernet frame read from the TAP and
+    derives a flow hash from the 5-tuple. Only the fields the datapath
+    stages need are extracted, IPv6 extension headers are not walked.
+    */
+    struct FrameInfo
+    {
+        static const uint16_t kEtherTypeIPv4 = 0x0800;
+        static const uint16_t kEtherTypeIPv6 = 0x86DD;
+        static const uint16_t kEtherTypeVlan = 0x8100;
+        static const uint8_t kProtoTcp = 6;
+        static const uint8_t kProtoUdp = 17;
+
+        uint16_t ether_type = 0;
+        size_t l3_offset = 0;
+        size_t l4_offset = 0;
+        size_t payload_offset = 0;
+        // end of the IP packet, short of any Ethernet padding
+        size_t ip_end = 0;
+        uint8_t ip_proto = 0;
+        uint8_t dscp = 0;
+        uint32_t flow_hash = 0;
+
+        bool IsIPv4() const { return ether_type == kEtherTypeIPv4; }
+        bool IsIPv6() const { return ether_type == kEtherTypeIPv6; }
+        bool IsTcp() const { return l4_offset && ip_proto == kProtoTcp; }
+        bool IsUdp() const { return l4_offset && ip_proto == kProtoUdp; }
+
+        static uint16_t
+        Read16(
+            const uint8_t *p)
+        {
+            return static_cast<uint16_t>((p[0] << 8) | p[1]);
+        }
+
+        static uint32_t
+        Read32(
+            const uint8_t *p)
+        {
+            return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                   (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+
+        // RFC 1624 eqn. 3, HC' = ~(~HC + ~m + m')
+        static uint16_t
+        UpdateChecksum(
+            uint16_t hc,
+            uint16_t old_val,
+            uint16_t new_val)
+        {
+            uint32_t sum = uint16_t(~hc) + uint16_t(~old_val) + uint32_t(new_val);
+            sum = (sum & 0xffff) + (sum >> 16);
+            sum = (sum & 0xffff) + (sum >> 16);
+            return static_cast<uint16_t>(~sum);
+        }
+
+        // FNV-1a, good enough to spread flows over small tables
+        static uint32_t
+        Hash(
+            uint32_t h,
+            const uint8_t *p,
+            size_t len)
+        {
+            for (size_t i = 0; i < len; ++i)
+                h = (h ^ p[i]) * 16777619u;
+            return h;
+        }
+
+        // Returns false for frames too short to hold an Ethernet header.
+        static bool
+        Parse(
+            const char *data,
+            size_t len,
+            FrameInfo &info)
+        {
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+            if (len < kEthernetHeaderSz)
+                return false;
+            info = FrameInfo();
+            size_t pos = 12;
+            info.ether_type = Read16(p + pos);
+            pos += 2;
+            if (info.ether_type == kEtherTypeVlan && len >= pos + 4)
+            {
+                info.ether_type = Read16(p + pos + 2);
+                pos += 4;
+            }
+            info.l3_offset = pos;
+            info.payload_offset = pos;
+            info.ip_end = len;
+            uint32_t h = 2166136261u;
+            h = Hash(h, p + 12, 2);
+            if (info.IsIPv4() && len >= pos + 20)
+            {
+                const size_t ihl = (p[pos] & 0x0f) * 4;
+                if (ihl < 20 || len < pos + ihl)
+                    return true;
+                info.dscp = p[pos + 1] >> 2;
+                info.ip_proto = p[pos + 9];
+                info.ip_end = std::min(len, pos + Read16(p + pos + 2));
+                h = Hash(h, p + pos + 9, 1);
+                h = Hash(h, p + pos + 12, 8);
+                // only the first fragment carries the L4 header
+                if ((Read16(p + pos + 6) & 0x1fff) == 0)
+                    info.l4_offset = pos + ihl;
+                info.payload_offset = pos + ihl;
+            }
+            else if (info.IsIPv6() && len >= pos + 40)
+            {
+                info.dscp = static_cast<uint8_t>((Read16(p + pos) >> 6) & 0x3f);
+                info.ip_proto = p[pos + 6];
+                info.ip_end = std::min(len, pos + 40 + Read16(p + pos + 4));
+                h = Hash(h, p + pos + 6, 1);
+                h = Hash(h, p + pos + 8, 32);
+                info.l4_offset = pos + 40;
+                info.payload_offset = pos + 40;
+            }
+            if (info.IsTcp() && len >= info.l4_offset + 20)
+            {
+                h = Hash(h, p + info.l4_offset, 4);
+                info.payload_offset = info.l4_offset + (p[info.l4_offset + 12] >> 4) * 4;
+            }
+            else if (info.IsUdp() && len >= info.l4_offset + 8)
+            {
+                h = Hash(h, p + info.l4_offset, 4);
+                info.payload_offset = info.l4_offset + 8;
+            }
+            else
+            {
+                info.l4_offset = 0;
+            }
+            info.payload_offset = std::min(info.payload_offset, len);
+            info.flow_hash = h;
+            return true;
+        }
+    };
+} // namespace tincan
+#endif // TINCAN_FRAME_PARSER_H_
@@ -0,0 +1,258 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "gf256.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TINCAN_GF256_X86 1
+#endif
+namespace tincan
+{
+    namespace
+    {
+        using KernelFn = size_t (*)(uint8_t *, const uint8_t *, const uint8_t *, const uint8_t *, size_t);
+
+        size_t
+        MulAddNone(
+            uint8_t *,
+            const uint8_t *,
+            const uint8_t *,
+            const uint8_t *,
+            size_t)
+        {
+            return 0;
+        }
+
+#if defined(TINCAN_GF256_X86)
+        __attribute__((target("ssse3"))) size_t
+        MulAddSsse3(
+            uint8_t *dst,
+            const uint8_t *src,
+            const uint8_t *lo,
+            const uint8_t *hi,
+            size_t len)
+        {
+            const __m128i tlo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo));
+            const __m128i thi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi));
+            const __m128i mask = _mm_set1_epi8(0x0f);
+            size_t i = 0;
+            for (; i + 16 <= len; i += 16)
+            {
+                const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                const __m128i l = _mm_and_si128(s, mask);
+                const __m128i h = _mm_and_si128(_mm_srli_epi64(s, 4), mask);
+                const __m128i p = _mm_xor_si128(_mm_shuffle_epi8(tlo, l), _mm_shuffle_epi8(thi, h));
+                __m128i *d = reinterpret_cast<__m128i *>(dst + i);
+                _mm_storeu_si128(d, _mm_xor_si128(_mm_loadu_si128(d), p));
+            }
+            return i;
+        }
+
+        __attribute__((target("avx2"))) size_t
+        MulAddAvx2(
+            uint8_t *dst,
+            const uint8_t *src,
+            const uint8_t *lo,
+            const uint8_t *hi,
+            size_t len)
+        {
+            const __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo)));
+            const __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(hi)));
+            const __m256i mask = _mm256_set1_epi8(0x0f);
+            size_t i = 0;
+            for (; i + 32 <= len; i += 32)
+            {
+                const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                const __m256i l = _mm256_and_si256(s, mask);
+                const __m256i h = _mm256_and_si256(_mm256_srli_epi64(s, 4), mask);
+                const __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tlo, l), _mm256_shuffle_epi8(thi, h));
+                __m256i *d = reinterpret_cast<__m256i *>(dst + i);
+                _mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(d), p));
+            }
+            return i;
+        }
+#endif
+
+        struct KernelInfo
+        {
+            KernelFn fn;
+            const char *name;
+        };
+
+        KernelInfo
+        SelectKernel()
+        {
+#if defined(TINCAN_GF256_X86)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return {MulAddAvx2, "AVX2"};
+            if (__builtin_cpu_supports("ssse3"))
+                return {MulAddSsse3, "SSSE3"};
+#endif
+            return {MulAddNone, "Scalar"};
+        }
+
+        const KernelInfo &
+        ActiveKernel()
+        {
+            static const KernelInfo kernel = SelectKernel();
+            return kernel;
+        }
+    } // namespace
+
+    Gf256::Tables::Tables()
+    {
+        unsigned x = 1;
+        for (int i = 0; i < 255; ++i)
+        {
+            exp[i] = static_cast<uint8_t>(x);
+            log[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100)
+                x ^= 0x11d;
+        }
+        // doubled so a sum of two logs needs no modulo
+        for (int i = 255; i < 512; ++i)
+            exp[i] = exp[i - 255];
+        log[0] = 0;
+        for (int c = 0; c < 256; ++c)
+        {
+            for (int n = 0; n < 16; ++n)
+            {
+                lo[c][n] = c && n ? exp[log[c] + log[n]] : 0;
+                hi[c][n] = c && n ? exp[log[c] + log[n << 4]] : 0;
+            }
+        }
+    }
+
+    const Gf256::Tables &
+    Gf256::Get()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    uint8_t
+    Gf256::Mul(
+        uint8_t a,
+        uint8_t b)
+    {
+        if (a == 0 || b == 0)
+            return 0;
+        const Tables &t = Get();
+        return t.exp[t.log[a] + t.log[b]];
+    }
+
+    uint8_t
+    Gf256::Inv(
+        uint8_t a)
+    {
+        const Tables &t = Get();
+        return a ? t.exp[255 - t.log[a]] : 0;
+    }
+
+    void
+    Gf256::MulAdd(
+        uint8_t *dst,
+        const uint8_t *src,
+        uint8_t c,
+        size_t len)
+    {
+        if (c == 0)
+            return;
+        size_t i = 0;
+        if (c == 1)
+        {
+            for (; i + 8 <= len; i += 8)
+            {
+                uint64_t d, s;
+                memcpy(&d, dst + i, 8);
+                memcpy(&s, src + i, 8);
+                d ^= s;
+                memcpy(dst + i, &d, 8);
+            }
+            for (; i < len; ++i)
+                dst[i] ^= src[i];
+            return;
+        }
+        const Tables &t = Get();
+        i = ActiveKernel().fn(dst, src, t.lo[c].data(), t.hi[c].data(), len);
+        const unsigned log_c = t.log[c];
+        for (; i < len; ++i)
+        {
+            if (src[i])
+                dst[i] ^= t.exp[log_c + t.log[src[i]]];
+        }
+    }
+
+    bool
+    Gf256::Invert(
+        uint8_t *m,
+        size_t n)
+    {
+        // Gauss-Jordan on [m | I], the identity becomes the inverse
+        vector<uint8_t> inv(n * n, 0);
+        for (size_t i = 0; i < n; ++i)
+            inv[i * n + i] = 1;
+        for (size_t col = 0; col < n; ++col)
+        {
+            size_t pivot = col;
+            while (pivot < n && m[pivot * n + col] == 0)
+                ++pivot;
+            if (pivot == n)
+                return false;
+            if (pivot != col)
+            {
+                for (size_t j = 0; j < n; ++j)
+                {
+                    std::swap(m[pivot * n + j], m[col * n + j]);
+                    std::swap(inv[pivot * n + j], inv[col * n + j]);
+                }
+            }
+            const uint8_t scale = Inv(m[col * n + col]);
+            for (size_t j = 0; j < n; ++j)
+            {
+                m[col * n + j] = Mul(m[col * n + j], scale);
+                inv[col * n + j] = Mul(inv[col * n + j], scale);
+            }
+            for (size_t row = 0; row < n; ++row)
+            {
+                const uint8_t f = m[row * n + col];
+                if (row == col || f == 0)
+                    continue;
+                for (size_t j = 0; j < n; ++j)
+                {
+                    m[row * n + j] ^= Mul(f, m[col * n + j]);
+                    inv[row * n + j] ^= Mul(f, inv[col * n + j]);
+                }
+            }
+        }
+        memcpy(m, inv.data(), n * n);
+        return true;
+    }
+
+    const char *
+    Gf256::Kernel()
+    {
+        return ActiveKernel().name;
+    }
+} // namespace tincan
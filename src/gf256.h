@@ -0,0 +1,73 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_GF256_H_
+#define TINCAN_GF256_H_
+#include "tincan_base.h"
+namespace tincan
+{
+    /* Arithmetic in GF(2^8) over the 0x11d polynomial, for the FEC codec.
+    The region kernel multiplies 16 or 32 bytes at a time with SSSE3 or AVX2
+    byte shuffles through 4-bit product tables when the CPU has them, and
+    falls back to log/exp tables otherwise.
+    */
+    class Gf256
+    {
+    public:
+        static uint8_t Mul(
+            uint8_t a,
+            uint8_t b);
+
+        static uint8_t Inv(
+            uint8_t a);
+
+        // dst[i] ^= c * src[i]
+        static void MulAdd(
+            uint8_t *dst,
+            const uint8_t *src,
+            uint8_t c,
+            size_t len);
+
+        // Inverts the row-major n x n matrix in place, returns false if it
+        // is singular.
+        static bool Invert(
+            uint8_t *m,
+            size_t n);
+
+        // the region kernel in use, for stats
+        static const char *Kernel();
+
+    private:
+        struct Tables
+        {
+            Tables();
+            array<uint8_t, 512> exp;
+            array<uint8_t, 256> log;
+            // products of each constant with the low and high nibbles
+            array<array<uint8_t, 16>, 256> lo;
+            array<array<uint8_t, 16>, 256> hi;
+        };
+
+        static const Tables &Get();
+    };
+} // namespace tincan
+#endif // TINCAN_GF256_H_
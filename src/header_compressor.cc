@@ -0,0 +1,545 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "header_compressor.h"
+namespace tincan
+{
+    namespace
+    {
+        // bits of the delta mask, set for each field that differs from the
+        // reference and follows in this order
+        const uint8_t kSeq = 0x01;
+        const uint8_t kAck = 0x02;
+        const uint8_t kWindow = 0x04;
+        const uint8_t kFlags = 0x08;
+        const uint8_t kTosTtl = 0x10;
+        const uint8_t kOptions = 0x20;
+        const uint8_t kTimestamps = 0x40;
+
+        // deltas that need more than 3 bytes force a new reference
+        const uint32_t kMaxVarint = 1u << 21;
+
+        bool
+        PutVarint(
+            uint32_t v,
+            uint8_t *&op)
+        {
+            if (v >= kMaxVarint)
+                return false;
+            while (v >= 0x80)
+            {
+                *op++ = static_cast<uint8_t>(v | 0x80);
+                v >>= 7;
+            }
+            *op++ = static_cast<uint8_t>(v);
+            return true;
+        }
+
+        bool
+        GetVarint(
+            const uint8_t *in,
+            size_t len,
+            size_t &pos,
+            uint32_t &v)
+        {
+            v = 0;
+            for (int shift = 0; shift < 21; shift += 7)
+            {
+                if (pos >= len)
+                    return false;
+                const uint8_t b = in[pos++];
+                v |= uint32_t(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        void
+        Write16(
+            uint8_t *p,
+            uint16_t v)
+        {
+            p[0] = static_cast<uint8_t>(v >> 8);
+            p[1] = static_cast<uint8_t>(v);
+        }
+
+        void
+        Write32(
+            uint8_t *p,
+            uint32_t v)
+        {
+            p[0] = static_cast<uint8_t>(v >> 24);
+            p[1] = static_cast<uint8_t>(v >> 16);
+            p[2] = static_cast<uint8_t>(v >> 8);
+            p[3] = static_cast<uint8_t>(v);
+        }
+
+        // NOP, NOP, timestamp, the layout Linux puts on every segment
+        bool
+        IsTimestampOnly(
+            const uint8_t *opt,
+            size_t len)
+        {
+            return len == 12 && opt[0] == 1 && opt[1] == 1 && opt[2] == 8 && opt[3] == 10;
+        }
+    } // namespace
+
+    HeaderCompressor::HeaderCompressor(
+        bool elide_macs,
+        const MacAddressType &local_mac,
+        const MacAddressType &peer_mac) : elide_macs_(elide_macs),
+                                          local_mac_(local_mac),
+                                          peer_mac_(peer_mac),
+                                          tx_frames_(0),
+                                          tx_contexts_(0),
+                                          tx_deltas_(0),
+                                          tx_macs_elided_(0),
+                                          tx_in_bytes_(0),
+                                          tx_out_bytes_(0),
+                                          tx_collisions_(0),
+                                          tx_context_requests_(0),
+                                          rx_context_requests_(0),
+                                          rx_context_misses_(0),
+                                          rx_errors_(0)
+    {
+    }
+
+    size_t
+    HeaderCompressor::Compress(
+        const FrameInfo &info,
+        const char *frame,
+        size_t len,
+        char *out,
+        size_t room,
+        size_t &consumed,
+        uint8_t &encoding)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(frame);
+        consumed = 0;
+        encoding = kNone;
+        if (Eligible(info, p, len) && !Collides(info, p))
+        {
+            const size_t hdr_len = info.payload_offset;
+            Context &ctx = tx_ctx_[info.flow_hash % kContexts];
+            array<uint8_t, kMaxSectionSz> section;
+            uint8_t *op = section.data() + 2;
+            size_t delta_len = 0;
+            bool define = !ctx.valid || ctx.flow_hash != info.flow_hash ||
+                          ctx.uses >= kRefreshInterval || !SameFlow(ctx, p);
+            if (!define && ctx.repeats_left == 0)
+            {
+                delta_len = WriteDelta(ctx, p, hdr_len, op);
+                define = delta_len == 0;
+            }
+            if (define)
+            {
+                ctx.valid = true;
+                ++ctx.gen;
+                ctx.flow_hash = info.flow_hash;
+                ctx.uses = 0;
+                ctx.repeats_left = kContextRepeats;
+                ctx.hdr_len = hdr_len;
+                memcpy(ctx.hdr.data(), p, hdr_len);
+            }
+            section[0] = static_cast<uint8_t>(info.flow_hash % kContexts);
+            section[1] = ctx.gen;
+            uint8_t enc = kDelta;
+            if (ctx.repeats_left > 0)
+            {
+                enc = kContext;
+                *op++ = static_cast<uint8_t>(ctx.hdr_len);
+                memcpy(op, ctx.hdr.data(), ctx.hdr_len);
+                op += ctx.hdr_len;
+                delta_len = WriteDelta(ctx, p, hdr_len, op);
+            }
+            const size_t section_len = op + delta_len - section.data();
+            // a definition that does not fit waits for a smaller frame
+            if (delta_len > 0 && section_len <= room)
+            {
+                memcpy(out, section.data(), section_len);
+                ++ctx.uses;
+                ctx.last_use = ++tx_frames_;
+                if (enc == kContext)
+                {
+                    --ctx.repeats_left;
+                    ++tx_contexts_;
+                }
+                else
+                {
+                    ++tx_deltas_;
+                }
+                tx_in_bytes_ += hdr_len;
+                tx_out_bytes_ += section_len;
+                consumed = hdr_len;
+                encoding = enc;
+                return section_len;
+            }
+        }
+        if (elide_macs_ && len >= 12 &&
+            memcmp(p, peer_mac_.data(), 6) == 0 && memcmp(p + 6, local_mac_.data(), 6) == 0)
+        {
+            ++tx_macs_elided_;
+            tx_in_bytes_ += 12;
+            consumed = 12;
+            encoding = kMacsElided;
+        }
+        return 0;
+    }
+
+    size_t
+    HeaderCompressor::Decompress(
+        uint8_t encoding,
+        const char *data,
+        size_t len,
+        size_t &used,
+        char *out,
+        size_t out_cap)
+    {
+        const uint8_t *in = reinterpret_cast<const uint8_t *>(data);
+        uint8_t *op = reinterpret_cast<uint8_t *>(out);
+        used = 0;
+        if (encoding == kMacsElided)
+        {
+            if (out_cap < 12)
+                return 0;
+            // the sender's peer is this side
+            memcpy(op, local_mac_.data(), 6);
+            memcpy(op + 6, peer_mac_.data(), 6);
+            return 12;
+        }
+        if ((encoding != kContext && encoding != kDelta) || len < 3)
+        {
+            ++rx_errors_;
+            return 0;
+        }
+        Context &ctx = rx_ctx_[in[0]];
+        const uint8_t gen = in[1];
+        size_t pos = 2;
+        if (encoding == kContext)
+        {
+            const size_t hdr_len = in[pos++];
+            const uint8_t *hdr = in + pos;
+            if (hdr_len < kTcpOffset + kTcpBaseSz || hdr_len > kMaxHeaderSz || len < pos + hdr_len ||
+                hdr[kIpOffset] != 0x45 || hdr[kIpOffset + 9] != FrameInfo::kProtoTcp ||
+                kTcpOffset + (hdr[kTcpOffset + 12] >> 4) * 4 != hdr_len)
+            {
+                ++rx_errors_;
+                return 0;
+            }
+            ctx.valid = true;
+            ctx.gen = gen;
+            ctx.requested = false;
+            ctx.hdr_len = hdr_len;
+            memcpy(ctx.hdr.data(), hdr, hdr_len);
+            pos += hdr_len;
+        }
+        else if (!ctx.valid || ctx.gen != gen)
+        {
+            ++rx_context_misses_;
+            // asked again if the request or the definitions it caused were lost
+            if (!ctx.requested || ctx.requested_gen != gen || ++ctx.misses >= kRequestRetry)
+            {
+                ctx.requested = true;
+                ctx.requested_gen = gen;
+                ctx.misses = 0;
+                rx_requests_.push_back(static_cast<uint16_t>(in[0] | gen << 8));
+                ++tx_context_requests_;
+            }
+            return 0;
+        }
+        size_t delta_len = 0;
+        size_t hdr_len = ReadDelta(ctx, in + pos, len - pos, op, out_cap, delta_len);
+        if (hdr_len == 0)
+        {
+            ++rx_errors_;
+            return 0;
+        }
+        used = pos + delta_len;
+        return hdr_len;
+    }
+
+    void
+    HeaderCompressor::Finish(
+        uint8_t encoding,
+        char *frame,
+        size_t len)
+    {
+        if (encoding != kContext && encoding != kDelta)
+            return;
+        uint8_t *ip = reinterpret_cast<uint8_t *>(frame) + kIpOffset;
+        Write16(ip + 2, static_cast<uint16_t>(len - kIpOffset));
+        Write16(ip + 10, 0);
+        uint32_t sum = 0;
+        for (size_t i = 0; i < 20; i += 2)
+            sum += FrameInfo::Read16(ip + i);
+        while (sum >> 16)
+            sum = (sum & 0xffff) + (sum >> 16);
+        Write16(ip + 10, static_cast<uint16_t>(~sum));
+    }
+
+    bool
+    HeaderCompressor::TakeContextRequest(
+        uint16_t &request)
+    {
+        if (rx_requests_.empty())
+            return false;
+        request = rx_requests_.front();
+        rx_requests_.pop_front();
+        return true;
+    }
+
+    void
+    HeaderCompressor::OnContextRequest(
+        uint16_t request)
+    {
+        Context &ctx = tx_ctx_[request & 0xff];
+        ++rx_context_requests_;
+        if (ctx.valid && ctx.gen == request >> 8)
+            ctx.repeats_left = kContextRepeats;
+    }
+
+    void
+    HeaderCompressor::QueryInfo(
+        Json::Value &info)
+    {
+        info["TxContexts"] = (Json::UInt64)tx_contexts_;
+        info["TxDeltas"] = (Json::UInt64)tx_deltas_;
+        info["TxMacsElided"] = (Json::UInt64)tx_macs_elided_;
+        info["BytesSaved"] = (Json::Int64)(tx_in_bytes_ - tx_out_bytes_);
+        info["TxCollisions"] = (Json::UInt64)tx_collisions_;
+        info["TxContextRequests"] = (Json::UInt64)tx_context_requests_;
+        info["RxContextRequests"] = (Json::UInt64)rx_context_requests_;
+        info["RxContextMisses"] = (Json::UInt64)rx_context_misses_;
+        info["RxErrors"] = (Json::UInt64)rx_errors_;
+    }
+
+    bool
+    HeaderCompressor::Eligible(
+        const FrameInfo &info,
+        const uint8_t *p,
+        size_t len) const
+    {
+        // untagged IPv4 without options carrying an unfragmented TCP
+        // segment without urgent data
+        if (!info.IsIPv4() || !info.IsTcp() || info.l3_offset != kIpOffset ||
+            info.l4_offset != kTcpOffset || p[kIpOffset] != 0x45)
+            return false;
+        const size_t tcp_len = (p[kTcpOffset + 12] >> 4) * 4;
+        if (tcp_len < kTcpBaseSz || kTcpOffset + tcp_len > len)
+            return false;
+        return FrameInfo::Read16(p + kIpOffset + 2) == len - kIpOffset &&
+               (FrameInfo::Read16(p + kIpOffset + 6) & 0x3fff) == 0 &&
+               !(p[kTcpOffset + 13] & 0x20) &&
+               FrameInfo::Read16(p + kTcpOffset + 18) == 0;
+    }
+
+    // Two live flows hashed to one context would redefine it on every frame
+    // and each frame would grow past its raw size. The flow holding the
+    // context keeps it until it goes idle, the other is sent uncompressed.
+    bool
+    HeaderCompressor::Collides(
+        const FrameInfo &info,
+        const uint8_t *p)
+    {
+        const Context &ctx = tx_ctx_[info.flow_hash % kContexts];
+        if (!ctx.valid || (ctx.flow_hash == info.flow_hash && SameFlow(ctx, p)) ||
+            tx_frames_ - ctx.last_use >= kStealIdle)
+            return false;
+        ++tx_collisions_;
+        return true;
+    }
+
+    bool
+    HeaderCompressor::SameFlow(
+        const Context &ctx,
+        const uint8_t *p)
+    {
+        const uint8_t *r = ctx.hdr.data();
+        return memcmp(p, r, kIpOffset) == 0 &&
+               p[kIpOffset + 6] == r[kIpOffset + 6] &&
+               memcmp(p + kIpOffset + 12, r + kIpOffset + 12, 8) == 0 &&
+               memcmp(p + kTcpOffset, r + kTcpOffset, 4) == 0 &&
+               (p[kTcpOffset + 12] & 0x0f) == (r[kTcpOffset + 12] & 0x0f);
+    }
+
+    size_t
+    HeaderCompressor::WriteDelta(
+        const Context &ctx,
+        const uint8_t *p,
+        size_t hdr_len,
+        uint8_t *out)
+    {
+        const uint8_t *r = ctx.hdr.data();
+        const uint8_t *ip = p + kIpOffset;
+        const uint8_t *rip = r + kIpOffset;
+        const uint8_t *tcp = p + kTcpOffset;
+        const uint8_t *rtcp = r + kTcpOffset;
+        uint8_t &mask = out[0];
+        uint8_t *op = out + 1;
+        mask = 0;
+        const uint32_t seq = FrameInfo::Read32(tcp + 4) - FrameInfo::Read32(rtcp + 4);
+        if (seq)
+        {
+            mask |= kSeq;
+            if (!PutVarint(seq, op))
+                return 0;
+        }
+        const uint32_t ack = FrameInfo::Read32(tcp + 8) - FrameInfo::Read32(rtcp + 8);
+        if (ack)
+        {
+            mask |= kAck;
+            if (!PutVarint(ack, op))
+                return 0;
+        }
+        if (memcmp(tcp + 14, rtcp + 14, 2) != 0)
+        {
+            mask |= kWindow;
+            *op++ = tcp[14];
+            *op++ = tcp[15];
+        }
+        if (tcp[13] != rtcp[13])
+        {
+            mask |= kFlags;
+            *op++ = tcp[13];
+        }
+        if (ip[1] != rip[1] || ip[8] != rip[8])
+        {
+            mask |= kTosTtl;
+            *op++ = ip[1];
+            *op++ = ip[8];
+        }
+        const uint8_t *opt = tcp + kTcpBaseSz;
+        const uint8_t *ropt = rtcp + kTcpBaseSz;
+        const size_t opt_len = hdr_len - kTcpOffset - kTcpBaseSz;
+        const size_t ropt_len = ctx.hdr_len - kTcpOffset - kTcpBaseSz;
+        if (opt_len != ropt_len || memcmp(opt, ropt, opt_len) != 0)
+        {
+            if (IsTimestampOnly(opt, opt_len) && IsTimestampOnly(ropt, ropt_len))
+            {
+                mask |= kTimestamps;
+                if (!PutVarint(FrameInfo::Read32(opt + 4) - FrameInfo::Read32(ropt + 4), op) ||
+                    !PutVarint(FrameInfo::Read32(opt + 8) - FrameInfo::Read32(ropt + 8), op))
+                    return 0;
+            }
+            else
+            {
+                mask |= kOptions;
+                *op++ = static_cast<uint8_t>(opt_len);
+                memcpy(op, opt, opt_len);
+                op += opt_len;
+            }
+        }
+        const uint16_t ip_id = FrameInfo::Read16(ip + 4) - FrameInfo::Read16(rip + 4);
+        PutVarint(ip_id, op);
+        *op++ = tcp[16];
+        *op++ = tcp[17];
+        return op - out;
+    }
+
+    size_t
+    HeaderCompressor::ReadDelta(
+        const Context &ctx,
+        const uint8_t *in,
+        size_t len,
+        uint8_t *out,
+        size_t out_cap,
+        size_t &used)
+    {
+        const uint8_t *r = ctx.hdr.data();
+        const uint8_t *ropt = r + kTcpOffset + kTcpBaseSz;
+        const size_t ropt_len = ctx.hdr_len - kTcpOffset - kTcpBaseSz;
+        uint8_t *ip = out + kIpOffset;
+        uint8_t *tcp = out + kTcpOffset;
+        if (len < 1 || out_cap < kMaxHeaderSz)
+            return 0;
+        const uint8_t mask = in[0];
+        size_t pos = 1;
+        uint32_t v = 0;
+        memcpy(out, r, kTcpOffset + kTcpBaseSz);
+        if (mask & kSeq)
+        {
+            if (!GetVarint(in, len, pos, v))
+                return 0;
+            Write32(tcp + 4, FrameInfo::Read32(r + kTcpOffset + 4) + v);
+        }
+        if (mask & kAck)
+        {
+            if (!GetVarint(in, len, pos, v))
+                return 0;
+            Write32(tcp + 8, FrameInfo::Read32(r + kTcpOffset + 8) + v);
+        }
+        if (mask & kWindow)
+        {
+            if (len < pos + 2)
+                return 0;
+            tcp[14] = in[pos++];
+            tcp[15] = in[pos++];
+        }
+        if (mask & kFlags)
+        {
+            if (len < pos + 1)
+                return 0;
+            tcp[13] = in[pos++];
+        }
+        if (mask & kTosTtl)
+        {
+            if (len < pos + 2)
+                return 0;
+            ip[1] = in[pos++];
+            ip[8] = in[pos++];
+        }
+        uint8_t *opt = tcp + kTcpBaseSz;
+        size_t opt_len = ropt_len;
+        if (mask & kOptions)
+        {
+            if (len < pos + 1)
+                return 0;
+            opt_len = in[pos++];
+            if (opt_len % 4 || opt_len > 40 || len < pos + opt_len)
+                return 0;
+            memcpy(opt, in + pos, opt_len);
+            pos += opt_len;
+        }
+        else
+        {
+            memcpy(opt, ropt, ropt_len);
+            if (mask & kTimestamps)
+            {
+                if (!IsTimestampOnly(ropt, ropt_len) || !GetVarint(in, len, pos, v))
+                    return 0;
+                Write32(opt + 4, FrameInfo::Read32(ropt + 4) + v);
+                if (!GetVarint(in, len, pos, v))
+                    return 0;
+                Write32(opt + 8, FrameInfo::Read32(ropt + 8) + v);
+            }
+        }
+        tcp[12] = static_cast<uint8_t>(((kTcpBaseSz + opt_len) / 4) << 4 | (r[kTcpOffset + 12] & 0x0f));
+        if (!GetVarint(in, len, pos, v) || len < pos + 2)
+            return 0;
+        Write16(ip + 4, static_cast<uint16_t>(FrameInfo::Read16(r + kIpOffset + 4) + v));
+        tcp[16] = in[pos++];
+        tcp[17] = in[pos++];
+        used = pos;
+        return kTcpOffset + kTcpBaseSz + opt_len;
+    }
+} // namespace tincan
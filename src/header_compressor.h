@@ -0,0 +1,188 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_HEADER_COMPRESSOR_H_
+#define TINCAN_HEADER_COMPRESSOR_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "frame_parser.h"
+namespace tincan
+{
+    /* Per-flow compression of the Ethernet/IPv4/TCP headers of frames sent
+    over a vlink. The sender keeps a reference header per context and sends
+    only what changed relative to it; the receiver rebuilds the frame and
+    recomputes the IP length and checksum. Every delta is taken against the
+    fixed reference rather than the last frame, so a lost frame never
+    corrupts the ones after it. A context definition is repeated on the
+    first kContextRepeats frames and refreshed every kRefreshInterval
+    frames. A receiver that gets a delta for a definition it lost drops the
+    frame and queues a context request, the vlink sends it on its control
+    channel and the sender repeats the definition. A flow whose context is
+    held by another live flow is not compressed, so two colliding flows do
+    not redefine it on every frame.
+    Frames that do not qualify can still have their MAC addresses elided
+    when they travel between the two TAP devices of the link.
+    */
+    class HeaderCompressor
+    {
+    public:
+        // the header encoding, held in the low bits of the frame encoding byte
+        enum Encoding : uint8_t
+        {
+            kNone = 0,
+            // [cid][gen][len][reference header][delta]
+            kContext = 1,
+            // [cid][gen][delta]
+            kDelta = 2,
+            // the frame without its destination and source MAC
+            kMacsElided = 3,
+        };
+
+        HeaderCompressor(
+            bool elide_macs,
+            const MacAddressType &local_mac,
+            const MacAddressType &peer_mac);
+        HeaderCompressor(const HeaderCompressor &) = delete;
+        HeaderCompressor &operator=(const HeaderCompressor &) = delete;
+
+        // Writes the compressed header section to out if it fits in room,
+        // and sets consumed to the number of leading frame bytes it stands
+        // for. Returns the section length, encoding is kNone when nothing
+        // was compressed.
+        size_t Compress(
+            const FrameInfo &info,
+            const char *frame,
+            size_t len,
+            char *out,
+            size_t room,
+            size_t &consumed,
+            uint8_t &encoding);
+
+        // Rebuilds the leading frame bytes into out and sets used to the
+        // section length. Returns the number of bytes rebuilt, or 0 if the
+        // section is malformed or its context is unknown.
+        size_t Decompress(
+            uint8_t encoding,
+            const char *data,
+            size_t len,
+            size_t &used,
+            char *out,
+            size_t out_cap);
+
+        // Fixes the IP length and checksum once the rest of the frame
+        // follows the rebuilt headers.
+        void Finish(
+            uint8_t encoding,
+            char *frame,
+            size_t len);
+
+        // Takes a request queued by Decompress for the peer, the context id
+        // in the low byte and the generation it is missing in the high one.
+        bool TakeContextRequest(
+            uint16_t &request);
+
+        // Repeats the definition the peer asked for, unless it was replaced.
+        void OnContextRequest(
+            uint16_t request);
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        static const size_t kContexts = 256;
+        static const size_t kIpOffset = kEthernetHeaderSz;
+        static const size_t kTcpOffset = kIpOffset + 20;
+        static const size_t kTcpBaseSz = 20;
+        static const size_t kMaxHeaderSz = kTcpOffset + 60;
+        // largest section, a definition plus a delta carrying every field
+        static const size_t kMaxSectionSz = 3 + kMaxHeaderSz + 64;
+        static const uint32_t kContextRepeats = 3;
+        static const uint32_t kRefreshInterval = 256;
+        // compressed frames a context must go unused before another flow
+        // may take it
+        static const uint64_t kStealIdle = 64;
+        // misses of a requested definition before it is asked for again
+        static const uint32_t kRequestRetry = 8;
+
+        struct Context
+        {
+            bool valid = false;
+            uint8_t gen = 0;
+            uint32_t flow_hash = 0;
+            uint32_t uses = 0;
+            uint32_t repeats_left = 0;
+            uint64_t last_use = 0;
+            // receive side, the generation asked for and misses since
+            bool requested = false;
+            uint8_t requested_gen = 0;
+            uint32_t misses = 0;
+            size_t hdr_len = 0;
+            array<uint8_t, kMaxHeaderSz> hdr;
+        };
+
+        bool Eligible(
+            const FrameInfo &info,
+            const uint8_t *p,
+            size_t len) const;
+
+        bool Collides(
+            const FrameInfo &info,
+            const uint8_t *p);
+
+        static bool SameFlow(
+            const Context &ctx,
+            const uint8_t *p);
+
+        static size_t WriteDelta(
+            const Context &ctx,
+            const uint8_t *p,
+            size_t hdr_len,
+            uint8_t *out);
+
+        static size_t ReadDelta(
+            const Context &ctx,
+            const uint8_t *in,
+            size_t len,
+            uint8_t *out,
+            size_t out_cap,
+            size_t &used);
+
+        const bool elide_macs_;
+        const MacAddressType local_mac_;
+        const MacAddressType peer_mac_;
+        array<Context, kContexts> tx_ctx_;
+        array<Context, kContexts> rx_ctx_;
+        deque<uint16_t> rx_requests_;
+        uint64_t tx_frames_;
+        uint64_t tx_contexts_;
+        uint64_t tx_deltas_;
+        uint64_t tx_macs_elided_;
+        uint64_t tx_in_bytes_;
+        uint64_t tx_out_bytes_;
+        uint64_t tx_collisions_;
+        uint64_t tx_context_requests_;
+        uint64_t rx_context_requests_;
+        uint64_t rx_context_misses_;
+        uint64_t rx_errors_;
+    };
+} // namespace tincan
+#endif // TINCAN_HEADER_COMPRESSOR_H_
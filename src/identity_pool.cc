@@ -0,0 +1,148 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "identity_pool.h"
+#include "rtc_base/logging.h"
+namespace tincan
+{
+    // The identity is only checked against the peer's fingerprint, so every
+    // pooled identity uses the same common name.
+    static const char *const kIdentityName = "EdgeVPNio";
+
+    IdentityPool::IdentityPool(
+        size_t pool_size) : pool_size_(pool_size),
+                            exit_flag_(false),
+                            hits_(0),
+                            misses_(0),
+                            generator_(&IdentityPool::Run, this)
+    {
+    }
+
+    IdentityPool::~IdentityPool()
+    {
+        {
+            lock_guard<mutex> lg(pool_mutex_);
+            exit_flag_ = true;
+        }
+        pool_cv_.notify_all();
+        generator_.join();
+    }
+
+    void
+    IdentityPool::Reserve(
+        rtc::KeyType key_type)
+    {
+        {
+            lock_guard<mutex> lg(pool_mutex_);
+            ready_[key_type];
+        }
+        pool_cv_.notify_one();
+    }
+
+    unique_ptr<rtc::SSLIdentity>
+    IdentityPool::Get(
+        rtc::KeyType key_type)
+    {
+        unique_ptr<rtc::SSLIdentity> sslid;
+        {
+            lock_guard<mutex> lg(pool_mutex_);
+            auto &ready = ready_[key_type];
+            if (!ready.empty())
+            {
+                sslid = std::move(ready.front());
+                ready.pop_front();
+                hits_++;
+            }
+            else
+            {
+                misses_++;
+            }
+        }
+        pool_cv_.notify_one();
+        if (!sslid)
+        {
+            auto start = steady_clock::now();
+            sslid = Generate(key_type);
+            RTC_LOG(LS_WARNING) << "Identity pool empty, generated a " << KeyTypeName(key_type)
+                                << " identity inline in "
+                                << std::chrono::duration_cast<milliseconds>(steady_clock::now() - start).count()
+                                << "ms";
+        }
+        return sslid;
+    }
+
+    void
+    IdentityPool::Run()
+    {
+        std::unique_lock<mutex> ul(pool_mutex_);
+        while (!exit_flag_)
+        {
+            // the emptiest first, so every reserved type gets one early
+            auto low = std::min_element(ready_.begin(), ready_.end(), [](const auto &a, const auto &b)
+                                        { return a.second.size() < b.second.size(); });
+            if (low == ready_.end() || low->second.size() >= pool_size_)
+            {
+                pool_cv_.wait(ul);
+                continue;
+            }
+            rtc::KeyType key_type = low->first;
+            ul.unlock();
+            auto sslid = Generate(key_type);
+            ul.lock();
+            if (sslid)
+            {
+                ready_[key_type].push_back(std::move(sslid));
+            }
+            else
+            {
+                RTC_LOG(LS_ERROR) << "Failed to generate a " << KeyTypeName(key_type) << " identity";
+                pool_cv_.wait_for(ul, std::chrono::seconds(1));
+            }
+        }
+    }
+
+    unique_ptr<rtc::SSLIdentity>
+    IdentityPool::Generate(
+        rtc::KeyType key_type)
+    {
+        return rtc::SSLIdentity::Create(kIdentityName, key_type);
+    }
+
+    const char *
+    IdentityPool::KeyTypeName(
+        rtc::KeyType key_type)
+    {
+        return key_type == rtc::KT_ECDSA ? "ECDSA" : "RSA";
+    }
+
+    void
+    IdentityPool::QueryInfo(
+        Json::Value &pool_info)
+    {
+        lock_guard<mutex> lg(pool_mutex_);
+        pool_info["Hits"] = (Json::UInt64)hits_;
+        pool_info["Misses"] = (Json::UInt64)misses_;
+        pool_info["Ready"] = Json::Value(Json::objectValue);
+        for (const auto &ready : ready_)
+            pool_info["Ready"][KeyTypeName(ready.first)] = (Json::UInt64)ready.second.size();
+    }
+} // namespace tincan
@@ -0,0 +1,78 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_IDENTITY_POOL_H_
+#define TINCAN_IDENTITY_POOL_H_
+#include "tincan_base.h"
+#include <condition_variable>
+#include "rtc_base/ssl_identity.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* Generates DTLS identities on a background thread so tunnels can be
+    created without paying for key generation on the epoll thread. A small
+    number of identities is kept ready for every key type that has been
+    reserved. An identity is never handed out twice, its fingerprint is
+    what authenticates the tunnel to the peer, so a burst of tunnels that
+    drains the pool pays for generation inline.
+    */
+    class IdentityPool
+    {
+    public:
+        static const size_t kDefaultPoolSize = 4;
+        explicit IdentityPool(size_t pool_size = kDefaultPoolSize);
+        IdentityPool(const IdentityPool &) = delete;
+        IdentityPool &operator=(const IdentityPool &) = delete;
+        ~IdentityPool();
+
+        // Starts keeping identities of this type ready.
+        void Reserve(
+            rtc::KeyType key_type);
+
+        // Returns a ready identity, or generates one inline if the pool for
+        // this key type has run dry.
+        unique_ptr<rtc::SSLIdentity> Get(
+            rtc::KeyType key_type);
+
+        void QueryInfo(
+            Json::Value &pool_info);
+
+    private:
+        void Run();
+
+        static unique_ptr<rtc::SSLIdentity> Generate(
+            rtc::KeyType key_type);
+
+        static const char *KeyTypeName(
+            rtc::KeyType key_type);
+
+        const size_t pool_size_;
+        mutex pool_mutex_;
+        std::condition_variable pool_cv_;
+        bool exit_flag_;
+        map<rtc::KeyType, deque<unique_ptr<rtc::SSLIdentity>>> ready_;
+        uint64_t hits_;
+        uint64_t misses_;
+        std::thread generator_;
+    };
+} // namespace tincan
+#endif // TINCAN_IDENTITY_POOL_H_
@@ -0,0 +1,279 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_LINK_RECORD_H_
+#define TINCAN_LINK_RECORD_H_
+#include "tincan_base.h"
+namespace tincan
+{
+    /* When a framed datapath feature is enabled for a vlink every DTLS
+    record starts with a one byte flags field, followed by the fields those
+    flags select, in the order they are declared here. The controller gives
+    both peers the same LinkOptions, only header compression is agreed on
+    the link itself with a kCapabilities exchange.
+    */
+    class LinkRecord
+    {
+    public:
+        // a 32-bit per-link sequence number follows the flags
+        static const uint8_t kSequenced = 0x01;
+        // the payload is several frames, each prefixed by a 16-bit length
+        static const uint8_t kBatch = 0x02;
+        // every frame starts with a FrameCodec encoding byte
+        static const uint8_t kEncoded = 0x04;
+        // the payload is a piece of a larger record and starts with a
+        // fragment header, the other flags describe the whole record
+        static const uint8_t kFragment = 0x08;
+        // the payload is a link control message instead of frames
+        static const uint8_t kControl = 0x10;
+        // the payload is an FEC header and a whole record, or a parity
+        // symbol of its group, never combined with other flags
+        static const uint8_t kFec = 0x20;
+
+        // link control message types
+        static const uint8_t kProbe = 1;
+        static const uint8_t kProbeAck = 2;
+        // congestion control, a ping is answered at once with a feedback
+        // message that echoes its id
+        static const uint8_t kPing = 3;
+        static const uint8_t kFeedback = 4;
+        // native datapath, the offer carries the port of the sender's
+        // native socket in its id and the probes are sent on that socket
+        static const uint8_t kNativeOffer = 5;
+        static const uint8_t kNativeProbe = 6;
+        static const uint8_t kNativeProbeAck = 7;
+        // the id holds the kCap bits of the sender, a size of 1 says it
+        // already has the receiver's and 0 asks for them
+        static const uint8_t kCapabilities = 8;
+        // header compression, the id holds the context and generation of a
+        // delta that could not be decoded, the sender repeats its definition
+        static const uint8_t kContextRequest = 9;
+        // native datapath, the id holds the port of the native socket the
+        // sender closed, the receiver stops sending to it
+        static const uint8_t kNativeWithdraw = 10;
+
+        // the sender decodes compressed headers
+        static const uint16_t kCapHeaderCompression = 0x0001;
+
+        static const size_t kMaxHeaderSz = 5;
+        static const size_t kLenSz = 2;
+        static const size_t kEncodingSz = 1;
+        static const size_t kFragmentHeaderSz = 4;
+        static const size_t kControlSz = 5;
+        static const size_t kFecHeaderSz = 4;
+        static const size_t kFeedbackSz = 8;
+
+        static size_t
+        HeaderSize(
+            uint8_t flags)
+        {
+            return (flags & kSequenced) ? 5 : 1;
+        }
+
+        static void
+        WriteLength(
+            char *buf,
+            size_t len)
+        {
+            buf[0] = static_cast<char>(len >> 8);
+            buf[1] = static_cast<char>(len);
+        }
+
+        static size_t
+        ReadLength(
+            const char *buf)
+        {
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
+            return (size_t(p[0]) << 8) | size_t(p[1]);
+        }
+
+        static size_t
+        WriteHeader(
+            char *buf,
+            uint8_t flags,
+            uint32_t seq)
+        {
+            size_t pos = 0;
+            buf[pos++] = static_cast<char>(flags);
+            if (flags & kSequenced)
+            {
+                buf[pos++] = static_cast<char>(seq >> 24);
+                buf[pos++] = static_cast<char>(seq >> 16);
+                buf[pos++] = static_cast<char>(seq >> 8);
+                buf[pos++] = static_cast<char>(seq);
+            }
+            return pos;
+        }
+
+        // [id:16][last:1 offset:15], offset is the position of the piece
+        // in the payload of the whole record
+        static void
+        WriteFragmentHeader(
+            char *buf,
+            uint16_t id,
+            size_t offset,
+            bool last)
+        {
+            const uint16_t pos = static_cast<uint16_t>(offset) | (last ? 0x8000 : 0);
+            buf[0] = static_cast<char>(id >> 8);
+            buf[1] = static_cast<char>(id);
+            buf[2] = static_cast<char>(pos >> 8);
+            buf[3] = static_cast<char>(pos);
+        }
+
+        static bool
+        ReadFragmentHeader(
+            const char *buf,
+            size_t len,
+            uint16_t &id,
+            size_t &offset,
+            bool &last)
+        {
+            if (len < kFragmentHeaderSz)
+                return false;
+            id = static_cast<uint16_t>(ReadLength(buf));
+            const size_t pos = ReadLength(buf + 2);
+            offset = pos & 0x7fff;
+            last = (pos & 0x8000) != 0;
+            return true;
+        }
+
+        // [type:8][id:16][size:16], size is the length of the whole probe
+        // record including its header and padding
+        static size_t
+        WriteControl(
+            char *buf,
+            uint8_t type,
+            uint16_t id,
+            size_t size)
+        {
+            buf[0] = static_cast<char>(type);
+            WriteLength(buf + 1, id);
+            WriteLength(buf + 3, size);
+            return kControlSz;
+        }
+
+        static bool
+        ReadControl(
+            const char *buf,
+            size_t len,
+            uint8_t &type,
+            uint16_t &id,
+            size_t &size)
+        {
+            if (len < kControlSz)
+                return false;
+            type = static_cast<uint8_t>(buf[0]);
+            id = static_cast<uint16_t>(ReadLength(buf + 1));
+            size = ReadLength(buf + 3);
+            return true;
+        }
+
+        // follows the control header of a kFeedback message,
+        // [rx_bytes:32][rx_time_us:32] as counted by the receiver
+        static size_t
+        WriteFeedback(
+            char *buf,
+            uint32_t rx_bytes,
+            uint32_t rx_time_us)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                buf[i] = static_cast<char>(rx_bytes >> (24 - 8 * i));
+                buf[4 + i] = static_cast<char>(rx_time_us >> (24 - 8 * i));
+            }
+            return kFeedbackSz;
+        }
+
+        static bool
+        ReadFeedback(
+            const char *buf,
+            size_t len,
+            uint32_t &rx_bytes,
+            uint32_t &rx_time_us)
+        {
+            if (len < kFeedbackSz)
+                return false;
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
+            rx_bytes = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+            rx_time_us = (uint32_t(p[4]) << 24) | (uint32_t(p[5]) << 16) | (uint32_t(p[6]) << 8) | p[7];
+            return true;
+        }
+
+        // [group:16][index:8][k:4 m:4], indexes from k on are parity
+        static void
+        WriteFecHeader(
+            char *buf,
+            uint16_t group,
+            uint8_t index,
+            uint8_t k,
+            uint8_t m)
+        {
+            WriteLength(buf, group);
+            buf[2] = static_cast<char>(index);
+            buf[3] = static_cast<char>((k << 4) | (m & 0x0f));
+        }
+
+        static bool
+        ReadFecHeader(
+            const char *buf,
+            size_t len,
+            uint16_t &group,
+            uint8_t &index,
+            uint8_t &k,
+            uint8_t &m)
+        {
+            if (len < kFecHeaderSz)
+                return false;
+            group = static_cast<uint16_t>(ReadLength(buf));
+            index = static_cast<uint8_t>(buf[2]);
+            k = static_cast<uint8_t>(buf[3]) >> 4;
+            m = static_cast<uint8_t>(buf[3]) & 0x0f;
+            return true;
+        }
+
+        // Returns the header length, or 0 if the record is truncated.
+        static size_t
+        ReadHeader(
+            const char *buf,
+            size_t len,
+            uint8_t &flags,
+            uint32_t &seq)
+        {
+            if (len < 1)
+                return 0;
+            size_t pos = 0;
+            flags = static_cast<uint8_t>(buf[pos++]);
+            if (flags & kSequenced)
+            {
+                if (len < pos + 4)
+                    return 0;
+                const uint8_t *p = reinterpret_cast<const uint8_t *>(buf + pos);
+                seq = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                      (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+                pos += 4;
+            }
+            return pos;
+        }
+    };
+} // namespace tincan
+#endif // TINCAN_LINK_RECORD_H_
@@ -0,0 +1,175 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "mss_clamper.h"
+#include "frame_parser.h"
+namespace tincan
+{
+    namespace
+    {
+        const uint8_t kTcpSyn = 0x02;
+        const uint8_t kOptEnd = 0;
+        const uint8_t kOptNop = 1;
+        const uint8_t kOptMss = 2;
+        const size_t kTcpBaseSz = 20;
+
+        uint16_t
+        Swap16(
+            uint16_t v)
+        {
+            return static_cast<uint16_t>((v << 8) | (v >> 8));
+        }
+    } // namespace
+
+    MssClamper::MssClamper(
+        size_t mtu) : mtu_(mtu),
+                      path_mtu_(0)
+    {
+    }
+
+    void
+    MssClamper::SetPathMtu(
+        size_t mtu)
+    {
+        path_mtu_.store(mtu, std::memory_order_relaxed);
+    }
+
+    size_t
+    MssClamper::SynOffset(
+        const uint8_t *p,
+        size_t len,
+        size_t &ip_hdr_len)
+    {
+        if (len < kEthernetHeaderSz)
+            return 0;
+        size_t pos = 12;
+        uint16_t ether_type = FrameInfo::Read16(p + pos);
+        pos += 2;
+        if (ether_type == FrameInfo::kEtherTypeVlan && len >= pos + 4)
+        {
+            ether_type = FrameInfo::Read16(p + pos + 2);
+            pos += 4;
+        }
+        if (ether_type == FrameInfo::kEtherTypeIPv4 && len >= pos + 20)
+        {
+            ip_hdr_len = (p[pos] & 0x0f) * 4;
+            if (p[pos + 9] != FrameInfo::kProtoTcp || ip_hdr_len < 20 ||
+                (FrameInfo::Read16(p + pos + 6) & 0x1fff) != 0)
+                return 0;
+        }
+        else if (ether_type == FrameInfo::kEtherTypeIPv6 && len >= pos + 40)
+        {
+            // extension headers are not walked
+            ip_hdr_len = 40;
+            if (p[pos + 6] != FrameInfo::kProtoTcp)
+                return 0;
+        }
+        else
+        {
+            return 0;
+        }
+        pos += ip_hdr_len;
+        if (len < pos + kTcpBaseSz || !(p[pos + 13] & kTcpSyn))
+            return 0;
+        return pos;
+    }
+
+    bool
+    MssClamper::IsSyn(
+        const char *frame,
+        size_t len)
+    {
+        size_t ip_hdr_len = 0;
+        return SynOffset(reinterpret_cast<const uint8_t *>(frame), len, ip_hdr_len) != 0;
+    }
+
+    bool
+    MssClamper::Clamp(
+        char *frame,
+        size_t len,
+        Direction dir)
+    {
+        uint8_t *p = reinterpret_cast<uint8_t *>(frame);
+        size_t ip_hdr_len = 0;
+        const size_t tcp = SynOffset(p, len, ip_hdr_len);
+        if (tcp == 0)
+            return false;
+        Counters &counters = counters_[dir];
+        counters.syns.fetch_add(1, std::memory_order_relaxed);
+        size_t mtu = mtu_;
+        const size_t path_mtu = path_mtu_.load(std::memory_order_relaxed);
+        if (path_mtu > 0)
+            mtu = std::min(mtu, path_mtu);
+        if (mtu <= ip_hdr_len + kTcpBaseSz)
+            return false;
+        const uint16_t limit = static_cast<uint16_t>(std::min<size_t>(mtu - ip_hdr_len - kTcpBaseSz, 0xffff));
+        const size_t end = tcp + (p[tcp + 12] >> 4) * 4;
+        if (end < tcp + kTcpBaseSz || end > len)
+            return false;
+        size_t pos = tcp + kTcpBaseSz;
+        while (pos < end && p[pos] != kOptEnd)
+        {
+            if (p[pos] == kOptNop)
+            {
+                ++pos;
+                continue;
+            }
+            if (pos + 1 >= end || p[pos + 1] < 2 || pos + p[pos + 1] > end)
+                return false;
+            if (p[pos] == kOptMss && p[pos + 1] == 4)
+            {
+                const uint16_t mss = FrameInfo::Read16(p + pos + 2);
+                if (mss <= limit)
+                    return false;
+                // a field at an odd offset straddles two checksum words,
+                // its contribution to the sum is byte swapped
+                const bool odd = (pos + 2 - tcp) & 1;
+                uint16_t csum = FrameInfo::Read16(p + tcp + 16);
+                csum = odd ? FrameInfo::UpdateChecksum(csum, Swap16(mss), Swap16(limit))
+                           : FrameInfo::UpdateChecksum(csum, mss, limit);
+                p[pos + 2] = static_cast<uint8_t>(limit >> 8);
+                p[pos + 3] = static_cast<uint8_t>(limit);
+                p[tcp + 16] = static_cast<uint8_t>(csum >> 8);
+                p[tcp + 17] = static_cast<uint8_t>(csum);
+                counters.clamped.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            pos += p[pos + 1];
+        }
+        return false;
+    }
+
+    void
+    MssClamper::QueryInfo(
+        Json::Value &info)
+    {
+        info["Mtu"] = (Json::UInt64)mtu_;
+        info["PathMtu"] = (Json::UInt64)path_mtu_.load(std::memory_order_relaxed);
+        const char *names[] = {"Egress", "Ingress"};
+        for (size_t i = 0; i < counters_.size(); ++i)
+        {
+            Json::Value &dir_info = info[names[i]];
+            dir_info["Syns"] = (Json::UInt64)counters_[i].syns.load(std::memory_order_relaxed);
+            dir_info["Clamped"] = (Json::UInt64)counters_[i].clamped.load(std::memory_order_relaxed);
+        }
+    }
+} // namespace tincan
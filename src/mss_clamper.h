@@ -0,0 +1,87 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_MSS_CLAMPER_H_
+#define TINCAN_MSS_CLAMPER_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* Lowers the MSS option of TCP SYN and SYN-ACK segments crossing the
+    tunnel, so neither end sends segments larger than the tunnel carries
+    without fragmenting. The TCP checksum is patched incrementally
+    (RFC 1624). Frames that are not an IPv4/IPv6 TCP SYN are left alone
+    after a look at their headers. Used from the TAP and network threads.
+    */
+    class MssClamper
+    {
+    public:
+        enum Direction
+        {
+            // TAP to vlink
+            kEgress,
+            // vlink to TAP
+            kIngress,
+        };
+
+        explicit MssClamper(
+            size_t mtu);
+        MssClamper(const MssClamper &) = delete;
+        MssClamper &operator=(const MssClamper &) = delete;
+
+        // The largest IP packet the current vlink path carries in one
+        // record, 0 if unknown. The clamp uses the lower of it and the MTU.
+        void SetPathMtu(
+            size_t mtu);
+
+        static bool IsSyn(
+            const char *frame,
+            size_t len);
+
+        // Returns true if the MSS option of the frame was lowered.
+        bool Clamp(
+            char *frame,
+            size_t len,
+            Direction dir);
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        struct Counters
+        {
+            std::atomic<uint64_t> syns{0};
+            std::atomic<uint64_t> clamped{0};
+        };
+
+        // Returns the offset of the TCP header of a SYN, or 0.
+        static size_t SynOffset(
+            const uint8_t *p,
+            size_t len,
+            size_t &ip_hdr_len);
+
+        const size_t mtu_;
+        std::atomic<size_t> path_mtu_;
+        array<Counters, 2> counters_;
+    };
+} // namespace tincan
+#endif // TINCAN_MSS_CLAMPER_H_
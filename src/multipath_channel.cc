@@ -0,0 +1,225 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "multipath_channel.h"
+#include <errno.h>
+#include "p2p/base/default_ice_transport_factory.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+namespace tincan
+{
+    MultipathTransportChannel::MultipathTransportChannel(
+        const string &transport_name,
+        int component,
+        cricket::PortAllocator *allocator,
+        webrtc::AsyncResolverFactory *async_resolver_factory,
+        webrtc::RtcEventLog *event_log) : P2PTransportChannel(transport_name,
+                                                              component,
+                                                              allocator,
+                                                              async_resolver_factory,
+                                                              event_log),
+                                          last_refresh_ms_(0),
+                                          path_error_(0),
+                                          path_events_(this)
+    {
+    }
+
+    int
+    MultipathTransportChannel::SendPacket(
+        const char *data,
+        size_t len,
+        const rtc::PacketOptions &options,
+        int flags)
+    {
+        cricket::Connection *conn = nullptr;
+        if (flags == 0 && selected_connection())
+            conn = NextPath();
+        int sent;
+        path_error_ = 0;
+        if (conn)
+        {
+            sent = conn->Send(data, len, options);
+            if (sent <= 0)
+            {
+                path_error_ = conn->GetError();
+                // told to the channel once this path can send again
+                PathFor(conn).blocked = path_error_ == EWOULDBLOCK;
+            }
+        }
+        else
+        {
+            // fewer than two usable paths, let ICE send on the selected one
+            sent = P2PTransportChannel::SendPacket(data, len, options, flags);
+            conn = const_cast<cricket::Connection *>(selected_connection());
+        }
+        if (sent > 0 && conn)
+        {
+            Path &path = PathFor(conn);
+            path.tx_bytes += sent;
+            path.tx_packets++;
+        }
+        return sent;
+    }
+
+    int
+    MultipathTransportChannel::GetError()
+    {
+        return path_error_ != 0 ? path_error_ : P2PTransportChannel::GetError();
+    }
+
+    MultipathTransportChannel::Path &
+    MultipathTransportChannel::PathFor(
+        cricket::Connection *conn)
+    {
+        auto itr = paths_.find(conn);
+        if (itr != paths_.end())
+            return itr->second;
+        conn->SignalDestroyed.connect(&path_events_, &PathEvents::OnDestroyed);
+        conn->SignalReadyToSend.connect(&path_events_, &PathEvents::OnReadyToSend);
+        return paths_[conn];
+    }
+
+    void
+    MultipathTransportChannel::OnPathDestroyed(
+        cricket::Connection *conn)
+    {
+        auto itr = paths_.find(conn);
+        if (itr == paths_.end())
+            return;
+        const bool blocked = itr->second.blocked;
+        paths_.erase(itr);
+        // the sender may be waiting on this path, it picks another one now
+        if (blocked)
+            SignalReadyToSend(this);
+    }
+
+    void
+    MultipathTransportChannel::OnPathReadyToSend(
+        cricket::Connection *conn)
+    {
+        auto itr = paths_.find(conn);
+        if (itr == paths_.end() || !itr->second.blocked)
+            return;
+        itr->second.blocked = false;
+        // ICE raises it for the selected pair itself
+        if (conn != selected_connection())
+            SignalReadyToSend(this);
+    }
+
+    cricket::Connection *
+    MultipathTransportChannel::NextPath()
+    {
+        const int64_t now_ms = rtc::TimeMillis();
+        if (now_ms - last_refresh_ms_ >= kWeightRefreshInterval)
+            RefreshWeights(now_ms);
+        cricket::Connection *best = nullptr;
+        Path *best_path = nullptr;
+        int total = 0;
+        size_t usable = 0;
+        for (cricket::Connection *conn : connections())
+        {
+            if (conn->weak() || !conn->writable())
+                continue;
+            Path &path = PathFor(conn);
+            path.current += path.weight;
+            total += path.weight;
+            ++usable;
+            if (!best_path || path.current > best_path->current)
+            {
+                best = conn;
+                best_path = &path;
+            }
+        }
+        if (usable < 2)
+            return nullptr;
+        best_path->current -= total;
+        return best;
+    }
+
+    void
+    MultipathTransportChannel::RefreshWeights(
+        int64_t now_ms)
+    {
+        last_refresh_ms_ = now_ms;
+        for (cricket::Connection *conn : connections())
+        {
+            Path &path = PathFor(conn);
+            const cricket::ConnectionInfo &info = conn->stats();
+            const uint64_t sent = info.sent_ping_requests_total - path.pings_sent;
+            const uint64_t answered = info.recv_ping_responses - path.pings_answered;
+            if (sent > 0)
+                path.loss = 1.0 - std::min(1.0, double(answered) / double(sent));
+            path.pings_sent = info.sent_ping_requests_total;
+            path.pings_answered = info.recv_ping_responses;
+            const int rtt = std::max(conn->rtt(), 1);
+            // a lossy path is penalised twice, once for the retransmissions
+            // and once for the TCP back-off it causes
+            const double delivery = (1.0 - path.loss) * (1.0 - path.loss);
+            path.weight = std::max(1, int(kDefaultWeight * 100 * delivery / rtt));
+        }
+    }
+
+    void
+    MultipathTransportChannel::QueryInfo(
+        Json::Value &mp_info)
+    {
+        Json::Value paths(Json::arrayValue);
+        uint64_t tx_bps = 0, rx_bps = 0;
+        for (cricket::Connection *conn : connections())
+        {
+            auto itr = paths_.find(conn);
+            if (itr == paths_.end())
+                continue;
+            const Path &path = itr->second;
+            const cricket::ConnectionInfo &info = conn->stats();
+            Json::Value pinfo(Json::objectValue);
+            pinfo["LocalCandidate"] = conn->local_candidate().address().ToString();
+            pinfo["RemoteCandidate"] = conn->remote_candidate().address().ToString();
+            pinfo["Selected"] = conn == selected_connection();
+            pinfo["Weight"] = path.weight;
+            pinfo["RttMs"] = conn->rtt();
+            pinfo["Loss"] = path.loss;
+            pinfo["TxBytes"] = (Json::UInt64)path.tx_bytes;
+            pinfo["TxPackets"] = (Json::UInt64)path.tx_packets;
+            pinfo["SendBytesSecond"] = (Json::UInt64)info.sent_bytes_second;
+            pinfo["RecvBytesSecond"] = (Json::UInt64)info.recv_bytes_second;
+            tx_bps += info.sent_bytes_second;
+            rx_bps += info.recv_bytes_second;
+            paths.append(pinfo);
+        }
+        mp_info["Paths"] = paths;
+        mp_info["SendBytesSecond"] = (Json::UInt64)tx_bps;
+        mp_info["RecvBytesSecond"] = (Json::UInt64)rx_bps;
+    }
+
+    rtc::scoped_refptr<webrtc::IceTransportInterface>
+    MultipathIceTransportFactory::CreateIceTransport(
+        const std::string &transport_name,
+        int component,
+        webrtc::IceTransportInit init)
+    {
+        return new rtc::RefCountedObject<webrtc::DefaultIceTransport>(
+            std::make_unique<MultipathTransportChannel>(
+                transport_name, component, init.port_allocator(),
+                init.async_resolver_factory(), init.event_log()));
+    }
+} // namespace tincan
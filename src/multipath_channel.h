@@ -0,0 +1,121 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_MULTIPATH_CHANNEL_H_
+#define TINCAN_MULTIPATH_CHANNEL_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "api/ice_transport_factory.h"
+#include "p2p/base/connection.h"
+#include "p2p/base/p2p_transport_channel.h"
+namespace tincan
+{
+    /* An ICE channel that spreads outgoing records over every usable
+    candidate pair instead of only the selected one. Paths are picked by
+    smooth weighted round robin, each weighted by its delivery ratio over its
+    RTT, both refreshed from the connection ping statistics. ICE still owns
+    pair selection, pruning keeps at most one pair per local network. A path
+    that refused a send raises SignalReadyToSend for the channel once it
+    can send again, ICE only does so for the selected pair.
+    */
+    class MultipathTransportChannel : public cricket::P2PTransportChannel
+    {
+    public:
+        MultipathTransportChannel(
+            const string &transport_name,
+            int component,
+            cricket::PortAllocator *allocator,
+            webrtc::AsyncResolverFactory *async_resolver_factory,
+            webrtc::RtcEventLog *event_log);
+        ~MultipathTransportChannel() override = default;
+
+        int SendPacket(
+            const char *data,
+            size_t len,
+            const rtc::PacketOptions &options,
+            int flags) override;
+
+        // the error of the last send, on whichever path it went
+        int GetError() override;
+
+        void QueryInfo(
+            Json::Value &mp_info);
+
+    private:
+        struct Path
+        {
+            int weight = kDefaultWeight;
+            int current = 0;
+            uint64_t tx_bytes = 0;
+            uint64_t tx_packets = 0;
+            uint64_t pings_sent = 0;
+            uint64_t pings_answered = 0;
+            double loss = 0.0;
+            bool blocked = false;
+        };
+
+        // connection signals are taken on a member, so they are disconnected
+        // before the base channel destroys its connections
+        struct PathEvents : public sigslot::has_slots<>
+        {
+            explicit PathEvents(MultipathTransportChannel *channel) : channel(channel) {}
+            void OnDestroyed(cricket::Connection *conn) { channel->OnPathDestroyed(conn); }
+            void OnReadyToSend(cricket::Connection *conn) { channel->OnPathReadyToSend(conn); }
+            MultipathTransportChannel *channel;
+        };
+
+        Path &PathFor(
+            cricket::Connection *conn);
+
+        void OnPathDestroyed(
+            cricket::Connection *conn);
+
+        void OnPathReadyToSend(
+            cricket::Connection *conn);
+
+        cricket::Connection *NextPath();
+
+        void RefreshWeights(
+            int64_t now_ms);
+
+        static const int kDefaultWeight = 100;
+        static const int64_t kWeightRefreshInterval = 500;
+
+        // an entry lives as long as its connection
+        unordered_map<cricket::Connection *, Path> paths_;
+        int64_t last_refresh_ms_;
+        // set when a send on a path other than the selected one failed
+        int path_error_;
+        PathEvents path_events_;
+    };
+
+    class MultipathIceTransportFactory : public webrtc::IceTransportFactory
+    {
+    public:
+        ~MultipathIceTransportFactory() override = default;
+        rtc::scoped_refptr<webrtc::IceTransportInterface> CreateIceTransport(
+            const std::string &transport_name,
+            int component,
+            webrtc::IceTransportInit init) override;
+    };
+} // namespace tincan
+#endif // TINCAN_MULTIPATH_CHANNEL_H_
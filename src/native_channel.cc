@@ -0,0 +1,346 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "native_channel.h"
+#include "rtc_base/logging.h"
+#include <errno.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+namespace tincan
+{
+    namespace
+    {
+        const size_t kTxCtrlSz = CMSG_SPACE(sizeof(uint16_t));
+        const size_t kRxCtrlSz = CMSG_SPACE(sizeof(int));
+    } // namespace
+
+    NativeChannel::NativeChannel(
+        rtc::PhysicalSocketServer *socket_server,
+        NativeCrypto &crypto) : socket_server_(socket_server),
+                                crypto_(crypto),
+                                fd_(-1),
+                                gso_(false),
+                                gro_(false),
+                                write_blocked_(false),
+                                tx_buf_(kTxBufSz),
+                                tx_used_(0),
+                                tx_ctrl_(kSendBatch * kTxCtrlSz),
+                                rx_slot_sz_(kSlotSz),
+                                rx_ctrl_(kRecvSlots * kRxCtrlSz),
+                                tx_records_(0),
+                                tx_syscalls_(0),
+                                tx_gso_sends_(0),
+                                tx_dropped_(0),
+                                tx_blocked_(0),
+                                rx_records_(0),
+                                rx_syscalls_(0),
+                                rx_gro_reads_(0)
+    {
+        tx_lens_.reserve(kSendBatch);
+    }
+
+    NativeChannel::~NativeChannel()
+    {
+        Close();
+    }
+
+    bool
+    NativeChannel::Open(
+        const rtc::IPAddress &local_ip)
+    {
+        fd_ = socket(local_ip.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+        {
+            RTC_LOG(LS_WARNING) << "Failed to create the native socket. ERRNO: " << errno;
+            return false;
+        }
+        sockaddr_storage addr{};
+        socklen_t addr_len = rtc::SocketAddress(local_ip, 0).ToSockAddrStorage(&addr);
+        if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), addr_len) != 0 ||
+            getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &addr_len) != 0)
+        {
+            RTC_LOG(LS_WARNING) << "Failed to bind the native socket to " << local_ip.ToString()
+                                << ". ERRNO: " << errno;
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        rtc::SocketAddressFromSockAddrStorage(addr, &local_addr_);
+        const int on = 1;
+        gro_ = setsockopt(fd_, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+        // assumed until a send is refused
+        gso_ = true;
+        rx_slot_sz_ = gro_ ? kGroSlotSz : kSlotSz;
+        rx_buf_.resize(kRecvSlots * rx_slot_sz_);
+        socket_server_->Add(this);
+        return true;
+    }
+
+    void NativeChannel::Close()
+    {
+        if (fd_ < 0)
+            return;
+        socket_server_->Remove(this);
+        close(fd_);
+        fd_ = -1;
+    }
+
+    bool
+    NativeChannel::Connect(
+        const rtc::SocketAddress &peer)
+    {
+        sockaddr_storage addr{};
+        const socklen_t addr_len = peer.ToSockAddrStorage(&addr);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr *>(&addr), addr_len) != 0)
+        {
+            RTC_LOG(LS_WARNING) << "Failed to connect the native socket to " << peer.ToString()
+                                << ". ERRNO: " << errno;
+            return false;
+        }
+        peer_ = peer;
+        return true;
+    }
+
+    void
+    NativeChannel::Send(
+        const char *data,
+        size_t len)
+    {
+        if (!Connected())
+            return;
+        if (tx_lens_.size() == kSendBatch || tx_used_ + len + NativeCrypto::kOverhead > tx_buf_.size())
+            Flush();
+        // still full when the socket is blocked
+        const size_t sealed_len = tx_lens_.size() == kSendBatch
+                                      ? 0
+                                      : crypto_.Seal(data, len, tx_buf_.data() + tx_used_, tx_buf_.size() - tx_used_);
+        if (sealed_len == 0)
+        {
+            ++tx_dropped_;
+            return;
+        }
+        tx_used_ += sealed_len;
+        tx_lens_.push_back(sealed_len);
+    }
+
+    /* Every record of a GSO send but the last must be the segment size, so
+    runs of full sized records, as a bulk transfer makes them, go as one.
+    */
+    void NativeChannel::Flush()
+    {
+        if (tx_lens_.empty())
+            return;
+        size_t msgs = 0;
+        size_t offset = 0;
+        for (size_t i = 0; i < tx_lens_.size();)
+        {
+            const size_t segment = tx_lens_[i];
+            size_t run_len = segment;
+            size_t j = i + 1;
+            while (gso_ && j < tx_lens_.size() && j - i < kMaxGsoSegments && tx_lens_[j - 1] == segment &&
+                   tx_lens_[j] <= segment && run_len + tx_lens_[j] <= kMaxGsoBytes)
+                run_len += tx_lens_[j++];
+            mmsghdr &msg = tx_msgs_[msgs];
+            memset(&msg, 0, sizeof(msg));
+            tx_iovs_[msgs].iov_base = tx_buf_.data() + offset;
+            tx_iovs_[msgs].iov_len = run_len;
+            msg.msg_hdr.msg_iov = &tx_iovs_[msgs];
+            msg.msg_hdr.msg_iovlen = 1;
+            if (j - i > 1)
+            {
+                msg.msg_hdr.msg_control = tx_ctrl_.data() + msgs * kTxCtrlSz;
+                msg.msg_hdr.msg_controllen = kTxCtrlSz;
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                const uint16_t gso_size = static_cast<uint16_t>(segment);
+                memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            }
+            tx_msg_records_[msgs++] = j - i;
+            offset += run_len;
+            i = j;
+        }
+        size_t done = 0;
+        while (done < msgs)
+        {
+            const int sent = sendmmsg(fd_, tx_msgs_.data() + done, static_cast<unsigned int>(msgs - done), 0);
+            ++tx_syscalls_;
+            if (sent > 0)
+            {
+                for (size_t k = done; k < done + sent; ++k)
+                {
+                    tx_records_ += tx_msg_records_[k];
+                    if (tx_msgs_[k].msg_hdr.msg_controllen > 0)
+                        ++tx_gso_sends_;
+                }
+                done += sent;
+                continue;
+            }
+            const int error = errno;
+            if (error == EINTR)
+                continue;
+            if (error == EAGAIN || error == EWOULDBLOCK)
+                break;
+            if (gso_ && tx_msgs_[done].msg_hdr.msg_controllen > 0 && (error == EIO || error == EINVAL))
+            {
+                gso_ = false;
+                RTC_LOG(LS_INFO) << "UDP GSO is not available to the native socket. ERRNO: " << error;
+            }
+            tx_dropped_ += tx_msg_records_[done++];
+        }
+        if (done == msgs)
+        {
+            tx_lens_.clear();
+            tx_used_ = 0;
+            return;
+        }
+        // the socket buffer is full, the unsent records move to the front
+        // and go out on the write event
+        size_t records = 0;
+        for (size_t k = 0; k < done; ++k)
+            records += tx_msg_records_[k];
+        const size_t sent_bytes = static_cast<char *>(tx_iovs_[done].iov_base) - tx_buf_.data();
+        memmove(tx_buf_.data(), tx_buf_.data() + sent_bytes, tx_used_ - sent_bytes);
+        tx_used_ -= sent_bytes;
+        tx_lens_.erase(tx_lens_.begin(), tx_lens_.begin() + records);
+        ++tx_blocked_;
+        if (!write_blocked_)
+        {
+            write_blocked_ = true;
+            socket_server_->Update(this);
+        }
+    }
+
+    void
+    NativeChannel::OnEvent(
+        uint32_t ff,
+        int)
+    {
+        if (ff & rtc::DE_READ)
+            ReadNext();
+        if (!(ff & rtc::DE_WRITE) || !write_blocked_)
+            return;
+        write_blocked_ = false;
+        socket_server_->Update(this);
+        Flush();
+        if (!write_blocked_)
+            SignalReadyToSend();
+    }
+
+    void NativeChannel::ReadNext()
+    {
+        for (int round = 0; round < kReadBudget; ++round)
+        {
+            for (size_t i = 0; i < kRecvSlots; ++i)
+            {
+                mmsghdr &msg = rx_msgs_[i];
+                memset(&msg, 0, sizeof(msg));
+                rx_iovs_[i].iov_base = rx_buf_.data() + i * rx_slot_sz_;
+                rx_iovs_[i].iov_len = rx_slot_sz_;
+                msg.msg_hdr.msg_iov = &rx_iovs_[i];
+                msg.msg_hdr.msg_iovlen = 1;
+                msg.msg_hdr.msg_control = rx_ctrl_.data() + i * kRxCtrlSz;
+                msg.msg_hdr.msg_controllen = kRxCtrlSz;
+            }
+            const int received = recvmmsg(fd_, rx_msgs_.data(), kRecvSlots, MSG_DONTWAIT, nullptr);
+            ++rx_syscalls_;
+            if (received <= 0)
+                return;
+            for (int i = 0; i < received; ++i)
+            {
+                mmsghdr &msg = rx_msgs_[i];
+                if (msg.msg_hdr.msg_flags & MSG_TRUNC)
+                    continue;
+                char *data = static_cast<char *>(rx_iovs_[i].iov_base);
+                const size_t len = msg.msg_len;
+                size_t segment = len;
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg.msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msg.msg_hdr, cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        int gro_size = 0;
+                        memcpy(&gro_size, CMSG_DATA(cmsg), sizeof(gro_size));
+                        if (gro_size > 0)
+                            segment = static_cast<size_t>(gro_size);
+                        ++rx_gro_reads_;
+                    }
+                }
+                for (size_t offset = 0; offset < len; offset += segment)
+                    Deliver(data + offset, std::min(segment, len - offset));
+            }
+            if (received < static_cast<int>(kRecvSlots))
+                return;
+        }
+    }
+
+    void
+    NativeChannel::Deliver(
+        char *data,
+        size_t len)
+    {
+        const char *record = nullptr;
+        size_t record_len = 0;
+        if (!crypto_.Open(data, len, record, record_len))
+            return;
+        ++rx_records_;
+        SignalRecordReceived(record, record_len);
+    }
+
+    void
+    NativeChannel::SetDscp(
+        uint8_t dscp)
+    {
+        if (fd_ < 0)
+            return;
+        const int tos = dscp << 2;
+        if (local_addr_.family() == AF_INET6)
+            setsockopt(fd_, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+        else
+            setsockopt(fd_, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    }
+
+    void
+    NativeChannel::QueryInfo(
+        Json::Value &info)
+    {
+        info["Local"] = local_addr_.ToString();
+        info["Peer"] = peer_.ToString();
+        info["Gso"] = gso_;
+        info["Gro"] = gro_;
+        info["TxRecords"] = (Json::UInt64)tx_records_;
+        info["TxSyscalls"] = (Json::UInt64)tx_syscalls_;
+        info["TxGsoSends"] = (Json::UInt64)tx_gso_sends_;
+        info["TxDropped"] = (Json::UInt64)tx_dropped_;
+        info["TxBlocked"] = (Json::UInt64)tx_blocked_;
+        info["RxRecords"] = (Json::UInt64)rx_records_;
+        info["RxSyscalls"] = (Json::UInt64)rx_syscalls_;
+        info["RxGroReads"] = (Json::UInt64)rx_gro_reads_;
+        crypto_.QueryInfo(info);
+    }
+} // namespace tincan
@@ -0,0 +1,176 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_NATIVE_CHANNEL_H_
+#define TINCAN_NATIVE_CHANNEL_H_
+#include "tincan_base.h"
+#include "native_crypto.h"
+#include "rtc_base/physical_socket_server.h"
+#include "rtc_base/socket_address.h"
+#include "rtc_base/strings/json.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+#include <netinet/in.h>
+#include <sys/socket.h>
+namespace tincan
+{
+    /* A UDP socket of the vlink's own that carries sealed link records
+    once the DTLS association is up, outside of the WebRTC transport
+    stack. It is served by the network thread's socket server like any
+    WebRTC socket, so received records stay on the thread that owns the
+    vlink. Sends are gathered and leave in one sendmmsg per burst, runs of
+    same sized records as single UDP GSO sends, and reads take up to
+    kRecvSlots datagrams per recvmmsg, with GRO coalesced ones split by
+    their segment size. Only used on the network thread.
+    */
+    class NativeChannel : public rtc::Dispatcher
+    {
+    public:
+        NativeChannel(
+            rtc::PhysicalSocketServer *socket_server,
+            NativeCrypto &crypto);
+        ~NativeChannel() override;
+        NativeChannel(const NativeChannel &) = delete;
+        NativeChannel &operator=(const NativeChannel &) = delete;
+
+        // Binds to an ephemeral port on local_ip.
+        bool Open(
+            const rtc::IPAddress &local_ip);
+
+        uint16_t Port() const
+        {
+            return local_addr_.port();
+        }
+
+        bool Connect(
+            const rtc::SocketAddress &peer);
+
+        bool Connected() const
+        {
+            return !peer_.IsNil();
+        }
+
+        const rtc::SocketAddress &Peer() const
+        {
+            return peer_;
+        }
+
+        // Seals a record into the pending burst.
+        void Send(
+            const char *data,
+            size_t len);
+
+        size_t Pending() const
+        {
+            return tx_lens_.size();
+        }
+
+        // Records the socket buffer has no room for stay pending until
+        // SignalReadyToSend.
+        void Flush();
+
+        bool Blocked() const
+        {
+            return write_blocked_;
+        }
+
+        void SetDscp(
+            uint8_t dscp);
+
+        void QueryInfo(
+            Json::Value &info);
+
+        // an authenticated record from the peer
+        sigslot::signal2<const char *, size_t> SignalRecordReceived;
+        // the pending records left after a blocked flush
+        sigslot::signal0<> SignalReadyToSend;
+
+        // rtc::Dispatcher
+        uint32_t GetRequestedEvents() override
+        {
+            return rtc::DE_READ | (write_blocked_ ? rtc::DE_WRITE : 0);
+        }
+        void OnPreEvent(uint32_t) override {}
+        void OnEvent(
+            uint32_t ff,
+            int err) override;
+        int GetDescriptor() override
+        {
+            return fd_;
+        }
+        bool IsDescriptorClosed() override
+        {
+            return false;
+        }
+
+    private:
+        static const size_t kSendBatch = 64;
+        static const size_t kTxBufSz = 128 * 1024;
+        // the kernel limits on a GSO send
+        static const size_t kMaxGsoSegments = 64;
+        static const size_t kMaxGsoBytes = 60000;
+        static const size_t kRecvSlots = 8;
+        // a GRO coalesced read is at most this large, without GRO a slot
+        // holds the largest record
+        static const size_t kGroSlotSz = 65536;
+        static const size_t kSlotSz = 16384;
+        // recvmmsg calls per read event, the socket stays readable after
+        static const int kReadBudget = 4;
+
+        void Close();
+
+        void ReadNext();
+
+        void Deliver(
+            char *data,
+            size_t len);
+
+        rtc::PhysicalSocketServer *socket_server_;
+        NativeCrypto &crypto_;
+        int fd_;
+        rtc::SocketAddress local_addr_;
+        rtc::SocketAddress peer_;
+        bool gso_;
+        bool gro_;
+        bool write_blocked_;
+        vector<char> tx_buf_;
+        size_t tx_used_;
+        vector<size_t> tx_lens_;
+        array<mmsghdr, kSendBatch> tx_msgs_;
+        array<iovec, kSendBatch> tx_iovs_;
+        array<size_t, kSendBatch> tx_msg_records_;
+        vector<char> tx_ctrl_;
+        size_t rx_slot_sz_;
+        vector<char> rx_buf_;
+        array<mmsghdr, kRecvSlots> rx_msgs_;
+        array<iovec, kRecvSlots> rx_iovs_;
+        vector<char> rx_ctrl_;
+        uint64_t tx_records_;
+        uint64_t tx_syscalls_;
+        uint64_t tx_gso_sends_;
+        uint64_t tx_dropped_;
+        uint64_t tx_blocked_;
+        uint64_t rx_records_;
+        uint64_t rx_syscalls_;
+        uint64_t rx_gro_reads_;
+    };
+} // namespace tincan
+#endif // TINCAN_NATIVE_CHANNEL_H_
@@ -0,0 +1,181 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "native_crypto.h"
+namespace tincan
+{
+    NativeCrypto::NativeCrypto() : initialized_(false),
+                                   tx_salt_{},
+                                   rx_salt_{},
+                                   tx_seq_(0),
+                                   rx_top_(0),
+                                   rx_window_{},
+                                   sealed_(0),
+                                   opened_(0),
+                                   auth_failures_(0),
+                                   replays_(0)
+    {
+    }
+
+    NativeCrypto::~NativeCrypto()
+    {
+        if (!initialized_)
+            return;
+        EVP_AEAD_CTX_cleanup(&tx_ctx_);
+        EVP_AEAD_CTX_cleanup(&rx_ctx_);
+    }
+
+    bool
+    NativeCrypto::Initialize(
+        const uint8_t *material,
+        bool client)
+    {
+        const uint8_t *client_key = material;
+        const uint8_t *server_key = material + kKeySz;
+        const uint8_t *client_salt = material + 2 * kKeySz;
+        const uint8_t *server_salt = client_salt + kSaltSz;
+        const EVP_AEAD *aead = EVP_aead_aes_128_gcm();
+        if (!EVP_AEAD_CTX_init(&tx_ctx_, aead, client ? client_key : server_key, kKeySz, kTagSz, nullptr))
+            return false;
+        if (!EVP_AEAD_CTX_init(&rx_ctx_, aead, client ? server_key : client_key, kKeySz, kTagSz, nullptr))
+        {
+            EVP_AEAD_CTX_cleanup(&tx_ctx_);
+            return false;
+        }
+        memcpy(tx_salt_.data(), client ? client_salt : server_salt, kSaltSz);
+        memcpy(rx_salt_.data(), client ? server_salt : client_salt, kSaltSz);
+        initialized_ = true;
+        return true;
+    }
+
+    void
+    NativeCrypto::MakeNonce(
+        const array<uint8_t, kSaltSz> &salt,
+        uint64_t seq,
+        uint8_t *nonce) const
+    {
+        memcpy(nonce, salt.data(), kSaltSz);
+        for (size_t i = 0; i < kSeqSz; ++i)
+            nonce[kSaltSz + i] = static_cast<uint8_t>(seq >> (56 - 8 * i));
+    }
+
+    size_t
+    NativeCrypto::Seal(
+        const char *data,
+        size_t len,
+        char *out,
+        size_t out_cap)
+    {
+        if (out_cap < len + kOverhead)
+            return 0;
+        // numbering starts at 1, 0 is never valid
+        const uint64_t seq = ++tx_seq_;
+        uint8_t *hdr = reinterpret_cast<uint8_t *>(out);
+        for (size_t i = 0; i < kSeqSz; ++i)
+            hdr[i] = static_cast<uint8_t>(seq >> (56 - 8 * i));
+        uint8_t nonce[kSaltSz + kSeqSz];
+        MakeNonce(tx_salt_, seq, nonce);
+        size_t sealed_len = 0;
+        if (!EVP_AEAD_CTX_seal(&tx_ctx_, hdr + kSeqSz, &sealed_len, out_cap - kSeqSz, nonce, sizeof(nonce),
+                               reinterpret_cast<const uint8_t *>(data), len, hdr, kSeqSz))
+            return 0;
+        ++sealed_;
+        return kSeqSz + sealed_len;
+    }
+
+    bool
+    NativeCrypto::Open(
+        char *record,
+        size_t len,
+        const char *&data,
+        size_t &data_len)
+    {
+        if (len < kOverhead)
+        {
+            ++auth_failures_;
+            return false;
+        }
+        uint8_t *hdr = reinterpret_cast<uint8_t *>(record);
+        uint64_t seq = 0;
+        for (size_t i = 0; i < kSeqSz; ++i)
+            seq = (seq << 8) | hdr[i];
+        // cheap check first, the window only moves once it authenticates
+        if (!Fresh(seq))
+        {
+            ++replays_;
+            return false;
+        }
+        uint8_t nonce[kSaltSz + kSeqSz];
+        MakeNonce(rx_salt_, seq, nonce);
+        size_t opened_len = 0;
+        if (!EVP_AEAD_CTX_open(&rx_ctx_, hdr + kSeqSz, &opened_len, len - kSeqSz, nonce, sizeof(nonce),
+                               hdr + kSeqSz, len - kSeqSz, hdr, kSeqSz))
+        {
+            ++auth_failures_;
+            return false;
+        }
+        Accept(seq);
+        ++opened_;
+        data = record + kSeqSz;
+        data_len = opened_len;
+        return true;
+    }
+
+    bool NativeCrypto::Fresh(
+        uint64_t seq) const
+    {
+        if (seq == 0)
+            return false;
+        if (seq > rx_top_)
+            return true;
+        // a word of the window is reused once it falls behind
+        if (rx_top_ / 64 - seq / 64 >= kReplayWords)
+            return false;
+        return !(rx_window_[(seq / 64) % kReplayWords] & (uint64_t(1) << (seq % 64)));
+    }
+
+    void NativeCrypto::Accept(
+        uint64_t seq)
+    {
+        if (seq > rx_top_)
+        {
+            // clear the words the window slid over
+            const uint64_t top_word = rx_top_ / 64;
+            const uint64_t new_word = seq / 64;
+            const uint64_t clear = std::min(new_word - top_word, uint64_t{kReplayWords});
+            for (uint64_t i = 1; i <= clear; ++i)
+                rx_window_[(top_word + i) % kReplayWords] = 0;
+            rx_top_ = seq;
+        }
+        rx_window_[(seq / 64) % kReplayWords] |= uint64_t(1) << (seq % 64);
+    }
+
+    void
+    NativeCrypto::QueryInfo(
+        Json::Value &info)
+    {
+        info["Sealed"] = (Json::UInt64)sealed_;
+        info["Opened"] = (Json::UInt64)opened_;
+        info["AuthFailures"] = (Json::UInt64)auth_failures_;
+        info["Replays"] = (Json::UInt64)replays_;
+    }
+} // namespace tincan
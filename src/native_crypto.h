@@ -0,0 +1,109 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_NATIVE_CRYPTO_H_
+#define TINCAN_NATIVE_CRYPTO_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include <openssl/aead.h>
+namespace tincan
+{
+    /* AES-128-GCM protection of the records a vlink sends on its native
+    UDP socket, keyed from the DTLS association by the keying material
+    exporter. A sealed record is [seq:64][ciphertext][tag:128], the
+    sequence number is authenticated and forms the nonce with a per
+    direction salt. It only ever counts up for the life of the keys, so a
+    socket reopened after a fallback never reuses a nonce. Received
+    sequence numbers pass a sliding window of kReplayWindow so replayed
+    and very late records are dropped. Only used on the network thread.
+    */
+    class NativeCrypto
+    {
+    public:
+        static const size_t kKeySz = 16;
+        static const size_t kSaltSz = 4;
+        static const size_t kSeqSz = 8;
+        static const size_t kTagSz = 16;
+        static const size_t kOverhead = kSeqSz + kTagSz;
+        // a key and salt for each direction
+        static const size_t kMaterialSz = 2 * (kKeySz + kSaltSz);
+
+        NativeCrypto();
+        ~NativeCrypto();
+        NativeCrypto(const NativeCrypto &) = delete;
+        NativeCrypto &operator=(const NativeCrypto &) = delete;
+
+        // The DTLS client sends with the first half of the material and
+        // the server with the second.
+        bool Initialize(
+            const uint8_t *material,
+            bool client);
+
+        // Returns the sealed length, 0 if out_cap is too small.
+        size_t Seal(
+            const char *data,
+            size_t len,
+            char *out,
+            size_t out_cap);
+
+        // Authenticates and decrypts a sealed record in place.
+        bool Open(
+            char *record,
+            size_t len,
+            const char *&data,
+            size_t &data_len);
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        static const uint64_t kReplayWindow = 1024;
+        static const size_t kReplayWords = kReplayWindow / 64;
+
+        void MakeNonce(
+            const array<uint8_t, kSaltSz> &salt,
+            uint64_t seq,
+            uint8_t *nonce) const;
+
+        bool Fresh(
+            uint64_t seq) const;
+
+        void Accept(
+            uint64_t seq);
+
+        bool initialized_;
+        EVP_AEAD_CTX tx_ctx_;
+        EVP_AEAD_CTX rx_ctx_;
+        array<uint8_t, kSaltSz> tx_salt_;
+        array<uint8_t, kSaltSz> rx_salt_;
+        uint64_t tx_seq_;
+        // the highest sequence number received and a bit per number in
+        // the window below it, indexed by the number modulo the window
+        uint64_t rx_top_;
+        array<uint64_t, kReplayWords> rx_window_;
+        uint64_t sealed_;
+        uint64_t opened_;
+        uint64_t auth_failures_;
+        uint64_t replays_;
+    };
+} // namespace tincan
+#endif // TINCAN_NATIVE_CRYPTO_H_
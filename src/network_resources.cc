@@ -0,0 +1,131 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "network_resources.h"
+#include "rtc_base/logging.h"
+namespace tincan
+{
+    constexpr std::chrono::seconds NetworkResources::kResolveTtl;
+
+    shared_ptr<rtc::BasicNetworkManager>
+    NetworkResources::NetworkManager(
+        rtc::Thread *thread,
+        const vector<string> &ignored_list)
+    {
+        vector<string> ignored(ignored_list);
+        std::sort(ignored.begin(), ignored.end());
+        ostringstream key;
+        for (const auto &ifname : ignored)
+            key << ifname << " ";
+        lock_guard<mutex> lg(nm_mutex_);
+        for (auto itr = net_managers_.begin(); itr != net_managers_.end();)
+        {
+            if (itr->second.expired())
+                itr = net_managers_.erase(itr);
+            else
+                ++itr;
+        }
+        auto &entry = net_managers_[make_pair(thread, key.str())];
+        auto net_manager = entry.lock();
+        if (!net_manager)
+        {
+            net_manager = make_shared<rtc::BasicNetworkManager>();
+            net_manager->set_network_ignore_list(ignored_list);
+            entry = net_manager;
+        }
+        return net_manager;
+    }
+
+    rtc::SocketAddress
+    NetworkResources::ResolveServer(
+        rtc::Thread *thread,
+        const string &server)
+    {
+        rtc::SocketAddress addr;
+        addr.FromString(server);
+        if (!addr.IsUnresolvedIP())
+            return addr;
+        lock_guard<mutex> lg(resolve_mutex_);
+        auto itr = resolved_.find(addr.hostname());
+        if (itr != resolved_.end() && steady_clock::now() < itr->second.expiry)
+        {
+            addr.SetResolvedIP(itr->second.ip);
+            return addr;
+        }
+        if (!resolving_.insert(addr.hostname()).second)
+            return addr;
+        thread->PostTask(RTC_FROM_HERE, [this, addr]()
+                         { StartResolve(addr); });
+        return addr;
+    }
+
+    void
+    NetworkResources::StartResolve(
+        const rtc::SocketAddress &addr)
+    {
+        auto resolver = new rtc::AsyncResolver();
+        {
+            lock_guard<mutex> lg(resolve_mutex_);
+            pending_[resolver] = addr.hostname();
+        }
+        resolver->SignalDone.connect(this, &NetworkResources::OnResolveDone);
+        resolver->Start(addr);
+    }
+
+    void
+    NetworkResources::OnResolveDone(
+        rtc::AsyncResolverInterface *resolver)
+    {
+        rtc::SocketAddress resolved;
+        bool status = resolver->GetError() == 0 &&
+                      (resolver->GetResolvedAddress(AF_INET, &resolved) ||
+                       resolver->GetResolvedAddress(AF_INET6, &resolved));
+        {
+            lock_guard<mutex> lg(resolve_mutex_);
+            string host = pending_[resolver];
+            pending_.erase(resolver);
+            resolving_.erase(host);
+            if (status)
+                resolved_[host] = {resolved.ipaddr(), steady_clock::now() + kResolveTtl};
+            else
+                RTC_LOG(LS_WARNING) << "Failed to resolve server " << host;
+        }
+        resolver->Destroy(false);
+    }
+
+    void
+    NetworkResources::QueryInfo(
+        Json::Value &res_info)
+    {
+        {
+            lock_guard<mutex> lg(nm_mutex_);
+            Json::UInt64 active = 0;
+            for (const auto &nm : net_managers_)
+                active += nm.second.expired() ? 0 : 1;
+            res_info["NetworkManagers"] = active;
+        }
+        lock_guard<mutex> lg(resolve_mutex_);
+        res_info["ResolvedServers"] = Json::Value(Json::objectValue);
+        for (const auto &host : resolved_)
+            res_info["ResolvedServers"][host.first] = host.second.ip.ToString();
+    }
+} // namespace tincan
@@ -0,0 +1,84 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_NETWORK_RESOURCES_H_
+#define TINCAN_NETWORK_RESOURCES_H_
+#include "tincan_base.h"
+#include <set>
+#include "rtc_base/net_helpers.h"
+#include "rtc_base/network.h"
+#include "rtc_base/socket_address.h"
+#include "rtc_base/strings/json.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+namespace tincan
+{
+    /* Network state that is expensive to rebuild for every vlink. Links on
+    the same network thread share one BasicNetworkManager so host interfaces
+    are enumerated once, and STUN/TURN host names are resolved once per TTL
+    instead of once per link.
+    */
+    class NetworkResources : public sigslot::has_slots<>
+    {
+    public:
+        NetworkResources() = default;
+        NetworkResources(const NetworkResources &) = delete;
+        NetworkResources &operator=(const NetworkResources &) = delete;
+        ~NetworkResources() = default;
+
+        // The manager is released when the last link using it is destroyed,
+        // which happens on |thread|.
+        shared_ptr<rtc::BasicNetworkManager> NetworkManager(
+            rtc::Thread *thread,
+            const vector<string> &ignored_list);
+
+        // Returns the cached address if it is still fresh. Otherwise returns
+        // the unresolved address and refreshes the cache on |thread|.
+        rtc::SocketAddress ResolveServer(
+            rtc::Thread *thread,
+            const string &server);
+
+        void QueryInfo(
+            Json::Value &res_info);
+
+    private:
+        void StartResolve(
+            const rtc::SocketAddress &addr);
+
+        void OnResolveDone(
+            rtc::AsyncResolverInterface *resolver);
+
+        struct ResolvedHost
+        {
+            rtc::IPAddress ip;
+            steady_clock::time_point expiry;
+        };
+        static constexpr std::chrono::seconds kResolveTtl{300};
+        mutex nm_mutex_;
+        map<pair<rtc::Thread *, string>, weak_ptr<rtc::BasicNetworkManager>> net_managers_;
+        mutex resolve_mutex_;
+        unordered_map<string, ResolvedHost> resolved_;
+        std::set<string> resolving_;
+        unordered_map<rtc::AsyncResolverInterface *, string> pending_;
+    };
+} // namespace tincan
+#endif // TINCAN_NETWORK_RESOURCES_H_
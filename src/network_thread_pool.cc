@@ -0,0 +1,94 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "network_thread_pool.h"
+#include "rtc_base/logging.h"
+#include "tincan_exception.h"
+namespace tincan
+{
+    NetworkThreadPool::NetworkThreadPool(
+        size_t num_threads)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        workers_.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            Worker wrk{make_unique<rtc::Thread>(rtc::SocketServer::CreateDefault()), 0};
+            ostringstream name;
+            name << "NetworkThread-" << i;
+            wrk.thread->SetName(name.str(), this);
+            if (!wrk.thread->Start())
+                throw TCEXCEPT("Failed to start a network thread");
+            workers_.push_back(std::move(wrk));
+        }
+    }
+
+    NetworkThreadPool::~NetworkThreadPool()
+    {
+        for (auto &wrk : workers_)
+            wrk.thread->Stop();
+    }
+
+    rtc::Thread *
+    NetworkThreadPool::Acquire(
+        const string &key)
+    {
+        lock_guard<mutex> lg(workers_mutex_);
+        size_t sel = hash<string>{}(key) % workers_.size();
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            if (workers_[i].load < workers_[sel].load)
+                sel = i;
+        }
+        workers_[sel].load++;
+        return workers_[sel].thread.get();
+    }
+
+    void
+    NetworkThreadPool::Release(
+        rtc::Thread *thread)
+    {
+        lock_guard<mutex> lg(workers_mutex_);
+        for (auto &wrk : workers_)
+        {
+            if (wrk.thread.get() == thread)
+            {
+                if (wrk.load > 0)
+                    wrk.load--;
+                return;
+            }
+        }
+        RTC_LOG(LS_WARNING) << "Released a thread that is not in the network thread pool";
+    }
+
+    void
+    NetworkThreadPool::QueryInfo(
+        Json::Value &pool_info)
+    {
+        lock_guard<mutex> lg(workers_mutex_);
+        pool_info["Size"] = (Json::UInt64)workers_.size();
+        pool_info["Load"] = Json::Value(Json::arrayValue);
+        for (const auto &wrk : workers_)
+            pool_info["Load"].append((Json::UInt64)wrk.load);
+    }
+} // namespace tincan
@@ -0,0 +1,64 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_NETWORK_THREAD_POOL_H_
+#define TINCAN_NETWORK_THREAD_POOL_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "rtc_base/thread.h"
+namespace tincan
+{
+    /* A fixed set of rtc network threads shared by every tunnel in the
+    process. A tunnel is pinned to a single thread for its lifetime so all
+    work posted for its vlink runs in order on that thread.
+    */
+    class NetworkThreadPool
+    {
+    public:
+        explicit NetworkThreadPool(size_t num_threads = 0);
+        NetworkThreadPool(const NetworkThreadPool &) = delete;
+        NetworkThreadPool &operator=(const NetworkThreadPool &) = delete;
+        ~NetworkThreadPool();
+
+        // Returns the least loaded thread, ties are broken by hashing the key.
+        rtc::Thread *Acquire(
+            const string &key);
+
+        void Release(
+            rtc::Thread *thread);
+
+        size_t Size() const { return workers_.size(); }
+
+        void QueryInfo(
+            Json::Value &pool_info);
+
+    private:
+        struct Worker
+        {
+            unique_ptr<rtc::Thread> thread;
+            size_t load;
+        };
+        mutex workers_mutex_;
+        vector<Worker> workers_;
+    };
+} // namespace tincan
+#endif // TINCAN_NETWORK_THREAD_POOL_H_
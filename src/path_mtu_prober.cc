@@ -0,0 +1,176 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "path_mtu_prober.h"
+namespace tincan
+{
+    PathMtuProber::PathMtuProber(
+        size_t base,
+        size_t max) : base_(std::min(base, max)),
+                      max_(max),
+                      state_(kBase),
+                      plpmtu_(base_),
+                      low_(base_),
+                      high_(max_),
+                      probe_size_(0),
+                      probe_id_(0),
+                      probe_outstanding_(false),
+                      first_probe_(false),
+                      attempts_(0),
+                      deadline_ms_(0),
+                      raise_ms_(0),
+                      confirm_ms_(0),
+                      searches_(0),
+                      black_holes_(0),
+                      probes_sent_(0),
+                      probes_acked_(0),
+                      probes_lost_(0)
+    {
+    }
+
+    void PathMtuProber::Reset()
+    {
+        plpmtu_ = base_;
+        StartSearch(base_);
+    }
+
+    void
+    PathMtuProber::StartSearch(
+        size_t low)
+    {
+        ++searches_;
+        state_ = kSearching;
+        low_ = low;
+        high_ = max_;
+        first_probe_ = true;
+        attempts_ = 0;
+        probe_outstanding_ = false;
+    }
+
+    size_t
+    PathMtuProber::Poll(
+        int64_t now_ms,
+        uint16_t &probe_id)
+    {
+        if (state_ == kBase)
+            return 0;
+        if (probe_outstanding_)
+        {
+            if (now_ms < deadline_ms_)
+                return 0;
+            probe_outstanding_ = false;
+            ++probes_lost_;
+            if (attempts_ >= kMaxProbes && state_ == kSearchComplete)
+            {
+                // the size that passed no longer does
+                ++black_holes_;
+                plpmtu_ = base_;
+                StartSearch(base_);
+            }
+            else if (attempts_ >= kMaxProbes)
+            {
+                high_ = probe_size_ - 1;
+                attempts_ = 0;
+                first_probe_ = false;
+            }
+        }
+        if (state_ == kSearchComplete)
+        {
+            if (plpmtu_ > base_ && (attempts_ > 0 || now_ms >= confirm_ms_))
+            {
+                if (attempts_ == 0)
+                    confirm_ms_ = now_ms + kConfirmIntervalMs;
+                probe_size_ = plpmtu_;
+            }
+            else if (now_ms >= raise_ms_ && plpmtu_ < max_)
+                StartSearch(plpmtu_);
+            else
+                return 0;
+        }
+        if (attempts_ == 0 && state_ == kSearching)
+        {
+            if (low_ >= high_ || (!first_probe_ && high_ - low_ < kSearchGranularity))
+            {
+                state_ = kSearchComplete;
+                raise_ms_ = now_ms + kRaiseIntervalMs;
+                confirm_ms_ = now_ms + kConfirmIntervalMs;
+                return 0;
+            }
+            probe_size_ = first_probe_ ? high_ : low_ + (high_ - low_ + 1) / 2;
+        }
+        ++attempts_;
+        ++probes_sent_;
+        probe_id = ++probe_id_;
+        probe_outstanding_ = true;
+        deadline_ms_ = now_ms + kProbeTimeoutMs;
+        return probe_size_;
+    }
+
+    void
+    PathMtuProber::OnProbeAcked(
+        uint16_t probe_id,
+        size_t size)
+    {
+        if (!probe_outstanding_ || probe_id != probe_id_ || size != probe_size_)
+            return;
+        ++probes_acked_;
+        probe_outstanding_ = false;
+        first_probe_ = false;
+        attempts_ = 0;
+        low_ = size;
+        plpmtu_ = std::max(plpmtu_, size);
+    }
+
+    int64_t
+    PathMtuProber::NextPollMs(
+        int64_t now_ms) const
+    {
+        if (state_ == kBase)
+            return kRaiseIntervalMs;
+        if (probe_outstanding_)
+            return std::max<int64_t>(deadline_ms_ - now_ms, 1);
+        if (state_ == kSearchComplete)
+        {
+            int64_t next_ms = plpmtu_ < max_ ? raise_ms_ : now_ms + kRaiseIntervalMs;
+            if (plpmtu_ > base_)
+                next_ms = std::min(next_ms, confirm_ms_);
+            return std::max<int64_t>(next_ms - now_ms, 1);
+        }
+        return 1;
+    }
+
+    void
+    PathMtuProber::QueryInfo(
+        Json::Value &info)
+    {
+        const char *states[] = {"Base", "Searching", "SearchComplete"};
+        info["State"] = states[state_];
+        info["Plpmtu"] = (Json::UInt64)plpmtu_;
+        info["Base"] = (Json::UInt64)base_;
+        info["Max"] = (Json::UInt64)max_;
+        info["Searches"] = searches_;
+        info["BlackHoles"] = black_holes_;
+        info["ProbesSent"] = (Json::UInt64)probes_sent_;
+        info["ProbesAcked"] = (Json::UInt64)probes_acked_;
+        info["ProbesLost"] = (Json::UInt64)probes_lost_;
+    }
+} // namespace tincan
@@ -0,0 +1,113 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_PATH_MTU_PROBER_H_
+#define TINCAN_PATH_MTU_PROBER_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* Packetization layer path MTU discovery (RFC 8899) for a vlink. Sizes
+    are vlink record sizes, the DTLS, UDP, IP and TURN overheads are part of
+    what the probes measure. The search first tries the largest record the
+    link can produce, most paths carry it, and otherwise bisects between
+    the base and that size. A probe is lost after kProbeTimeoutMs and a size
+    is given up after kMaxProbes losses. A completed search is repeated
+    after kRaiseIntervalMs in case the path grew, and the owner restarts it
+    from the base whenever the path changes. In between, the size found is
+    confirmed every kConfirmIntervalMs, and if kMaxProbes of those probes
+    are lost the path has become a black hole for it: the prober falls back
+    to the base and searches again. The prober only keeps state, sending
+    probes and acks is left to the owner.
+    */
+    class PathMtuProber
+    {
+    public:
+        PathMtuProber(
+            size_t base,
+            size_t max);
+        PathMtuProber(const PathMtuProber &) = delete;
+        PathMtuProber &operator=(const PathMtuProber &) = delete;
+
+        // Falls back to the base and searches the new path.
+        void Reset();
+
+        // Returns the size of the probe to send now and sets its id, or 0 if
+        // there is nothing to send.
+        size_t Poll(
+            int64_t now_ms,
+            uint16_t &probe_id);
+
+        void OnProbeAcked(
+            uint16_t probe_id,
+            size_t size);
+
+        // ms until Poll should be called again
+        int64_t NextPollMs(
+            int64_t now_ms) const;
+
+        // the largest record known to pass
+        size_t Plpmtu() const { return plpmtu_; }
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        enum State
+        {
+            kBase,
+            kSearching,
+            kSearchComplete,
+        };
+
+        void StartSearch(
+            size_t low);
+
+        static const int64_t kProbeTimeoutMs = 1000;
+        static const int64_t kRaiseIntervalMs = 600000;
+        static const int64_t kConfirmIntervalMs = 5000;
+        static const int kMaxProbes = 3;
+        // the search stops once the bounds are this close
+        static const size_t kSearchGranularity = 16;
+
+        const size_t base_;
+        const size_t max_;
+        State state_;
+        size_t plpmtu_;
+        size_t low_;
+        size_t high_;
+        size_t probe_size_;
+        uint16_t probe_id_;
+        bool probe_outstanding_;
+        bool first_probe_;
+        int attempts_;
+        int64_t deadline_ms_;
+        int64_t raise_ms_;
+        int64_t confirm_ms_;
+        uint32_t searches_;
+        uint32_t black_holes_;
+        uint64_t probes_sent_;
+        uint64_t probes_acked_;
+        uint64_t probes_lost_;
+    };
+} // namespace tincan
+#endif // TINCAN_PATH_MTU_PROBER_H_
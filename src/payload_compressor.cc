@@ -0,0 +1,328 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "payload_compressor.h"
+#include <cmath>
+#include "rtc_base/time_utils.h"
+namespace tincan
+{
+    namespace
+    {
+        const size_t kMinMatch = 4;
+        // the block format ends with literals, matches stop this far from the end
+        const size_t kLastLiterals = 5;
+        const size_t kMatchFindLimit = 12;
+
+        uint32_t
+        Read32(
+            const uint8_t *p)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        bool
+        WriteLength(
+            size_t len,
+            uint8_t *&op,
+            const uint8_t *end)
+        {
+            for (; len >= 255; len -= 255)
+            {
+                if (op >= end)
+                    return false;
+                *op++ = 255;
+            }
+            if (op >= end)
+                return false;
+            *op++ = static_cast<uint8_t>(len);
+            return true;
+        }
+    } // namespace
+
+    PayloadCompressor::PayloadCompressor() : tx_frames_(0),
+                                             tx_compressed_(0),
+                                             tx_bypassed_(0),
+                                             tx_in_bytes_(0),
+                                             tx_out_bytes_(0),
+                                             tx_nanos_(0),
+                                             rx_decompressed_(0),
+                                             rx_nanos_(0),
+                                             rx_errors_(0)
+    {
+    }
+
+    size_t
+    PayloadCompressor::Encode(
+        const FrameInfo &info,
+        const char *frame,
+        size_t len,
+        size_t offset,
+        char *out,
+        size_t cap)
+    {
+        ++tx_frames_;
+        const size_t src_len = len - offset;
+        if (src_len < kMinCompressSz || cap < 3)
+        {
+            ++tx_bypassed_;
+            return 0;
+        }
+        const int64_t start = rtc::TimeNanos();
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(frame) + offset;
+        FlowState &flow = flows_[info.flow_hash % kFlowTableSz];
+        if (flow.flow_hash != info.flow_hash)
+        {
+            flow = FlowState();
+            flow.flow_hash = info.flow_hash;
+        }
+        bool try_it = true;
+        if (flow.bypass_left > 0)
+        {
+            --flow.bypass_left;
+            try_it = false;
+        }
+        else if (flow.frames++ % kSampleInterval == 0 &&
+                 SampleEntropy(reinterpret_cast<const uint8_t *>(frame) + info.payload_offset,
+                               len - info.payload_offset) > kEntropyLimit)
+        {
+            flow.bypass_left = kBypassFrames;
+            try_it = false;
+        }
+        if (try_it)
+        {
+            // the result must beat the raw bytes to be worth sending
+            uint8_t *dst = reinterpret_cast<uint8_t *>(out) + 2;
+            size_t clen = Compress(src, src_len, dst, std::min(cap, src_len - src_len / 16) - 2);
+            if (clen > 0)
+            {
+                out[0] = static_cast<char>(src_len >> 8);
+                out[1] = static_cast<char>(src_len);
+                ++tx_compressed_;
+                tx_in_bytes_ += src_len;
+                tx_out_bytes_ += clen + 2;
+                tx_nanos_ += rtc::TimeNanos() - start;
+                return clen + 2;
+            }
+            flow.bypass_left = kBypassFrames / 4;
+        }
+        tx_nanos_ += rtc::TimeNanos() - start;
+        ++tx_bypassed_;
+        return 0;
+    }
+
+    size_t
+    PayloadCompressor::Decode(
+        const char *data,
+        size_t len,
+        char *out,
+        size_t out_cap)
+    {
+        if (len < 2)
+        {
+            ++rx_errors_;
+            return 0;
+        }
+        const int64_t start = rtc::TimeNanos();
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+        const size_t orig_len = (size_t(p[0]) << 8) | p[1];
+        size_t dlen = 0;
+        if (orig_len <= out_cap)
+            dlen = Decompress(p + 2, len - 2, reinterpret_cast<uint8_t *>(out), orig_len);
+        rx_nanos_ += rtc::TimeNanos() - start;
+        if (dlen != orig_len)
+        {
+            ++rx_errors_;
+            return 0;
+        }
+        ++rx_decompressed_;
+        return dlen;
+    }
+
+    void
+    PayloadCompressor::QueryInfo(
+        Json::Value &info)
+    {
+        info["TxFrames"] = (Json::UInt64)tx_frames_;
+        info["TxCompressed"] = (Json::UInt64)tx_compressed_;
+        info["TxBypassed"] = (Json::UInt64)tx_bypassed_;
+        info["Ratio"] = tx_out_bytes_ ? double(tx_in_bytes_) / tx_out_bytes_ : 1.0;
+        info["BytesSaved"] = (Json::Int64)(tx_in_bytes_ - tx_out_bytes_);
+        info["TxCpuUs"] = (Json::UInt64)(tx_nanos_ / 1000);
+        info["TxNsPerFrame"] = tx_frames_ ? (Json::UInt64)(tx_nanos_ / tx_frames_) : 0;
+        info["RxDecompressed"] = (Json::UInt64)rx_decompressed_;
+        info["RxCpuUs"] = (Json::UInt64)(rx_nanos_ / 1000);
+        info["RxErrors"] = (Json::UInt64)rx_errors_;
+    }
+
+    double
+    PayloadCompressor::SampleEntropy(
+        const uint8_t *data,
+        size_t len)
+    {
+        // a strided sample of up to 256 bytes, fewer cannot tell random
+        // data from text reliably
+        if (len < 64)
+            return 0.0;
+        array<uint16_t, 256> hist{};
+        const size_t stride = std::max<size_t>(1, len / 256);
+        size_t n = 0;
+        for (size_t i = 0; i < len && n < 256; i += stride, ++n)
+            hist[data[i]]++;
+        double entropy = 0.0;
+        for (uint16_t c : hist)
+        {
+            if (c == 0)
+                continue;
+            const double p = double(c) / n;
+            entropy -= p * std::log2(p);
+        }
+        return entropy;
+    }
+
+    size_t
+    PayloadCompressor::Compress(
+        const uint8_t *src,
+        size_t len,
+        uint8_t *dst,
+        size_t cap)
+    {
+        uint8_t *op = dst;
+        const uint8_t *oend = dst + cap;
+        size_t anchor = 0;
+        if (len > kMatchFindLimit)
+        {
+            array<uint16_t, 1 << kHashBits> table{};
+            const size_t limit = len - kMatchFindLimit;
+            const size_t match_limit = len - kLastLiterals;
+            size_t ip = 1;
+            table[(Read32(src) * 2654435761u) >> (32 - kHashBits)] = 0;
+            while (ip < limit)
+            {
+                const uint32_t seq = Read32(src + ip);
+                const uint32_t h = (seq * 2654435761u) >> (32 - kHashBits);
+                const size_t ref = table[h];
+                table[h] = static_cast<uint16_t>(ip);
+                if (ref >= ip || Read32(src + ref) != seq)
+                {
+                    ++ip;
+                    continue;
+                }
+                size_t mlen = kMinMatch;
+                while (ip + mlen < match_limit && src[ref + mlen] == src[ip + mlen])
+                    ++mlen;
+                const size_t lit = ip - anchor;
+                if (op + 1 + lit + lit / 255 + 2 + 1 > oend)
+                    return 0;
+                uint8_t *token = op++;
+                *token = static_cast<uint8_t>(std::min<size_t>(lit, 15) << 4);
+                if (lit >= 15 && !WriteLength(lit - 15, op, oend))
+                    return 0;
+                memcpy(op, src + anchor, lit);
+                op += lit;
+                const size_t offset = ip - ref;
+                *op++ = static_cast<uint8_t>(offset);
+                *op++ = static_cast<uint8_t>(offset >> 8);
+                const size_t ml = mlen - kMinMatch;
+                *token |= static_cast<uint8_t>(std::min<size_t>(ml, 15));
+                if (ml >= 15 && !WriteLength(ml - 15, op, oend))
+                    return 0;
+                ip += mlen;
+                anchor = ip;
+            }
+        }
+        const size_t lit = len - anchor;
+        if (op + 1 + lit + lit / 255 + 1 > oend)
+            return 0;
+        uint8_t *token = op++;
+        *token = static_cast<uint8_t>(std::min<size_t>(lit, 15) << 4);
+        if (lit >= 15 && !WriteLength(lit - 15, op, oend))
+            return 0;
+        memcpy(op, src + anchor, lit);
+        op += lit;
+        return op - dst;
+    }
+
+    size_t
+    PayloadCompressor::Decompress(
+        const uint8_t *src,
+        size_t len,
+        uint8_t *dst,
+        size_t cap)
+    {
+        const uint8_t *ip = src;
+        const uint8_t *iend = src + len;
+        uint8_t *op = dst;
+        uint8_t *oend = dst + cap;
+        while (ip < iend)
+        {
+            const uint8_t token = *ip++;
+            size_t lit = token >> 4;
+            if (lit == 15)
+            {
+                uint8_t b;
+                do
+                {
+                    if (ip >= iend)
+                        return 0;
+                    b = *ip++;
+                    lit += b;
+                } while (b == 255);
+            }
+            if (lit > size_t(iend - ip) || lit > size_t(oend - op))
+                return 0;
+            memcpy(op, ip, lit);
+            op += lit;
+            ip += lit;
+            if (ip == iend)
+                break; // the last sequence has no match
+            if (iend - ip < 2)
+                return 0;
+            const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > size_t(op - dst))
+                return 0;
+            size_t mlen = token & 15;
+            if (mlen == 15)
+            {
+                uint8_t b;
+                do
+                {
+                    if (ip >= iend)
+                        return 0;
+                    b = *ip++;
+                    mlen += b;
+                } while (b == 255);
+            }
+            mlen += kMinMatch;
+            if (mlen > size_t(oend - op))
+                return 0;
+            // byte copy, the match may overlap its own output
+            const uint8_t *ref = op - offset;
+            for (size_t i = 0; i < mlen; ++i)
+                op[i] = ref[i];
+            op += mlen;
+        }
+        return op - dst;
+    }
+} // namespace tincan
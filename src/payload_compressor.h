@@ -0,0 +1,108 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_PAYLOAD_COMPRESSOR_H_
+#define TINCAN_PAYLOAD_COMPRESSOR_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "frame_parser.h"
+namespace tincan
+{
+    /* Per-link frame compression using the LZ4 block format. Each flow is
+    sampled for byte entropy every kSampleInterval frames, flows that look
+    compressed or encrypted, or that did not shrink the last time they were
+    tried, bypass the compressor for a while. Only used on the network
+    thread.
+    */
+    class PayloadCompressor
+    {
+    public:
+        PayloadCompressor();
+        PayloadCompressor(const PayloadCompressor &) = delete;
+        PayloadCompressor &operator=(const PayloadCompressor &) = delete;
+
+        // Compresses the frame bytes from offset on into out as a 16-bit
+        // original length followed by an LZ4 block. Returns the section
+        // length, or 0 if the frame should be sent as is.
+        size_t Encode(
+            const FrameInfo &info,
+            const char *frame,
+            size_t len,
+            size_t offset,
+            char *out,
+            size_t cap);
+
+        // Returns the decoded length, or 0 if the section is malformed.
+        size_t Decode(
+            const char *data,
+            size_t len,
+            char *out,
+            size_t out_cap);
+
+        void QueryInfo(
+            Json::Value &info);
+
+        static size_t Compress(
+            const uint8_t *src,
+            size_t len,
+            uint8_t *dst,
+            size_t cap);
+
+        static size_t Decompress(
+            const uint8_t *src,
+            size_t len,
+            uint8_t *dst,
+            size_t cap);
+
+    private:
+        struct FlowState
+        {
+            uint32_t flow_hash = 0;
+            uint32_t frames = 0;
+            uint32_t bypass_left = 0;
+        };
+
+        static double SampleEntropy(
+            const uint8_t *data,
+            size_t len);
+
+        static const size_t kMinCompressSz = 128;
+        static const size_t kFlowTableSz = 256;
+        static const uint32_t kSampleInterval = 64;
+        static const uint32_t kBypassFrames = 256;
+        static const size_t kHashBits = 11;
+        // bits per byte above which a payload is treated as incompressible
+        static constexpr double kEntropyLimit = 6.5;
+
+        array<FlowState, kFlowTableSz> flows_;
+        uint64_t tx_frames_;
+        uint64_t tx_compressed_;
+        uint64_t tx_bypassed_;
+        uint64_t tx_in_bytes_;
+        uint64_t tx_out_bytes_;
+        uint64_t tx_nanos_;
+        uint64_t rx_decompressed_;
+        uint64_t rx_nanos_;
+        uint64_t rx_errors_;
+    };
+} // namespace tincan
+#endif // TINCAN_PAYLOAD_COMPRESSOR_H_
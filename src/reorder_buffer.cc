@@ -0,0 +1,158 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "reorder_buffer.h"
+namespace tincan
+{
+    ReorderBuffer::ReorderBuffer(
+        size_t window,
+        int64_t timeout_ms) : slots_(window),
+                              timeout_ms_(timeout_ms),
+                              next_seq_(0),
+                              synced_(false),
+                              held_(0),
+                              reordered_(0),
+                              late_(0),
+                              skipped_(0)
+    {
+    }
+
+    ReorderBuffer::~ReorderBuffer() = default;
+
+    void
+    ReorderBuffer::Push(
+        uint32_t seq,
+        uint8_t flags,
+        const char *data,
+        size_t len,
+        int64_t now_ms)
+    {
+        if (!synced_)
+        {
+            next_seq_ = seq;
+            synced_ = true;
+        }
+        const int32_t dist = static_cast<int32_t>(seq - next_seq_);
+        if (dist < 0)
+        {
+            // its gap was already skipped, or it is a duplicate
+            ++late_;
+            SignalRecordReady(flags, data, len);
+            return;
+        }
+        if (dist == 0)
+        {
+            SignalRecordReady(flags, data, len);
+            ++next_seq_;
+            Drain();
+            return;
+        }
+        // too far ahead, give up on the oldest missing records
+        while (static_cast<uint32_t>(seq - next_seq_) >= slots_.size())
+        {
+            Slot &slot = slots_[next_seq_ % slots_.size()];
+            if (slot.used && slot.seq == next_seq_)
+                Release(slot);
+            else
+                ++skipped_;
+            ++next_seq_;
+        }
+        Drain();
+        if (seq == next_seq_)
+        {
+            SignalRecordReady(flags, data, len);
+            ++next_seq_;
+            Drain();
+            return;
+        }
+        Slot &slot = slots_[seq % slots_.size()];
+        if (slot.used)
+        {
+            ++late_; // duplicate
+            return;
+        }
+        if (held_ == 0)
+            ++reordered_;
+        slot.record.assign(data, data + len);
+        slot.seq = seq;
+        slot.flags = flags;
+        slot.arrival_ms = now_ms;
+        slot.used = true;
+        ++held_;
+    }
+
+    void
+    ReorderBuffer::Flush(
+        int64_t now_ms)
+    {
+        while (held_ > 0)
+        {
+            int64_t oldest = now_ms;
+            for (const auto &slot : slots_)
+            {
+                if (slot.used)
+                    oldest = std::min(oldest, slot.arrival_ms);
+            }
+            if (now_ms - oldest < timeout_ms_)
+                return;
+            // skip the gap in front of the oldest held record
+            while (!slots_[next_seq_ % slots_.size()].used)
+            {
+                ++skipped_;
+                ++next_seq_;
+            }
+            Drain();
+        }
+    }
+
+    void
+    ReorderBuffer::QueryInfo(
+        Json::Value &info)
+    {
+        info["Held"] = (Json::UInt64)held_;
+        info["Reordered"] = (Json::UInt64)reordered_;
+        info["Late"] = (Json::UInt64)late_;
+        info["Skipped"] = (Json::UInt64)skipped_;
+    }
+
+    void
+    ReorderBuffer::Release(
+        Slot &slot)
+    {
+        slot.used = false;
+        --held_;
+        SignalRecordReady(slot.flags, slot.record.data(), slot.record.size());
+    }
+
+    void
+    ReorderBuffer::Drain()
+    {
+        while (held_ > 0)
+        {
+            Slot &slot = slots_[next_seq_ % slots_.size()];
+            if (!slot.used || slot.seq != next_seq_)
+                return;
+            Release(slot);
+            ++next_seq_;
+        }
+    }
+} // namespace tincan
@@ -0,0 +1,94 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_REORDER_BUFFER_H_
+#define TINCAN_REORDER_BUFFER_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+namespace tincan
+{
+    /* Restores the send order of sequenced vlink records that arrived over
+    different paths. A record is held while an earlier one is missing, until
+    the window fills or the gap has been open for longer than the timeout.
+    Late records are delivered rather than dropped, TCP copes with
+    reordering far better than with loss. Only used on the network thread.
+    */
+    class ReorderBuffer
+    {
+    public:
+        ReorderBuffer(
+            size_t window,
+            int64_t timeout_ms);
+        ReorderBuffer(const ReorderBuffer &) = delete;
+        ReorderBuffer &operator=(const ReorderBuffer &) = delete;
+        ~ReorderBuffer();
+
+        void Push(
+            uint32_t seq,
+            uint8_t flags,
+            const char *data,
+            size_t len,
+            int64_t now_ms);
+
+        // Skips gaps that have outlived the timeout.
+        void Flush(
+            int64_t now_ms);
+
+        size_t Held() const { return held_; }
+
+        int64_t TimeoutMs() const { return timeout_ms_; }
+
+        void QueryInfo(
+            Json::Value &info);
+
+        // the record flags and its payload
+        sigslot::signal3<uint8_t, const char *, size_t> SignalRecordReady;
+
+    private:
+        struct Slot
+        {
+            bool used = false;
+            uint32_t seq = 0;
+            uint8_t flags = 0;
+            int64_t arrival_ms = 0;
+            // keeps its capacity between uses
+            vector<char> record;
+        };
+
+        void Release(
+            Slot &slot);
+
+        // delivers the in-order run starting at next_seq_
+        void Drain();
+
+        vector<Slot> slots_;
+        const int64_t timeout_ms_;
+        uint32_t next_seq_;
+        bool synced_;
+        size_t held_;
+        uint64_t reordered_;
+        uint64_t late_;
+        uint64_t skipped_;
+    };
+} // namespace tincan
+#endif // TINCAN_REORDER_BUFFER_H_
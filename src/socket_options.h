@@ -0,0 +1,51 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_SOCKET_OPTIONS_H_
+#define TINCAN_SOCKET_OPTIONS_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* Tuning of the UDP sockets ICE gathers on, from the tunnel's
+    SocketOptions. Zero buffer sizes get defaults sized for bulk traffic, a
+    zero anywhere else leaves the kernel's setting in place.
+    */
+    struct SocketOptions
+    {
+        SocketOptions() = default;
+        SocketOptions(const Json::Value &desc) : rcv_buf{desc["RcvBuf"].asInt()},
+                                                 snd_buf{desc["SndBuf"].asInt()},
+                                                 busy_poll{desc["BusyPoll"].asInt()},
+                                                 priority{desc["Priority"].asInt()}
+        {
+        }
+        // bytes
+        int rcv_buf = 0;
+        int snd_buf = 0;
+        // us the kernel polls the device queue for packets before it sleeps
+        int busy_poll = 0;
+        // queueing priority of sent packets on the host
+        int priority = 0;
+    };
+} // namespace tincan
+#endif // TINCAN_SOCKET_OPTIONS_H_
@@ -25,6 +25,7 @@
 #include "tincan_exception.h"
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <fcntl.h>
 
 namespace tincan
 {
@@ -46,7 +47,8 @@ namespace tincan
         const TapDescriptor &tap_desc)
     {
         string emsg("The Tap device open operation failed - ");
-        if ((fd_ = open(TUN_PATH, O_RDWR)) < 0)
+        // non-blocking so a read burst ends when the queue is drained
+        if ((fd_ = open(TUN_PATH, O_RDWR | O_NONBLOCK)) < 0)
         {
             RTC_LOG(LS_ERROR) << emsg << " - " << strerror(errno);
             return -1;
@@ -187,10 +189,14 @@ namespace tincan
             nw = write(fd_, wiob.data(), wiob.size());
             if (nw < 0)
             {
-                RTC_LOG(LS_WARNING) << "TAP write failed. "
+                // the device is full, keep the frame and wait for EPOLLOUT
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return;
+                RTC_LOG(LS_WARNING) << "TAP write failed, frame dropped. "
                                     << "iob sz:" << wiob.size() << " " << strerror(errno);
+                sendq_.pop_front();
             }
-            if ((size_t)nw == wiob.size())
+            else if ((size_t)nw == wiob.size())
             {
                 sendq_.pop_front();
             }
@@ -207,18 +213,25 @@ namespace tincan
 
     void TapDev::ReadNext()
     {
-        ssize_t nr = 0;
-        Iob riob = bp.get();
-        nr = read(fd_, riob.buf(), riob.capacity());
-        if (nr > 0)
-        {
+        // drain what is queued, bounded so a busy tap cannot starve the
+        // other channels on the epoll thread
+        size_t nf = 0;
+        for (; nf < kMaxReadBatch; ++nf)
+        {
+            Iob riob = bp.get();
+            ssize_t nr = read(fd_, riob.buf(), riob.capacity());
+            if (nr <= 0)
+            {
+                if (nr < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                    RTC_LOG(LS_WARNING) << "TAP read failed";
+                bp.put(std::move(riob));
+                break;
+            }
             riob.size(nr);
             read_completion(std::move(riob));
         }
-        else if (nr < 0)
-        {
-            RTC_LOG(LS_WARNING) << "TAP read failed";
-        }
+        if (nf > 0 && read_batch_complete)
+            read_batch_complete();
     }
 
     void
@@ -64,6 +64,8 @@ namespace tincan
         void Down();
         MacAddressType MacAddress();
         std::function<void(Iob&&)>read_completion;
+        // called after each burst of reads, lets the vlink flush its batch
+        std::function<void()>read_batch_complete;
         void WriteDirect(const char *data, size_t data_len);
         //////////////////////////////////////////////////
         void QueueWrite(Iob&& msg);
@@ -80,6 +82,7 @@ namespace tincan
         virtual void Close() override;
 
     private:
+        static const size_t kMaxReadBatch = 32;
         void SetFlags_(short a, short b);
         /////////////////////////////////////////////////////////////////////////////
         int fd_;
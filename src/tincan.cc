@@ -25,6 +25,7 @@
 #include "tincan_exception.h"
 #include "turn_descriptor.h"
 #include <execinfo.h>
+#include <fstream>
 #include <signal.h>
 
 namespace tincan
@@ -36,10 +37,14 @@ namespace tincan
                                                      {"CreateLink", &Tincan::CreateLink},
                                                      {"CreateTunnel", &Tincan::CreateTunnel},
                                                      {"Echo", &Tincan::Echo},
+                                                     {"IceRestart", &Tincan::IceRestart},
                                                      {"QueryCandidateAddressSet", &Tincan::QueryCandidateAddressSet},
                                                      {"QueryLinkStats", &Tincan::QueryLinkStats},
+                                                     {"QueryTincanInfo", &Tincan::QueryTincanInfo},
                                                      {"QueryTunnelInfo", &Tincan::QueryTunnelInfo},
                                                      {"RemoveLink", &Tincan::RemoveLink},
+                                                     {"RemoveTunnel", &Tincan::RemoveTunnel},
+                                                     {"SetLinkRate", &Tincan::SetLinkRate},
                                                  },
                                                  log_levels_{
                                                      {"NONE", rtc::LS_NONE},
@@ -49,7 +54,10 @@ namespace tincan
                                                      {"VERBOSE", rtc::LS_INFO},
                                                      {"DEBUG", rtc::LS_INFO},
                                                  },
-                                                 channel_{make_shared<ControllerCommsChannel>(tp.socket_name, *this)}
+                                                 channel_{make_shared<ControllerCommsChannel>(tp.socket_name, *this)},
+                                                 net_resources_{make_shared<NetworkResources>()},
+                                                 thread_pool_{make_shared<NetworkThreadPool>()},
+                                                 identity_pool_{make_shared<IdentityPool>()}
     {
         LogMessage::LogTimestamps();
         LogMessage::LogThreads();
@@ -93,6 +101,10 @@ namespace tincan
         sigaction(SIGINT, &shutdwm, NULL);
         sigaction(SIGTERM, &shutdwm, NULL);
 
+        // have identities of every key type CreateTunnel accepts ready
+        // before the first one arrives
+        identity_pool_->Reserve(rtc::KT_RSA);
+        identity_pool_->Reserve(rtc::KT_ECDSA);
         channel_->ConnectToController();
 
         // TD<decltype(*tunnel_)> BasicTunnelType;
@@ -174,6 +186,33 @@ namespace tincan
         channel_->Deliver(control);
     }
 
+    void
+    Tincan::IceRestart(
+        TincanControl &control)
+    {
+        bool is_resp_ready = false;
+        try
+        {
+            is_resp_ready = RestartVlink(control);
+        }
+        catch (exception &e)
+        {
+            string er_msg = "IceRestart failed. Error=";
+            er_msg.append(e.what());
+            RTC_LOG(LS_ERROR) << er_msg << ". Control Data=\n"
+                              << control.StyledString();
+            is_resp_ready = true;
+            unique_ptr<Json::Value> resp = make_unique<Json::Value>(Json::objectValue);
+            (*resp)[TincanControl::Message] = er_msg;
+            (*resp)[TincanControl::Success] = false;
+            control.SetResponse(std::move(resp));
+        }
+        if (is_resp_ready)
+        {
+            channel_->Deliver(control);
+        } // else respond when the new CAS is available
+    }
+
     void
     Tincan::QueryLinkStats(
         TincanControl &control)
@@ -183,7 +222,7 @@ namespace tincan
         (*resp)[TincanControl::Success] = false;
         try
         {
-            QueryLinkStats((*resp)[TincanControl::Message]);
+            QueryLinkStats(req, (*resp)[TincanControl::Message]);
             (*resp)[TincanControl::Message][TincanControl::TunnelId] = req[TincanControl::TunnelId];
             (*resp)[TincanControl::Success] = true;
         }
@@ -254,6 +293,73 @@ namespace tincan
         channel_->Deliver(control);
     }
 
+    void
+    Tincan::RemoveTunnel(
+        TincanControl &control)
+    {
+        bool status = false;
+        Json::Value &req = control.GetRequest();
+        string msg("The RemoveTunnel operation succeeded");
+        try
+        {
+            RemoveTunnel(req);
+            status = true;
+        }
+        catch (exception &e)
+        {
+            msg = "The RemoveTunnel operation failed.";
+            RTC_LOG(LS_WARNING) << e.what() << ". Control Data=\n"
+                                << control.StyledString();
+        }
+        control.SetResponse(msg, status);
+        channel_->Deliver(control);
+    }
+
+    void
+    Tincan::SetLinkRate(
+        TincanControl &control)
+    {
+        bool status = false;
+        Json::Value &req = control.GetRequest();
+        string msg("The SetLinkRate operation succeeded");
+        try
+        {
+            SetLinkRate(req);
+            status = true;
+        }
+        catch (exception &e)
+        {
+            msg = "The SetLinkRate operation failed. ";
+            msg.append(e.what());
+            RTC_LOG(LS_WARNING) << msg << ". Control Data=\n"
+                                << control.StyledString();
+        }
+        control.SetResponse(msg, status);
+        channel_->Deliver(control);
+    }
+
+    void
+    Tincan::QueryTincanInfo(
+        TincanControl &control)
+    {
+        unique_ptr<Json::Value> resp = make_unique<Json::Value>(Json::objectValue);
+        try
+        {
+            QueryTincanInfo((*resp)[TincanControl::Message]);
+            (*resp)[TincanControl::Success] = true;
+        }
+        catch (exception &e)
+        {
+            string er_msg = "The QueryTincanInfo operation failed. ";
+            RTC_LOG(LS_WARNING) << er_msg << e.what() << ". Control Data=\n"
+                                << control.StyledString();
+            (*resp)[TincanControl::Message] = er_msg;
+            (*resp)[TincanControl::Success] = false;
+        }
+        control.SetResponse(std::move(resp));
+        channel_->Deliver(control);
+    }
+
     void
     Tincan::ConfigureLogging(
         TincanControl &control)
@@ -293,27 +399,48 @@ namespace tincan
 
     ////////////////////////////////////////////////////////////////////////////
 
+    BasicTunnel &
+    Tincan::TunnelFromId(
+        const string &tnl_id)
+    {
+        auto itr = tunnels_.find(tnl_id);
+        if (itr == tunnels_.end())
+        {
+            string er_msg = "No tunnel exists with id ";
+            er_msg.append(tnl_id);
+            throw TCEXCEPT(er_msg.c_str());
+        }
+        return *itr->second.get();
+    }
+
     void Tincan::CreateTunnel(
         const Json::Value &tnl_desc,
         Json::Value &tnl_info)
     {
-        tunnel_ = make_unique<BasicTunnel>(
+        const string tnl_id = tnl_desc[TincanControl::TunnelId].asString();
+        if (tnl_id.empty())
+            throw TCEXCEPT("A TunnelId is required to create a tunnel");
+        if (tunnels_.count(tnl_id) != 0)
+        {
+            string er_msg = "A tunnel already exists with id ";
+            er_msg.append(tnl_id);
+            throw TCEXCEPT(er_msg.c_str());
+        }
+        auto tunnel = make_unique<BasicTunnel>(
             make_unique<TunnelDesc>(tnl_desc),
-            channel_);
+            channel_,
+            thread_pool_,
+            net_resources_,
+            identity_pool_);
         unique_ptr<TapDescriptor> tap_desc = make_unique<TapDescriptor>(
             tnl_desc["TapName"].asString(),
             tnl_desc[TincanControl::MTU].asUInt());
-        Json::Value network_ignore_list =
-            tnl_desc[TincanControl::IgnoredNetInterfaces];
-        int count = network_ignore_list.size();
-        for (int i = 0; i < count; i++)
-        {
-            if_list_.push_back(network_ignore_list[i].asString());
-        }
-        tunnel_->Configure(std::move(tap_desc));
-        tunnel_->Start();
-        tunnel_->QueryInfo(tnl_info);
-        epoll_eng_.Register(tunnel_->TapChannel(), EPOLLIN);
+        if (tunnel->Configure(std::move(tap_desc)) == -1)
+            throw TCEXCEPT("Failed to configure the tunnel");
+        tunnel->Start();
+        tunnel->QueryInfo(tnl_info);
+        epoll_eng_.Register(tunnel->TapChannel(), EPOLLIN);
+        tunnels_[tnl_id] = std::move(tunnel);
         return;
     }
 
@@ -325,16 +452,18 @@ namespace tincan
         auto resp = make_unique<Json::Value>(Json::objectValue);
         Json::Value &tnl_info = (*resp)[TincanControl::Message];
         Json::Value &link_desc = control.GetRequest();
-        if (!tunnel_)
+        const string tnl_id = link_desc[TincanControl::TunnelId].asString();
+        if (tunnels_.count(tnl_id) == 0)
         {
             CreateTunnel(link_desc, tnl_info);
             role = true;
         }
-        else
+        BasicTunnel &tunnel = TunnelFromId(tnl_id);
+        if (!role)
         {
-            tunnel_->QueryInfo(tnl_info);
+            tunnel.QueryInfo(tnl_info);
         }
-        auto vl = tunnel_->Vlink();
+        auto vl = tunnel.Vlink();
         auto vlink = vl.lock();
         if (!vlink)
         {
@@ -347,20 +476,36 @@ namespace tincan
                 link_desc[TincanControl::PeerInfo][TincanControl::FPR].asString();
             peer_desc->mac_address =
                 link_desc[TincanControl::PeerInfo][TincanControl::MAC].asString();
-            vl = tunnel_->CreateVlink(std::move(peer_desc), role, if_list_);
+            unique_ptr<VlinkDescriptor> vlink_desc = make_unique<VlinkDescriptor>();
+            vlink_desc->trickle = link_desc[TincanControl::Trickle].asBool();
+            if (link_desc.isMember("IceProfile"))
+                vlink_desc->ice_profile = IceProfile(link_desc["IceProfile"]);
+            if (link_desc.isMember("LinkOptions"))
+                vlink_desc->options = LinkOptions(link_desc["LinkOptions"]);
+            vl = tunnel.CreateVlink(std::move(vlink_desc), std::move(peer_desc), role);
             vlink = vl.lock();
-            if_list_.clear();
+            if (vlink->IsResumed())
+            {
+                // a parked link to the same peer was revived, its candidates
+                // are already gathered and DTLS is established
+                tunnel.PeerCandidates(
+                    link_desc[TincanControl::PeerInfo][TincanControl::CAS].asString());
+                (*resp)[TincanControl::Message][TincanControl::CAS] = vlink->Candidates();
+                (*resp)[TincanControl::Success] = true;
+                control.SetResponse(std::move(resp));
+                return true;
+            }
             vlink->SignalLocalCasReady.connect(this, &Tincan::OnLocalCasUpdated);
             unique_ptr<TincanControl> ctrl = make_unique<TincanControl>(control);
             ctrl->SetResponse(std::move(resp));
             std::lock_guard<std::mutex> lg(inprogess_controls_mutex_);
             inprogess_controls_[control.GetTransactionId()] = std::move(ctrl);
             vlink->SetCasReadyId(control.GetTransactionId());
-            tunnel_->StartConnections();
+            tunnel.StartConnections();
         }
         else
         {
-            vlink->PeerCandidates(
+            tunnel.PeerCandidates(
                 link_desc[TincanControl::PeerInfo][TincanControl::CAS].asString());
 
             (*resp)[TincanControl::Message][TincanControl::CAS] = vlink->Candidates();
@@ -371,19 +516,59 @@ namespace tincan
         return false; // the resp will be sent when the local CAS is generated
     }
 
+    bool
+    Tincan::RestartVlink(
+        TincanControl &control)
+    {
+        Json::Value &req = control.GetRequest();
+        BasicTunnel &tunnel = TunnelFromId(req[TincanControl::TunnelId].asString());
+        auto vlink = tunnel.Vlink().lock();
+        if (!vlink)
+            throw TCEXCEPT("The tunnel has no vlink to restart");
+        const string peer_cas = req[TincanControl::PeerInfo][TincanControl::CAS].asString();
+        // park the control first, gathering may complete before IceRestart returns
+        const uint64_t control_id = control.GetTransactionId();
+        {
+            unique_ptr<TincanControl> ctrl = make_unique<TincanControl>(control);
+            ctrl->SetResponse(make_unique<Json::Value>(Json::objectValue));
+            std::lock_guard<std::mutex> lg(inprogess_controls_mutex_);
+            inprogess_controls_[control_id] = std::move(ctrl);
+        }
+        if (tunnel.IceRestart(peer_cas, control_id))
+            return false; // the resp will be sent when the new local CAS is generated
+        {
+            std::lock_guard<std::mutex> lg(inprogess_controls_mutex_);
+            inprogess_controls_.erase(control_id);
+        }
+        auto resp = make_unique<Json::Value>(Json::objectValue);
+        (*resp)[TincanControl::Message][TincanControl::CAS] = vlink->Candidates();
+        (*resp)[TincanControl::Success] = true;
+        control.SetResponse(std::move(resp));
+        return true;
+    }
+
     void
     Tincan::QueryLinkCas(
         const Json::Value &link_desc,
         Json::Value &cas_info)
     {
-        tunnel_->QueryLinkCas(cas_info);
+        TunnelFromId(link_desc[TincanControl::TunnelId].asString()).QueryLinkCas(cas_info);
     }
 
     void
     Tincan::QueryLinkStats(
+        const Json::Value &link_desc,
         Json::Value &stat_info)
     {
-        tunnel_->QueryLinkInfo(stat_info);
+        TunnelFromId(link_desc[TincanControl::TunnelId].asString()).QueryLinkInfo(stat_info);
+    }
+
+    void
+    Tincan::SetLinkRate(
+        const Json::Value &link_desc)
+    {
+        TunnelFromId(link_desc[TincanControl::TunnelId].asString())
+            .SetLinkRate(link_desc["Rate"].asUInt64(), link_desc["Burst"].asUInt());
     }
 
     void
@@ -391,15 +576,56 @@ namespace tincan
         const Json::Value &tnl_desc,
         Json::Value &tnl_info)
     {
-        auto tnl_id = tnl_desc[TincanControl::TunnelId].asString();
-        tunnel_->QueryInfo(tnl_info);
+        TunnelFromId(tnl_desc[TincanControl::TunnelId].asString()).QueryInfo(tnl_info);
+    }
+
+    /* Reports the process footprint so the cost of each additional tunnel
+    served by this instance can be measured.
+    */
+    void
+    Tincan::QueryTincanInfo(
+        Json::Value &tincan_info)
+    {
+        tincan_info["TunnelCount"] = (Json::UInt64)tunnels_.size();
+        tincan_info["TunnelIds"] = Json::Value(Json::arrayValue);
+        for (const auto &tnl : tunnels_)
+            tincan_info["TunnelIds"].append(tnl.first);
+        tincan_info["MaxIobsUsed"] = (Json::UInt64)bp.max_used();
+        thread_pool_->QueryInfo(tincan_info["NetworkThreadPool"]);
+        net_resources_->QueryInfo(tincan_info["NetworkResources"]);
+        identity_pool_->QueryInfo(tincan_info["IdentityPool"]);
+        std::ifstream status("/proc/self/status");
+        string line;
+        while (std::getline(status, line))
+        {
+            istringstream iss(line);
+            string key;
+            uint64_t val = 0;
+            iss >> key >> val;
+            if (key == "VmRSS:")
+                tincan_info["VmRssKB"] = (Json::UInt64)val;
+            else if (key == "VmHWM:")
+                tincan_info["VmHwmKB"] = (Json::UInt64)val;
+            else if (key == "Threads:")
+                tincan_info["Threads"] = (Json::UInt64)val;
+        }
     }
 
     void
     Tincan::RemoveVlink(
         const Json::Value &link_desc)
     {
-        tunnel_->RemoveLink();
+        TunnelFromId(link_desc[TincanControl::TunnelId].asString()).RemoveLink();
+    }
+
+    void
+    Tincan::RemoveTunnel(
+        const Json::Value &tnl_desc)
+    {
+        const string tnl_id = tnl_desc[TincanControl::TunnelId].asString();
+        BasicTunnel &tunnel = TunnelFromId(tnl_id);
+        epoll_eng_.Deregister(tunnel.TapChannel()->FileDesc());
+        tunnels_.erase(tnl_id);
     }
 
     void
@@ -482,7 +708,7 @@ namespace tincan
             RTC_LOG(LS_ERROR) << e.what();
         }
         epoll_eng_.Shutdown();
-        tunnel_.reset();
+        tunnels_.clear();
         RTC_LOG(LS_INFO) << "Max iobs used= " << bp.max_used();
         RTC_LOG(LS_INFO) << "Tincan shutdown completed.";
                          
@@ -48,16 +48,29 @@ namespace tincan
         bool CreateVlink(
             TincanControl &control);
 
+        bool RestartVlink(
+            TincanControl &control);
+
         void QueryLinkStats(
+            const Json::Value &link_desc,
             Json::Value &stat_info);
 
         void QueryTunnelInfo(
             const Json::Value &tnl_desc,
             Json::Value &node_info);
 
+        void SetLinkRate(
+            const Json::Value &link_desc);
+
+        void QueryTincanInfo(
+            Json::Value &tincan_info);
+
         void RemoveVlink(
             const Json::Value &link_desc);
 
+        void RemoveTunnel(
+            const Json::Value &tnl_desc);
+
         void QueryLinkCas(
             const Json::Value &link_desc,
             Json::Value &cas_info);
@@ -79,12 +92,17 @@ namespace tincan
         using TCDSIP = void (Tincan::*)(TincanControl &);
         void CreateTunnel(TincanControl &control);
         void CreateLink(TincanControl &control);
+        void IceRestart(TincanControl &control);
         void QueryTunnelInfo(TincanControl &control);
         void QueryLinkStats(TincanControl &control);
         void Echo(TincanControl &control);
         void QueryCandidateAddressSet(TincanControl &control);
         void RemoveLink(TincanControl &control);
+        void RemoveTunnel(TincanControl &control);
+        void QueryTincanInfo(TincanControl &control);
+        void SetLinkRate(TincanControl &control);
         void ConfigureLogging(TincanControl &control);
+        BasicTunnel &TunnelFromId(const string &tnl_id);
         //
         const TincanParameters &tp_;
         static atomic_bool exit_flag_;
@@ -93,10 +111,14 @@ namespace tincan
         unique_ptr<FileRotatingLogSink> log_sink_;
         EpollEngine epoll_eng_;
         shared_ptr<ControllerCommsChannel> channel_;
+        shared_ptr<NetworkResources> net_resources_;
+        // Declared after net_resources_ so the pool threads are stopped before
+        // the tasks queued on them can reach a destroyed NetworkResources.
+        shared_ptr<NetworkThreadPool> thread_pool_;
+        shared_ptr<IdentityPool> identity_pool_;
         mutex inprogess_controls_mutex_;
         unordered_map<uint64_t, unique_ptr<TincanControl>> inprogess_controls_;
-        vector<string> if_list_;
-        unique_ptr<BasicTunnel> tunnel_;
+        unordered_map<string, unique_ptr<BasicTunnel>> tunnels_;
     };
 } // namespace tincan
 #endif // TINCAN_TINCAN_H_
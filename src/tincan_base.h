@@ -24,6 +24,7 @@
 #define TINCAN_BASE_H_
 #include <atomic>
 #include <cassert>
+#include <cctype>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
@@ -51,6 +52,7 @@ namespace tincan
 {
     using MacAddressType = std::array<uint8_t, 6>;
     using IP4AddressType = std::array<uint8_t, 4>;
+    const size_t kEthernetHeaderSz = 14;
     using std::array;
     using std::atomic_bool;
     using std::cout;
@@ -119,7 +121,7 @@ namespace tincan
                          const string &log_config,
                          const string &tunnel_id,
                          const bool verchk,
-                         bool needs_help) : socket_name(socket_name), tunnel_id(tunnel_id), log_config(log_config), kVersionCheck(verchk), kNeedsHelp(needs_help || socket_name.empty() || tunnel_id.empty())
+                         bool needs_help) : socket_name(socket_name), tunnel_id(tunnel_id), log_config(log_config), kVersionCheck(verchk), kNeedsHelp(needs_help || socket_name.empty())
         {
         }
         const string socket_name;
@@ -155,6 +157,26 @@ namespace tincan
         }
         return oss.str();
     }
+    // Parses pairs of hex digits, separators between them are skipped.
+    // Returns false unless the string fills the whole range.
+    template <typename OutputIter>
+    bool StringToByteArray(
+        const string &str,
+        OutputIter first,
+        OutputIter last)
+    {
+        size_t i = 0;
+        while (first != last)
+        {
+            while (i < str.size() && !isxdigit(static_cast<unsigned char>(str[i])))
+                ++i;
+            if (i + 1 >= str.size() || !isxdigit(static_cast<unsigned char>(str[i + 1])))
+                return false;
+            *first++ = static_cast<uint8_t>(std::stoul(str.substr(i, 2), nullptr, 16));
+            i += 2;
+        }
+        return true;
+    }
     // TD (Type Displayer) decl only to cause syntax error 
     template <typename T> class TD;
 } // namespace tincan
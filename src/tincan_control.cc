@@ -36,11 +36,13 @@ namespace tincan
     const Json::StaticString TincanControl::Echo("Echo");
     const Json::StaticString TincanControl::EncryptionEnabled("EncryptionEnabled");
     const Json::StaticString TincanControl::FPR("FPR");
+    const Json::StaticString TincanControl::GatheringComplete("GatheringComplete");
     const Json::StaticString TincanControl::ICC("ICC");
     const Json::StaticString TincanControl::IceRole("IceRole");
     const Json::StaticString TincanControl::IgnoredNetInterfaces("IgnoredNetInterfaces");
     const Json::StaticString TincanControl::IP4PrefixLen("IP4PrefixLen");
     const Json::StaticString TincanControl::EVIO("EVIO");
+    const Json::StaticString TincanControl::LinkCasUpdated("LinkCasUpdated");
     const Json::StaticString TincanControl::LinkId("LinkId");
     const Json::StaticString TincanControl::LinkConnected("LinkConnected");
     const Json::StaticString TincanControl::LinkDisconnected("LinkDisconnected");
@@ -68,6 +70,7 @@ namespace tincan
     const Json::StaticString TincanControl::TapName("TapName");
     const Json::StaticString TincanControl::TincanLevel("TincanLevel");
     const Json::StaticString TincanControl::TransactionId("TransactionId");
+    const Json::StaticString TincanControl::Trickle("Trickle");
     const Json::StaticString TincanControl::TunnelId("TunnelId");
     const Json::StaticString TincanControl::Type("Type");
     const Json::StaticString TincanControl::UID("UID");
@@ -99,12 +99,14 @@ namespace tincan
         static const Json::StaticString Echo;
         static const Json::StaticString EncryptionEnabled;
         static const Json::StaticString FPR;
+        static const Json::StaticString GatheringComplete;
         static const Json::StaticString ICC;
         static const Json::StaticString IceRole;
         static const Json::StaticString IgnoredNetInterfaces;
         static const Json::StaticString TapName;
         static const Json::StaticString IP4PrefixLen;
         static const Json::StaticString EVIO;
+        static const Json::StaticString LinkCasUpdated;
         static const Json::StaticString LinkId;
         static const Json::StaticString LinkConnected;
         static const Json::StaticString LinkDisconnected;
@@ -132,6 +134,7 @@ namespace tincan
         static const Json::StaticString Success;
         static const Json::StaticString TincanLevel;
         static const Json::StaticString TransactionId;
+        static const Json::StaticString Trickle;
         static const Json::StaticString TunnelId;
         static const Json::StaticString Type;
         static const Json::StaticString VIP4;
@@ -55,6 +55,8 @@ int main(int argc, char **argv)
         {
             std::cout << "-v\t\tDisplay version number." << endl
                       << "-s SOCKETNAME\t\tThe controler's Unix Domain Socket name" << endl
+                      << "-t TUNNELID\t\tThe tunnel served by this process. Omit to serve multiple tunnels" << endl
+                      << "-l LOGCONFIG\t\tJSON logging configuration" << endl
                       << "-h\t\tHelp menu" << endl;
         }
         else
@@ -0,0 +1,409 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "tincan_socket_factory.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+#include <errno.h>
+#include <unistd.h>
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+namespace tincan
+{
+    namespace
+    {
+        const size_t kRxCtrlSz = CMSG_SPACE(sizeof(uint32_t));
+    } // namespace
+
+    UdpSocketShared::UdpSocketShared() : rx_buf(kRecvSlots * kSlotSz),
+                                         rx_ctrl(kRecvSlots * kRxCtrlSz)
+    {
+    }
+
+    TincanUdpSocket::TincanUdpSocket(
+        rtc::PhysicalSocketServer *socket_server,
+        shared_ptr<UdpSocketShared> shared) : socket_server_(socket_server),
+                                              shared_(move(shared)),
+                                              fd_(-1),
+                                              error_(0),
+                                              write_blocked_(false),
+                                              overflows_(0),
+                                              alive_(make_shared<bool>(true))
+    {
+    }
+
+    TincanUdpSocket::~TincanUdpSocket()
+    {
+        Close();
+    }
+
+    bool
+    TincanUdpSocket::Bind(
+        const rtc::SocketAddress &local_addr,
+        uint16_t min_port,
+        uint16_t max_port,
+        const SocketOptions &opts)
+    {
+        fd_ = socket(local_addr.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+        {
+            error_ = errno;
+            RTC_LOG(LS_WARNING) << "Failed to create a UDP socket. ERRNO: " << error_;
+            return false;
+        }
+        Tune(opts);
+        sockaddr_storage addr{};
+        socklen_t addr_len = 0;
+        int rv = -1;
+        if (min_port == 0 && max_port == 0)
+        {
+            addr_len = local_addr.ToSockAddrStorage(&addr);
+            rv = bind(fd_, reinterpret_cast<sockaddr *>(&addr), addr_len);
+        }
+        else
+        {
+            for (uint32_t port = min_port; rv != 0 && port <= max_port; ++port)
+            {
+                addr_len = rtc::SocketAddress(local_addr.ipaddr(), port).ToSockAddrStorage(&addr);
+                rv = bind(fd_, reinterpret_cast<sockaddr *>(&addr), addr_len);
+            }
+        }
+        addr_len = sizeof(addr);
+        if (rv != 0 || getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &addr_len) != 0)
+        {
+            error_ = errno;
+            RTC_LOG(LS_WARNING) << "UDP bind to " << local_addr.ToString() << " failed. ERRNO: " << error_;
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        rtc::SocketAddressFromSockAddrStorage(addr, &local_addr_);
+        socket_server_->Add(this);
+        ++shared_->sockets;
+        return true;
+    }
+
+    void
+    TincanUdpSocket::Tune(
+        const SocketOptions &opts)
+    {
+        if (opts.rcv_buf > 0)
+            SetBufferSize(SO_RCVBUF, SO_RCVBUFFORCE, opts.rcv_buf, true);
+        else
+            SetBufferSize(SO_RCVBUF, SO_RCVBUFFORCE, kDefaultRcvBuf, false);
+        if (opts.snd_buf > 0)
+            SetBufferSize(SO_SNDBUF, SO_SNDBUFFORCE, opts.snd_buf, true);
+        else
+            SetBufferSize(SO_SNDBUF, SO_SNDBUFFORCE, kDefaultSndBuf, false);
+        socklen_t len = sizeof(int);
+        getsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &shared_->rcv_buf, &len);
+        len = sizeof(int);
+        getsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &shared_->snd_buf, &len);
+        if (opts.busy_poll > 0 &&
+            setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &opts.busy_poll, sizeof(opts.busy_poll)) != 0)
+            RTC_LOG(LS_WARNING) << "Failed to set SO_BUSY_POLL to " << opts.busy_poll << ". ERRNO: " << errno;
+        if (opts.priority > 0 &&
+            setsockopt(fd_, SOL_SOCKET, SO_PRIORITY, &opts.priority, sizeof(opts.priority)) != 0)
+            RTC_LOG(LS_WARNING) << "Failed to set SO_PRIORITY to " << opts.priority << ". ERRNO: " << errno;
+        // the kernel's drop count rides along with the received packets
+        const int on = 1;
+        setsockopt(fd_, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+    }
+
+    void
+    TincanUdpSocket::SetBufferSize(
+        int opt,
+        int force_opt,
+        int size,
+        bool force)
+    {
+        // the FORCE variants need CAP_NET_ADMIN
+        if (force && setsockopt(fd_, SOL_SOCKET, force_opt, &size, sizeof(size)) == 0)
+            return;
+        if (setsockopt(fd_, SOL_SOCKET, opt, &size, sizeof(size)) != 0)
+            RTC_LOG(LS_WARNING) << "Failed to set the socket buffer size to " << size << ". ERRNO: " << errno;
+    }
+
+    int TincanUdpSocket::Close()
+    {
+        if (fd_ < 0)
+            return 0;
+        socket_server_->Remove(this);
+        close(fd_);
+        fd_ = -1;
+        --shared_->sockets;
+        return 0;
+    }
+
+    int
+    TincanUdpSocket::Send(
+        const void *,
+        size_t,
+        const rtc::PacketOptions &)
+    {
+        // never connected, ICE addresses every packet
+        error_ = ENOTCONN;
+        return -1;
+    }
+
+    int
+    TincanUdpSocket::SendTo(
+        const void *pv,
+        size_t cb,
+        const rtc::SocketAddress &addr,
+        const rtc::PacketOptions &options)
+    {
+        rtc::SentPacket sent_packet(options.packet_id, rtc::TimeMillis(),
+                                    options.info_signaled_after_sent);
+        rtc::CopySocketInformationToPacketInfo(cb, *this, true, &sent_packet.info);
+        sockaddr_storage saddr{};
+        const socklen_t saddr_len = local_addr_.family() == AF_INET6 ? addr.ToDualStackSockAddrStorage(&saddr)
+                                                                     : addr.ToSockAddrStorage(&saddr);
+        ssize_t sent;
+        do
+        {
+            sent = sendto(fd_, pv, cb, 0, reinterpret_cast<sockaddr *>(&saddr), saddr_len);
+        } while (sent < 0 && errno == EINTR);
+        if (sent >= 0)
+        {
+            ++shared_->tx_packets;
+        }
+        else
+        {
+            error_ = errno;
+            if (error_ == EAGAIN || error_ == EWOULDBLOCK)
+            {
+                ++shared_->tx_blocked;
+                // ICE is told through SignalReadyToSend once there is room
+                if (!write_blocked_)
+                {
+                    write_blocked_ = true;
+                    socket_server_->Update(this);
+                }
+            }
+            else
+            {
+                ++shared_->tx_errors;
+            }
+        }
+        SignalSentPacket(this, sent_packet);
+        return static_cast<int>(sent);
+    }
+
+    int
+    TincanUdpSocket::TranslateOption(
+        rtc::Socket::Option opt,
+        int *level,
+        int *name)
+    {
+        const bool v6 = local_addr_.family() == AF_INET6;
+        switch (opt)
+        {
+        case rtc::Socket::OPT_DONTFRAGMENT:
+            *level = v6 ? IPPROTO_IPV6 : IPPROTO_IP;
+            *name = v6 ? IPV6_MTU_DISCOVER : IP_MTU_DISCOVER;
+            return 0;
+        case rtc::Socket::OPT_RCVBUF:
+            *level = SOL_SOCKET;
+            *name = SO_RCVBUF;
+            return 0;
+        case rtc::Socket::OPT_SNDBUF:
+            *level = SOL_SOCKET;
+            *name = SO_SNDBUF;
+            return 0;
+        case rtc::Socket::OPT_IPV6_V6ONLY:
+            *level = IPPROTO_IPV6;
+            *name = IPV6_V6ONLY;
+            return 0;
+        case rtc::Socket::OPT_DSCP:
+            *level = v6 ? IPPROTO_IPV6 : IPPROTO_IP;
+            *name = v6 ? IPV6_TCLASS : IP_TOS;
+            return 0;
+        default:
+            return -1;
+        }
+    }
+
+    int
+    TincanUdpSocket::GetOption(
+        rtc::Socket::Option opt,
+        int *value)
+    {
+        int level, name;
+        if (TranslateOption(opt, &level, &name) != 0)
+            return -1;
+        socklen_t len = sizeof(*value);
+        if (getsockopt(fd_, level, name, value, &len) != 0)
+        {
+            error_ = errno;
+            return -1;
+        }
+        if (opt == rtc::Socket::OPT_DONTFRAGMENT)
+            *value = (*value != IP_PMTUDISC_DONT) ? 1 : 0;
+        else if (opt == rtc::Socket::OPT_DSCP)
+            *value >>= 2;
+        return 0;
+    }
+
+    int
+    TincanUdpSocket::SetOption(
+        rtc::Socket::Option opt,
+        int value)
+    {
+        int level, name;
+        if (TranslateOption(opt, &level, &name) != 0)
+            return -1;
+        if (opt == rtc::Socket::OPT_DONTFRAGMENT)
+            value = value ? IP_PMTUDISC_DO : IP_PMTUDISC_DONT;
+        else if (opt == rtc::Socket::OPT_DSCP)
+            value <<= 2;
+        if (setsockopt(fd_, level, name, &value, sizeof(value)) != 0)
+        {
+            error_ = errno;
+            return -1;
+        }
+        return 0;
+    }
+
+    void
+    TincanUdpSocket::OnEvent(
+        uint32_t ff,
+        int)
+    {
+        weak_ptr<bool> guard = alive_;
+        if (ff & rtc::DE_READ)
+            ReadNext();
+        if (guard.expired() || !(ff & rtc::DE_WRITE) || !write_blocked_)
+            return;
+        write_blocked_ = false;
+        socket_server_->Update(this);
+        SignalReadyToSend(this);
+    }
+
+    void TincanUdpSocket::ReadNext()
+    {
+        weak_ptr<bool> guard = alive_;
+        // the slots must outlive a handler that destroys the socket
+        shared_ptr<UdpSocketShared> shared = shared_;
+        for (int round = 0; round < kReadBudget; ++round)
+        {
+            for (size_t i = 0; i < UdpSocketShared::kRecvSlots; ++i)
+            {
+                mmsghdr &msg = shared->rx_msgs[i];
+                memset(&msg, 0, sizeof(msg));
+                shared->rx_iovs[i].iov_base = shared->rx_buf.data() + i * UdpSocketShared::kSlotSz;
+                shared->rx_iovs[i].iov_len = UdpSocketShared::kSlotSz;
+                msg.msg_hdr.msg_name = &shared->rx_addrs[i];
+                msg.msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+                msg.msg_hdr.msg_iov = &shared->rx_iovs[i];
+                msg.msg_hdr.msg_iovlen = 1;
+                msg.msg_hdr.msg_control = shared->rx_ctrl.data() + i * kRxCtrlSz;
+                msg.msg_hdr.msg_controllen = kRxCtrlSz;
+            }
+            const int received = recvmmsg(fd_, shared->rx_msgs.data(), UdpSocketShared::kRecvSlots,
+                                          MSG_DONTWAIT, nullptr);
+            ++shared->rx_syscalls;
+            if (received <= 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    error_ = errno;
+                return;
+            }
+            // one clock read stamps the batch
+            const int64_t packet_time_us = rtc::TimeMicros();
+            for (int i = 0; i < received; ++i)
+            {
+                mmsghdr &msg = shared->rx_msgs[i];
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg.msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msg.msg_hdr, cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                    {
+                        uint32_t overflows = 0;
+                        memcpy(&overflows, CMSG_DATA(cmsg), sizeof(overflows));
+                        shared->rx_overflows += overflows - overflows_;
+                        overflows_ = overflows;
+                    }
+                }
+                if (msg.msg_hdr.msg_flags & MSG_TRUNC)
+                {
+                    ++shared->rx_truncated;
+                    continue;
+                }
+                rtc::SocketAddress remote_addr;
+                rtc::SocketAddressFromSockAddrStorage(shared->rx_addrs[i], &remote_addr);
+                ++shared->rx_packets;
+                SignalReadPacket(this, static_cast<const char *>(shared->rx_iovs[i].iov_base), msg.msg_len,
+                                 remote_addr, packet_time_us);
+                if (guard.expired())
+                    return;
+            }
+            if (received < static_cast<int>(UdpSocketShared::kRecvSlots))
+                return;
+        }
+    }
+
+    TincanSocketFactory::TincanSocketFactory(
+        rtc::Thread *network_thread,
+        const SocketOptions &opts) : rtc::BasicPacketSocketFactory(network_thread),
+                                     network_thread_(network_thread),
+                                     opts_(opts),
+                                     shared_(make_shared<UdpSocketShared>())
+    {
+    }
+
+    rtc::AsyncPacketSocket *
+    TincanSocketFactory::CreateUdpSocket(
+        const rtc::SocketAddress &local_addr,
+        uint16_t min_port,
+        uint16_t max_port)
+    {
+        auto socket = make_unique<TincanUdpSocket>(
+            static_cast<rtc::PhysicalSocketServer *>(network_thread_->socketserver()), shared_);
+        if (!socket->Bind(local_addr, min_port, max_port, opts_))
+            return nullptr;
+        return socket.release();
+    }
+
+    void
+    TincanSocketFactory::QueryInfo(
+        Json::Value &info)
+    {
+        info["Sockets"] = (Json::UInt64)shared_->sockets;
+        info["RcvBuf"] = shared_->rcv_buf;
+        info["SndBuf"] = shared_->snd_buf;
+        if (opts_.busy_poll > 0)
+            info["BusyPoll"] = opts_.busy_poll;
+        if (opts_.priority > 0)
+            info["Priority"] = opts_.priority;
+        info["RxSyscalls"] = (Json::UInt64)shared_->rx_syscalls;
+        info["RxPackets"] = (Json::UInt64)shared_->rx_packets;
+        info["RxTruncated"] = (Json::UInt64)shared_->rx_truncated;
+        info["RxOverflows"] = (Json::UInt64)shared_->rx_overflows;
+        info["TxPackets"] = (Json::UInt64)shared_->tx_packets;
+        info["TxBlocked"] = (Json::UInt64)shared_->tx_blocked;
+        info["TxErrors"] = (Json::UInt64)shared_->tx_errors;
+    }
+} // namespace tincan
@@ -0,0 +1,231 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_SOCKET_FACTORY_H_
+#define TINCAN_SOCKET_FACTORY_H_
+#include "tincan_base.h"
+#include "socket_options.h"
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "p2p/client/basic_port_allocator.h"
+#include "rtc_base/async_packet_socket.h"
+#include "rtc_base/physical_socket_server.h"
+#include "rtc_base/socket_address.h"
+#include "rtc_base/strings/json.h"
+#include <netinet/in.h>
+#include <sys/socket.h>
+namespace tincan
+{
+    /* Receive slots and counters shared by the sockets of one factory. The
+    sockets all run on one network thread and a read completes before the
+    next one starts, so one set of slots serves every socket of a link.
+    */
+    struct UdpSocketShared
+    {
+        static const size_t kRecvSlots = 16;
+        // holds the largest DTLS record with room to spare
+        static const size_t kSlotSz = 20 * 1024;
+
+        UdpSocketShared();
+        vector<char> rx_buf;
+        array<mmsghdr, kRecvSlots> rx_msgs;
+        array<iovec, kRecvSlots> rx_iovs;
+        array<sockaddr_storage, kRecvSlots> rx_addrs;
+        vector<char> rx_ctrl;
+        uint64_t sockets = 0;
+        uint64_t rx_syscalls = 0;
+        uint64_t rx_packets = 0;
+        uint64_t rx_truncated = 0;
+        // dropped by the kernel on a full receive buffer
+        uint64_t rx_overflows = 0;
+        uint64_t tx_packets = 0;
+        uint64_t tx_blocked = 0;
+        uint64_t tx_errors = 0;
+        // as the kernel reports them for the last socket created
+        int rcv_buf = 0;
+        int snd_buf = 0;
+    };
+
+    /* An ICE UDP socket served by the network thread's socket server. It
+    takes up to kRecvSlots datagrams per recvmmsg and stamps them with one
+    clock read, where AsyncUDPSocket makes a recvfrom and a timestamp ioctl
+    for every packet.
+    */
+    class TincanUdpSocket : public rtc::AsyncPacketSocket,
+                            public rtc::Dispatcher
+    {
+    public:
+        TincanUdpSocket(
+            rtc::PhysicalSocketServer *socket_server,
+            shared_ptr<UdpSocketShared> shared);
+        ~TincanUdpSocket() override;
+        TincanUdpSocket(const TincanUdpSocket &) = delete;
+        TincanUdpSocket &operator=(const TincanUdpSocket &) = delete;
+
+        // Binds to local_addr, or to the first free port of the range when
+        // one is given.
+        bool Bind(
+            const rtc::SocketAddress &local_addr,
+            uint16_t min_port,
+            uint16_t max_port,
+            const SocketOptions &opts);
+
+        // rtc::AsyncPacketSocket
+        rtc::SocketAddress GetLocalAddress() const override
+        {
+            return local_addr_;
+        }
+        rtc::SocketAddress GetRemoteAddress() const override
+        {
+            return rtc::SocketAddress();
+        }
+        int Send(
+            const void *pv,
+            size_t cb,
+            const rtc::PacketOptions &options) override;
+        int SendTo(
+            const void *pv,
+            size_t cb,
+            const rtc::SocketAddress &addr,
+            const rtc::PacketOptions &options) override;
+        int Close() override;
+        State GetState() const override
+        {
+            return fd_ < 0 ? STATE_CLOSED : STATE_BOUND;
+        }
+        int GetOption(
+            rtc::Socket::Option opt,
+            int *value) override;
+        int SetOption(
+            rtc::Socket::Option opt,
+            int value) override;
+        int GetError() const override
+        {
+            return error_;
+        }
+        void SetError(
+            int error) override
+        {
+            error_ = error;
+        }
+
+        // rtc::Dispatcher
+        uint32_t GetRequestedEvents() override
+        {
+            return rtc::DE_READ | (write_blocked_ ? rtc::DE_WRITE : 0);
+        }
+        void OnPreEvent(uint32_t) override {}
+        void OnEvent(
+            uint32_t ff,
+            int err) override;
+        int GetDescriptor() override
+        {
+            return fd_;
+        }
+        bool IsDescriptorClosed() override
+        {
+            return false;
+        }
+
+    private:
+        // recvmmsg calls per read event, the socket stays readable after
+        static const int kReadBudget = 4;
+        // what bulk traffic on the tunnel needs to ride out a busy network
+        // thread, capped by net.core.rmem_max and wmem_max
+        static const int kDefaultRcvBuf = 4 * 1024 * 1024;
+        static const int kDefaultSndBuf = 1024 * 1024;
+
+        void Tune(
+            const SocketOptions &opts);
+
+        // A configured size may exceed the system limit, a default may not.
+        void SetBufferSize(
+            int opt,
+            int force_opt,
+            int size,
+            bool force);
+
+        int TranslateOption(
+            rtc::Socket::Option opt,
+            int *level,
+            int *name);
+
+        void ReadNext();
+
+        rtc::PhysicalSocketServer *socket_server_;
+        shared_ptr<UdpSocketShared> shared_;
+        int fd_;
+        int error_;
+        bool write_blocked_;
+        rtc::SocketAddress local_addr_;
+        // the kernel's running count of drops on this socket
+        uint32_t overflows_;
+        // expires when the socket is destroyed by a packet handler
+        shared_ptr<bool> alive_;
+    };
+
+    /* Creates the UDP sockets ICE gathers on as TincanUdpSocket, tuned by
+    the tunnel's SocketOptions. TCP sockets are left to the base factory.
+    */
+    class TincanSocketFactory : public rtc::BasicPacketSocketFactory
+    {
+    public:
+        TincanSocketFactory(
+            rtc::Thread *network_thread,
+            const SocketOptions &opts);
+
+        rtc::AsyncPacketSocket *CreateUdpSocket(
+            const rtc::SocketAddress &local_addr,
+            uint16_t min_port,
+            uint16_t max_port) override;
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        rtc::Thread *network_thread_;
+        SocketOptions opts_;
+        shared_ptr<UdpSocketShared> shared_;
+    };
+
+    /* A BasicPortAllocator that owns the TincanSocketFactory its ports are
+    created with, so the factory goes wherever the allocator is handed.
+    */
+    class TincanPortAllocator : public cricket::BasicPortAllocator
+    {
+    public:
+        TincanPortAllocator(
+            rtc::NetworkManager *net_manager,
+            unique_ptr<TincanSocketFactory> socket_factory) : cricket::BasicPortAllocator(net_manager, socket_factory.get()),
+                                                              socket_factory_(move(socket_factory))
+        {
+        }
+
+        TincanSocketFactory &SocketFactory()
+        {
+            return *socket_factory_;
+        }
+
+    private:
+        unique_ptr<TincanSocketFactory> socket_factory_;
+    };
+} // namespace tincan
+#endif // TINCAN_SOCKET_FACTORY_H_
@@ -0,0 +1,117 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "token_bucket.h"
+namespace tincan
+{
+    TokenBucket::TokenBucket() : rate_bps_(0),
+                                 burst_(0),
+                                 depth_(0),
+                                 tokens_(0),
+                                 last_us_(0),
+                                 tx_bytes_(0),
+                                 tx_frames_(0),
+                                 waits_(0)
+    {
+    }
+
+    void
+    TokenBucket::Configure(
+        uint64_t rate_bps,
+        size_t burst,
+        int64_t now_us)
+    {
+        rate_bps_ = rate_bps;
+        burst_ = burst;
+        depth_ = std::max(double(burst), rate_bps / 8e6 * kMinDepthUs);
+        // a changed rate starts from a full bucket
+        tokens_ = depth_;
+        last_us_ = now_us;
+    }
+
+    void
+    TokenBucket::SetRate(
+        uint64_t rate_bps,
+        int64_t now_us)
+    {
+        if (!Limited())
+        {
+            Configure(rate_bps, burst_, now_us);
+            return;
+        }
+        // settle what accrued at the old rate
+        if (now_us > last_us_)
+        {
+            tokens_ = std::min(depth_, tokens_ + (now_us - last_us_) * (rate_bps_ / 8e6));
+            last_us_ = now_us;
+        }
+        rate_bps_ = rate_bps;
+        depth_ = std::max(double(burst_), rate_bps / 8e6 * kMinDepthUs);
+        tokens_ = std::min(tokens_, depth_);
+    }
+
+    bool
+    TokenBucket::Admit(
+        int64_t now_us)
+    {
+        if (!Limited())
+            return true;
+        if (now_us > last_us_)
+        {
+            tokens_ = std::min(depth_, tokens_ + (now_us - last_us_) * (rate_bps_ / 8e6));
+            last_us_ = now_us;
+        }
+        if (tokens_ > 0)
+            return true;
+        ++waits_;
+        return false;
+    }
+
+    void
+    TokenBucket::Consume(
+        size_t bytes)
+    {
+        tokens_ -= bytes;
+        tx_bytes_ += bytes;
+        ++tx_frames_;
+    }
+
+    int64_t TokenBucket::WaitUs() const
+    {
+        if (!Limited() || tokens_ > 0)
+            return 0;
+        return static_cast<int64_t>(-tokens_ / (rate_bps_ / 8e6)) + 1;
+    }
+
+    void
+    TokenBucket::QueryInfo(
+        Json::Value &info)
+    {
+        info["RateBps"] = (Json::UInt64)rate_bps_;
+        info["Burst"] = (Json::UInt64)burst_;
+        info["Depth"] = depth_;
+        info["Tokens"] = tokens_;
+        info["TxBytes"] = (Json::UInt64)tx_bytes_;
+        info["TxFrames"] = (Json::UInt64)tx_frames_;
+        info["Waits"] = (Json::UInt64)waits_;
+    }
+} // namespace tincan
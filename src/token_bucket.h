@@ -0,0 +1,84 @@
+/*
+ * EdgeVPNio
+ * Copyright 2023, University of Florida
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef TINCAN_TOKEN_BUCKET_H_
+#define TINCAN_TOKEN_BUCKET_H_
+#include "tincan_base.h"
+#include "rtc_base/strings/json.h"
+namespace tincan
+{
+    /* Token bucket rate limiter for the egress of a vlink. Tokens are bytes
+    that accrue at the rate up to the depth of the bucket. A frame may go
+    while the bucket holds any tokens and is charged in full, so the bucket
+    runs into debt instead of holding back a frame larger than the tokens
+    left, which keeps the long term rate exact. The depth is never less
+    than kMinDepthUs of sending, the owner's timers are not finer than
+    that. Only used on the network thread.
+    */
+    class TokenBucket
+    {
+    public:
+        TokenBucket();
+        TokenBucket(const TokenBucket &) = delete;
+        TokenBucket &operator=(const TokenBucket &) = delete;
+
+        // A rate of 0 removes the limit.
+        void Configure(
+            uint64_t rate_bps,
+            size_t burst,
+            int64_t now_us);
+
+        // Changes the rate keeping the tokens, for a pacer whose rate is
+        // updated continually.
+        void SetRate(
+            uint64_t rate_bps,
+            int64_t now_us);
+
+        bool Limited() const { return rate_bps_ > 0; }
+
+        // Returns true if a frame may be sent now.
+        bool Admit(
+            int64_t now_us);
+
+        void Consume(
+            size_t bytes);
+
+        // us until Admit will succeed again
+        int64_t WaitUs() const;
+
+        void QueryInfo(
+            Json::Value &info);
+
+    private:
+        static const int64_t kMinDepthUs = 5000;
+
+        uint64_t rate_bps_;
+        size_t burst_;
+        double depth_;
+        double tokens_;
+        int64_t last_us_;
+        uint64_t tx_bytes_;
+        uint64_t tx_frames_;
+        uint64_t waits_;
+    };
+} // namespace tincan
+#endif // TINCAN_TOKEN_BUCKET_H_
@@ -23,13 +23,20 @@
 #ifndef TINCAN_TUNNEL_DESCRIPTOR_H_
 #define TINCAN_TUNNEL_DESCRIPTOR_H_
 #include "tincan_base.h"
+#include "socket_options.h"
 #include "turn_descriptor.h"
 namespace tincan
 {
     struct TunnelDesc
     {
         TunnelDesc(const Json::Value &desc) : uid{desc[TincanControl::TunnelId].asString()},
-                                              node_id{desc[TincanControl::NodeId].asString()}
+                                              node_id{desc[TincanControl::NodeId].asString()},
+                                              pre_gather{desc["PreGather"].asBool()},
+                                              key_type{desc["KeyType"].asString()},
+                                              link_resume_window{desc["LinkResumeWindow"].asUInt()},
+                                              mss_clamp{desc["MssClamp"].asBool()},
+                                              mss_clamp_mtu{desc["MssClampMtu"].asUInt()},
+                                              socket_options{desc["SocketOptions"]}
         {
 
             Json::Value stuns = desc["StunServers"];
@@ -47,11 +54,29 @@ namespace tincan
                     turns[i]["Password"].asString());
                 turn_descs.push_back(turn_desc);
             }
+
+            Json::Value ignored = desc[TincanControl::IgnoredNetInterfaces];
+            for (Json::Value::ArrayIndex i = 0; i < ignored.size(); ++i)
+            {
+                ignored_net_interfaces.push_back(ignored[i].asString());
+            }
         }
         const string uid;
         const string node_id;
+        // gather candidates when the tunnel is created, ahead of CreateLink
+        const bool pre_gather;
+        // "ECDSA" for a P-256 identity, otherwise RSA
+        const string key_type;
+        // seconds a removed link is kept for a quick reconnect, 0 disables
+        const uint32_t link_resume_window;
+        // rewrite the MSS of TCP SYNs to fit the tunnel
+        const bool mss_clamp;
+        // IP MTU the MSS is derived from, 0 uses the TAP MTU
+        const uint32_t mss_clamp_mtu;
+        const SocketOptions socket_options;
         vector<string> stun_servers;
         vector<TurnDescriptor> turn_descs;
+        vector<string> ignored_net_interfaces;
     };
 } // namespace tincan
 #endif // TINCAN_TUNNEL_DESCRIPTOR_H_
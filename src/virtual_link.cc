@@ -23,9 +23,13 @@
 #include "tincan_exception.h"
 #include "turn_descriptor.h"
 #include "virtual_link.h"
+#include "frame_parser.h"
 #include "rtc_base/string_encode.h"
 #include "p2p/base/default_ice_transport_factory.h"
 #include "rtc_base/bind.h"
+#include "rtc_base/helpers.h"
+#include "rtc_base/socket.h"
+#include "rtc_base/time_utils.h"
 namespace tincan
 {
     extern BufferPool<Iob> bp;
@@ -34,19 +38,116 @@ namespace tincan
         unique_ptr<VlinkDescriptor> vlink_desc,
         unique_ptr<PeerDescriptor> peer_desc,
         rtc::Thread *signaling_thread,
-        rtc::Thread *network_thread) : vlink_desc_(move(vlink_desc)),
+        rtc::Thread *network_thread,
+        shared_ptr<NetworkResources> net_resources) : vlink_desc_(move(vlink_desc)),
                                        peer_desc_(move(peer_desc)),
                                        local_conn_role_(cricket::CONNECTIONROLE_ACTPASS),
                                        dtls_transport_(nullptr),
                                        packet_options_(DSCP_DEFAULT),
                                        signaling_thread_(signaling_thread),
                                        network_thread_(network_thread),
-                                       pa_init_(false)
+                                       cas_ready_id_(0),
+                                       gather_timed_out_(false),
+                                       gather_gen_(0),
+                                       cas_answered_(false),
+                                       pre_gathered_(false),
+                                       resumed_(false),
+                                       resume_count_(0),
+                                       local_ufrag_(kIceUfrag),
+                                       local_pwd_(kIcePwd),
+                                       remote_ufrag_(kIceUfrag),
+                                       remote_pwd_(kIcePwd),
+                                       ice_restarts_(0),
+                                       restart_pending_(false),
+                                       restart_switch_pending_(false),
+                                       restart_time_(0),
+                                       network_changes_(0),
+                                       handovers_(0),
+                                       handover_pending_(false),
+                                       handover_timer_id_(0),
+                                       handover_gap_(0),
+                                       failovers_(0),
+                                       failover_time_(0),
+                                       unwritable_time_(0),
+                                       cas_ready_time_(0),
+                                       gather_time_(0),
+                                       connect_time_(0),
+                                       pa_init_(false),
+                                       net_resources_(net_resources),
+                                       mp_channel_(nullptr),
+                                       reorder_flush_pending_(false),
+                                       tx_seq_(0),
+                                       rx_malformed_(0),
+                                       batch_len_(0),
+                                       batch_frames_(0),
+                                       tx_batches_(0),
+                                       tx_batched_frames_(0),
+                                       pmtu_timer_id_(0),
+                                       tx_frag_id_(0),
+                                       tx_fragmented_(0),
+                                       tx_fragments_(0),
+                                       fec_timer_id_(0),
+                                       fec_adapt_pending_(false),
+                                       path_loss_(0),
+                                       pings_sent_(0),
+                                       pings_answered_(0),
+                                       rx_injected_drops_(0),
+                                       egress_queued_(false),
+                                       drain_pending_(false),
+                                       tx_blocked_(false),
+                                       tx_blocked_count_(0),
+                                       batch_dscp_(0),
+                                       tx_dscp_(0),
+                                       dscp_changes_(0),
+                                       ping_pending_(false),
+                                       rx_bytes_(0),
+                                       native_tx_(false),
+                                       native_probe_id_(0),
+                                       native_ack_ms_(0),
+                                       native_timer_id_(0),
+                                       native_flush_pending_(false),
+                                       native_fallbacks_(0),
+                                       peer_caps_known_(false),
+                                       peer_caps_(0),
+                                       caps_timer_id_(0)
     {
+        // tx_record_ is sized for one full Iob frame
+        batch_limit_ = Iob::kFrameBufferSz;
+        if (vlink_desc_->options.batch_limit > 0)
+            batch_limit_ = std::min(vlink_desc_->options.batch_limit, batch_limit_);
+        if (vlink_desc_->options.Encoded())
+            codec_ = MakeCodec();
+        if (vlink_desc_->options.path_mtu_discovery)
+        {
+            // no record is ever larger than a full batch
+            pmtu_ = make_unique<PathMtuProber>(
+                kBasePlpmtu, LinkRecord::kMaxHeaderSz + LinkRecord::kLenSz + LinkRecord::kEncodingSz + batch_limit_);
+        }
+        if (vlink_desc_->options.fec)
+        {
+            const size_t k = vlink_desc_->options.fec_k ? vlink_desc_->options.fec_k : kDefaultFecK;
+            fec_tx_ = make_unique<FecEncoder>(k, vlink_desc_->options.fec_m);
+            fec_tx_->SignalSend.connect(this, &VirtualLink::TransportSend);
+        }
+        if (vlink_desc_->options.Queued())
+            CreateEgressQueue();
+        if (vlink_desc_->options.congestion_control)
+            cc_ = make_unique<BbrController>();
+        if (vlink_desc_->options.rate > 0)
+            shaper_.Configure(vlink_desc_->options.rate, vlink_desc_->options.burst, rtc::TimeMicros());
         content_name_.append(vlink_desc_->uid.substr(0, 7));
         local_description_ = make_unique<cricket::SessionDescription>();
         remote_description_ = make_unique<cricket::SessionDescription>();
-        ice_transport_factory_ = make_unique<webrtc::DefaultIceTransportFactory>();
+        if (vlink_desc_->options.multipath)
+        {
+            ice_transport_factory_ = make_unique<MultipathIceTransportFactory>();
+            reorder_ = make_unique<ReorderBuffer>(kReorderWindow, kReorderTimeout);
+            reorder_->SignalRecordReady.connect(this, &VirtualLink::OnRecordReady);
+        }
+        else
+        {
+            ice_transport_factory_ = make_unique<webrtc::DefaultIceTransportFactory>();
+        }
         config_.transport_observer = this;
         config_.rtcp_handler = [](const rtc::CopyOnWriteBuffer &packet,
                                   int64_t packet_time_us)
@@ -64,15 +165,23 @@ namespace tincan
         unique_ptr<SSLIdentity> sslid,
         unique_ptr<SSLFingerprint> local_fingerprint,
         cricket::IceRole ice_role,
-        const vector<string> &ignored_list)
+        const vector<string> &ignored_list,
+        unique_ptr<cricket::PortAllocator> port_allocator)
     {
         ice_role_ = ice_role;
-        net_manager_.set_network_ignore_list(ignored_list);
-        port_allocator_.reset(new cricket::BasicPortAllocator(&net_manager_));
-        port_allocator_->SetConfiguration(
-            SetupSTUN(vlink_desc_->stun_servers),
-            SetupTURN(vlink_desc_->turn_descs),
-            0, webrtc::PRUNE_BASED_ON_PRIORITY);
+        net_manager_ = net_resources_->NetworkManager(network_thread_, ignored_list);
+        if (port_allocator)
+        {
+            // already initialized and holding a pooled session of pre-gathered candidates
+            port_allocator_ = move(port_allocator);
+            pa_init_ = true;
+            pre_gathered_ = true;
+        }
+        else
+        {
+            port_allocator_ = CreatePortAllocator(
+                *net_resources_, network_thread_, net_manager_.get(), *vlink_desc_, 0);
+        }
         transport_ctlr_ = make_unique<JsepTransportController>(
             signaling_thread_,
             network_thread_,
@@ -81,14 +190,21 @@ namespace tincan
             config_);
         SetupICE(move(sslid), move(local_fingerprint), ice_role);
         dtls_transport_ = transport_ctlr_->GetDtlsTransport(content_name_);
+        if (vlink_desc_->options.multipath)
+            mp_channel_ = static_cast<MultipathTransportChannel *>(dtls_transport_->ice_transport());
+        // probes must be dropped rather than fragmented by the underlay
+        if (pmtu_)
+            dtls_transport_->SetOption(rtc::Socket::OPT_DONTFRAGMENT, 1);
         RegisterLinkEventHandlers();
         return;
     }
 
     /* Parses the string delimited list of candidates and adds
-    them to the P2P transport thereby creating ICE connections
+    them to the P2P transport thereby creating ICE connections.
+    Candidates that were already added are skipped so the peer
+    may deliver its CAS incrementally.
     */
-    void
+    size_t
     VirtualLink::AddRemoteCandidates(
         const string &candidates)
     {
@@ -114,13 +230,22 @@ namespace tincan
                     fields[7],               // type
                     atoi(fields[8].c_str()), // generation
                     fields[9]);              // foundation
-                cas_vec.push_back(candidate);
+                auto dup = std::find_if(remote_candidates_.begin(), remote_candidates_.end(),
+                                        [&candidate](const cricket::Candidate &rc)
+                                        { return rc.IsEquivalent(candidate); });
+                if (dup == remote_candidates_.end())
+                {
+                    remote_candidates_.push_back(candidate);
+                    cas_vec.push_back(candidate);
+                }
             }
         } while (iss);
+        if (cas_vec.empty())
+            return 0;
         webrtc::RTCError err = transport_ctlr_->AddRemoteCandidates(content_name_, cas_vec);
         if (!err.ok())
             RTC_LOG(LS_ERROR) << string("Failed to add remote candidates - ") + err.message();
-        return;
+        return cas_vec.size();
     }
 
     void
@@ -131,7 +256,500 @@ namespace tincan
         const int64_t &,
         int)
     {
-        SignalMessageReceived(data, len);
+        if (!vlink_desc_->options.Framed())
+        {
+            SignalMessageReceived(data, len);
+            return;
+        }
+        ReceiveRecord(data, len);
+    }
+
+    void
+    VirtualLink::ReceiveRecord(
+        const char *data,
+        size_t len)
+    {
+        const double inject_loss = vlink_desc_->options.inject_loss;
+        if (inject_loss > 0 && rtc::CreateRandomDouble() * 100 < inject_loss)
+        {
+            ++rx_injected_drops_;
+            return;
+        }
+        if (len > 0 && !(data[0] & LinkRecord::kControl))
+            rx_bytes_ += static_cast<uint32_t>(len);
+        ProcessRecord(data, len);
+    }
+
+    void
+    VirtualLink::ProcessRecord(
+        const char *data,
+        size_t len)
+    {
+        uint8_t flags = 0;
+        uint32_t seq = 0;
+        size_t hdr_len = LinkRecord::ReadHeader(data, len, flags, seq);
+        if (hdr_len == 0)
+        {
+            ++rx_malformed_;
+            return;
+        }
+        if (flags & LinkRecord::kFec)
+        {
+            // the peer may protect its records even if this side does not
+            if (!fec_rx_)
+            {
+                fec_rx_ = make_unique<FecDecoder>();
+                fec_rx_->SignalRecovered.connect(this, &VirtualLink::ProcessRecord);
+            }
+            const char *record = nullptr;
+            size_t record_len = 0;
+            if (fec_rx_->Push(data + hdr_len, len - hdr_len, record, record_len))
+                ProcessRecord(record, record_len);
+            return;
+        }
+        if (flags & LinkRecord::kControl)
+        {
+            OnControlRecord(data + hdr_len, len - hdr_len);
+            return;
+        }
+        if ((flags & LinkRecord::kSequenced) && reorder_)
+        {
+            reorder_->Push(seq, flags, data + hdr_len, len - hdr_len, rtc::TimeMillis());
+            ScheduleReorderFlush();
+            return;
+        }
+        OnRecordReady(flags, data + hdr_len, len - hdr_len);
+    }
+
+    void
+    VirtualLink::OnRecordReady(
+        uint8_t flags,
+        const char *data,
+        size_t len)
+    {
+        if (flags & LinkRecord::kFragment)
+        {
+            if (!fragments_)
+                fragments_ = make_unique<FragmentBuffer>(kReassemblySlots, kReassemblyTimeout, tx_record_.size());
+            if (!fragments_->Push(data, len, rtc::TimeMillis(), data, len))
+                return;
+            flags &= ~LinkRecord::kFragment;
+        }
+        if (!(flags & LinkRecord::kBatch))
+        {
+            DeliverFrame(flags, data, len);
+            return;
+        }
+        size_t pos = 0;
+        while (pos + LinkRecord::kLenSz <= len)
+        {
+            const size_t frame_len = LinkRecord::ReadLength(data + pos);
+            pos += LinkRecord::kLenSz;
+            if (frame_len == 0 || pos + frame_len > len)
+            {
+                ++rx_malformed_;
+                return;
+            }
+            DeliverFrame(flags, data + pos, frame_len);
+            pos += frame_len;
+        }
+    }
+
+    void
+    VirtualLink::DeliverFrame(
+        uint8_t flags,
+        const char *data,
+        size_t len)
+    {
+        if (!(flags & LinkRecord::kEncoded))
+        {
+            SignalMessageReceived(data, len);
+            return;
+        }
+        if (len > 0 && data[0] == HeaderCompressor::kNone)
+        {
+            SignalMessageReceived(data + 1, len - 1);
+            return;
+        }
+        // the peer may encode even if this side does not
+        if (!codec_)
+            codec_ = MakeCodec();
+        size_t frame_len = codec_->Decode(data, len, rx_frame_.data(), rx_frame_.size());
+        SendContextRequests();
+        if (frame_len == 0)
+        {
+            ++rx_malformed_;
+            return;
+        }
+        SignalMessageReceived(rx_frame_.data(), frame_len);
+    }
+
+    void VirtualLink::SendContextRequests()
+    {
+        uint16_t request = 0;
+        while (codec_->TakeContextRequest(request))
+        {
+            array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> msg;
+            size_t pos = LinkRecord::WriteHeader(msg.data(), LinkRecord::kControl, 0);
+            pos += LinkRecord::WriteControl(msg.data() + pos, LinkRecord::kContextRequest, request, 0);
+            SendRecord(msg.data(), pos);
+        }
+    }
+
+    unique_ptr<FrameCodec>
+    VirtualLink::MakeCodec()
+    {
+        const LinkOptions &options = vlink_desc_->options;
+        MacAddressType peer_mac{};
+        const bool elide_macs =
+            vlink_desc_->local_mac != MacAddressType{} &&
+            StringToByteArray(peer_desc_->mac_address, peer_mac.begin(), peer_mac.end());
+        // headers are compressed once the peer advertises it decodes them
+        const bool header_compression = options.header_compression &&
+                                        (peer_caps_ & LinkRecord::kCapHeaderCompression);
+        return make_unique<FrameCodec>(header_compression, options.compression,
+                                       elide_macs, vlink_desc_->local_mac, peer_mac);
+    }
+
+    void
+    VirtualLink::OnControlRecord(
+        const char *data,
+        size_t len)
+    {
+        uint8_t type = 0;
+        uint16_t id = 0;
+        size_t size = 0;
+        if (!LinkRecord::ReadControl(data, len, type, id, size))
+        {
+            ++rx_malformed_;
+            return;
+        }
+        if (type == LinkRecord::kProbe)
+        {
+            // only a probe that arrived whole is acknowledged
+            if (LinkRecord::HeaderSize(LinkRecord::kControl) + len != size)
+                return;
+            array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> ack;
+            size_t pos = LinkRecord::WriteHeader(ack.data(), LinkRecord::kControl, 0);
+            pos += LinkRecord::WriteControl(ack.data() + pos, LinkRecord::kProbeAck, id, size);
+            SendRecord(ack.data(), pos);
+        }
+        else if (type == LinkRecord::kProbeAck && pmtu_)
+        {
+            pmtu_->OnProbeAcked(id, size);
+            ProbePathMtu();
+        }
+        else if (type == LinkRecord::kPing)
+        {
+            array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz + LinkRecord::kFeedbackSz> feedback;
+            size_t pos = LinkRecord::WriteHeader(feedback.data(), LinkRecord::kControl, 0);
+            pos += LinkRecord::WriteControl(feedback.data() + pos, LinkRecord::kFeedback, id, 0);
+            pos += LinkRecord::WriteFeedback(feedback.data() + pos, rx_bytes_,
+                                             static_cast<uint32_t>(rtc::TimeMicros()));
+            SendRecord(feedback.data(), pos);
+        }
+        else if (type == LinkRecord::kFeedback && cc_)
+        {
+            uint32_t rx_bytes = 0, rx_time_us = 0;
+            if (!LinkRecord::ReadFeedback(data + LinkRecord::kControlSz, len - LinkRecord::kControlSz,
+                                          rx_bytes, rx_time_us))
+            {
+                ++rx_malformed_;
+                return;
+            }
+            const int64_t now = rtc::TimeMicros();
+            cc_->OnFeedback(id, rx_bytes, rx_time_us, now);
+            pacer_.SetRate(cc_->PacingRate(), now);
+            // the window may have opened
+            if (egress_queue_->Length() > 0)
+                ScheduleEgressDrain(0);
+        }
+        else if (type == LinkRecord::kNativeOffer)
+            OnNativeOffer(id);
+        else if (type == LinkRecord::kNativeWithdraw && native_ && native_->Peer().port() == id)
+        {
+            // a later offer from the peer opens the path again
+            RTC_LOG(LS_INFO) << "vlink " << content_name_ << " native path withdrawn by the peer";
+            CloseNative();
+        }
+        else if (type == LinkRecord::kNativeProbe && native_ && native_->Connected())
+        {
+            // answered on the native path, the ack proves both directions
+            array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> ack;
+            size_t pos = LinkRecord::WriteHeader(ack.data(), LinkRecord::kControl, 0);
+            pos += LinkRecord::WriteControl(ack.data() + pos, LinkRecord::kNativeProbeAck, id, 0);
+            native_->Send(ack.data(), pos);
+            native_->Flush();
+        }
+        else if (type == LinkRecord::kNativeProbeAck && native_)
+        {
+            native_ack_ms_ = rtc::TimeMillis();
+            if (!native_tx_)
+            {
+                native_tx_ = true;
+                RTC_LOG(LS_INFO) << "vlink " << content_name_ << " switched to the native path to "
+                                 << native_->Peer().ToString();
+            }
+        }
+        else if (type == LinkRecord::kCapabilities)
+            OnCapabilities(id, size != 0);
+        else if (type == LinkRecord::kContextRequest && codec_)
+            codec_->OnContextRequest(id);
+    }
+
+    /* Sent once the link is writable and resent until the peer's
+    capabilities arrive. A peer that does not know the message ignores it
+    and headers are never compressed towards it.
+    */
+    void VirtualLink::SendCapabilities()
+    {
+        array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> caps;
+        size_t pos = LinkRecord::WriteHeader(caps.data(), LinkRecord::kControl, 0);
+        // any peer encoding is decoded, whatever the local options
+        pos += LinkRecord::WriteControl(caps.data() + pos, LinkRecord::kCapabilities,
+                                        LinkRecord::kCapHeaderCompression, peer_caps_known_ ? 1 : 0);
+        SendRecord(caps.data(), pos);
+        if (peer_caps_known_)
+            return;
+        const uint32_t timer_id = ++caps_timer_id_;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink, timer_id]()
+            {
+                auto vlink = wk_vlink.lock();
+                if (vlink && vlink->caps_timer_id_ == timer_id && !vlink->peer_caps_known_)
+                    vlink->SendCapabilities(); },
+            kCapsInterval);
+    }
+
+    void
+    VirtualLink::OnCapabilities(
+        uint16_t caps,
+        bool has_ours)
+    {
+        const bool first = !peer_caps_known_;
+        peer_caps_known_ = true;
+        peer_caps_ = caps;
+        // a lost answer is asked for again by the peer's resend
+        if (!has_ours)
+            SendCapabilities();
+        if (!first)
+            return;
+        ++caps_timer_id_;
+        if (codec_ && vlink_desc_->options.header_compression &&
+            (caps & LinkRecord::kCapHeaderCompression))
+        {
+            codec_->EnableHeaderCompression();
+            RTC_LOG(LS_INFO) << "vlink " << content_name_ << " compresses headers";
+        }
+    }
+
+    void VirtualLink::RestartPathMtuSearch()
+    {
+        if (!pmtu_)
+            return;
+        pmtu_->Reset();
+        ProbePathMtu();
+    }
+
+    void VirtualLink::ProbePathMtu()
+    {
+        // the largest IP packet that still fits a record of its own, with
+        // room for the parity overhead when FEC is on and the length
+        // prefix every framed frame carries
+        if (vlink_desc_->mss_clamper)
+            vlink_desc_->mss_clamper->SetPathMtu(
+                BatchLimit() - LinkRecord::kLenSz - LinkRecord::kEncodingSz - kEthernetHeaderSz);
+        if (!IsReady())
+            return;
+        const int64_t now = rtc::TimeMillis();
+        uint16_t id = 0;
+        const size_t size = pmtu_->Poll(now, id);
+        if (size > 0)
+        {
+            probe_.assign(size, 0);
+            const size_t pos = LinkRecord::WriteHeader(probe_.data(), LinkRecord::kControl, 0);
+            LinkRecord::WriteControl(probe_.data() + pos, LinkRecord::kProbe, id, size);
+            // an oversized probe is expected to fail, it is not logged
+            dtls_transport_->SendPacket(probe_.data(), probe_.size(), packet_options_, 0);
+        }
+        // only the latest scheduled poll runs
+        const uint32_t timer_id = ++pmtu_timer_id_;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink, timer_id]()
+            {
+                auto vlink = wk_vlink.lock();
+                if (vlink && vlink->pmtu_timer_id_ == timer_id)
+                    vlink->ProbePathMtu(); },
+            pmtu_->NextPollMs(now));
+    }
+
+    void VirtualLink::ScheduleReorderFlush()
+    {
+        if (reorder_flush_pending_ || reorder_->Held() == 0)
+            return;
+        reorder_flush_pending_ = true;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink]()
+            {
+                if (auto vlink = wk_vlink.lock())
+                {
+                    vlink->reorder_flush_pending_ = false;
+                    vlink->reorder_->Flush(rtc::TimeMillis());
+                    vlink->ScheduleReorderFlush();
+                } },
+            reorder_->TimeoutMs());
+    }
+
+    void VirtualLink::ScheduleFecFlush()
+    {
+        // a group is timed from its first record
+        if (fec_tx_->Pending() != 1)
+            return;
+        const uint16_t group = fec_tx_->Group();
+        const uint32_t timer_id = ++fec_timer_id_;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink, timer_id, group]()
+            {
+                auto vlink = wk_vlink.lock();
+                if (vlink && vlink->fec_timer_id_ == timer_id &&
+                    vlink->fec_tx_->Group() == group && vlink->fec_tx_->Pending() > 0)
+                    vlink->fec_tx_->CloseGroup(); },
+            kFecFlushDelay);
+    }
+
+    /* Sizes the parity from the loss of the ICE connectivity checks on the
+    selected pair. They keep flowing at a steady rate whether or not the
+    link carries data, so no feedback from the peer is needed.
+    */
+    void VirtualLink::AdaptFec()
+    {
+        cricket::TransportStats stats;
+        if (transport_ctlr_->GetStats(content_name_, &stats) && !stats.channel_stats.empty())
+        {
+            const cricket::TransportChannelStats &ch_stats = stats.channel_stats.front();
+            for (const auto &conn : ch_stats.ice_transport_stats.connection_infos)
+            {
+                if (!conn.best_connection)
+                    continue;
+                // counters start over when another pair is selected
+                if (conn.sent_ping_requests_total < pings_sent_ ||
+                    conn.recv_ping_responses < pings_answered_)
+                {
+                    pings_sent_ = conn.sent_ping_requests_total;
+                    pings_answered_ = conn.recv_ping_responses;
+                }
+                const uint64_t sent = conn.sent_ping_requests_total - pings_sent_;
+                if (sent < kFecMinPings)
+                    break;
+                const uint64_t answered = std::min<uint64_t>(sent, conn.recv_ping_responses - pings_answered_);
+                path_loss_ = 0.7 * path_loss_ + 0.3 * (double(sent - answered) / sent);
+                pings_sent_ = conn.sent_ping_requests_total;
+                pings_answered_ = conn.recv_ping_responses;
+                break;
+            }
+        }
+        const size_t k = vlink_desc_->options.fec_k ? vlink_desc_->options.fec_k : kDefaultFecK;
+        const size_t redundancy = FecEncoder::RedundancyForLoss(path_loss_, k);
+        if (redundancy == 0 && fec_tx_->Pending() > 0)
+            fec_tx_->CloseGroup();
+        fec_tx_->SetRedundancy(redundancy);
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink]()
+            {
+                if (auto vlink = wk_vlink.lock())
+                    vlink->AdaptFec(); },
+            kFecAdaptInterval);
+    }
+
+    void
+    VirtualLink::GetDatapathInfo(
+        Json::Value &dp_info)
+    {
+        const LinkOptions &options = vlink_desc_->options;
+        dp_info["Multipath"] = options.multipath;
+        dp_info["Batching"] = options.batching;
+        dp_info["Compression"] = options.compression;
+        dp_info["HeaderCompression"] = options.header_compression;
+        dp_info["PathMtuDiscovery"] = options.path_mtu_discovery;
+        dp_info["Fec"] = options.fec;
+        dp_info["FqCodel"] = options.fq_codel;
+        dp_info["PriorityQueuing"] = options.priority_queuing;
+        dp_info["AckPriority"] = options.ack_priority;
+        dp_info["AckFilter"] = options.ack_filter;
+        if (options.outer_dscp != LinkOptions::kOuterDscpDefault)
+        {
+            dp_info["OuterDscp"] = options.outer_dscp == LinkOptions::kOuterDscpCopy ? "Copy" : "Class";
+            dp_info["DscpChanges"] = (Json::UInt64)dscp_changes_;
+        }
+        dp_info["TxBlocked"] = (Json::UInt64)tx_blocked_count_;
+        if (egress_queue_)
+            egress_queue_->QueryInfo(dp_info["EgressQueue"]);
+        if (shaper_.Limited())
+            shaper_.QueryInfo(dp_info["Shaper"]);
+        static_cast<TincanPortAllocator *>(port_allocator_.get())->SocketFactory().QueryInfo(dp_info["Sockets"]);
+        if (!options.Framed())
+            return;
+        dp_info["TxRecords"] = (Json::UInt64)tx_seq_;
+        dp_info["MalformedRecords"] = (Json::UInt64)rx_malformed_;
+        if (options.batching)
+        {
+            Json::Value &batch_info = dp_info["Batches"];
+            batch_info["Limit"] = (Json::UInt64)batch_limit_;
+            batch_info["TxBatches"] = (Json::UInt64)tx_batches_;
+            batch_info["TxBatchedFrames"] = (Json::UInt64)tx_batched_frames_;
+            batch_info["FramesPerBatch"] = tx_batches_ ? double(tx_batched_frames_) / tx_batches_ : 0.0;
+        }
+        if (codec_)
+            codec_->QueryInfo(dp_info);
+        if (pmtu_)
+            pmtu_->QueryInfo(dp_info["PathMtu"]);
+        if (pmtu_ || fragments_)
+        {
+            Json::Value &frag_info = dp_info["Fragments"];
+            frag_info["TxFragmented"] = (Json::UInt64)tx_fragmented_;
+            frag_info["TxFragments"] = (Json::UInt64)tx_fragments_;
+            if (fragments_)
+                fragments_->QueryInfo(frag_info);
+        }
+        if (cc_)
+        {
+            Json::Value &cc_info = dp_info["CongestionControl"];
+            cc_->QueryInfo(cc_info);
+            if (pacer_.Limited())
+                pacer_.QueryInfo(cc_info["Pacer"]);
+        }
+        if (native_crypto_)
+        {
+            Json::Value &native_info = dp_info["Native"];
+            native_info["Active"] = native_tx_;
+            native_info["Fallbacks"] = (Json::UInt64)native_fallbacks_;
+            if (native_)
+                native_->QueryInfo(native_info);
+        }
+        if (fec_tx_ || fec_rx_)
+        {
+            Json::Value &fec_info = dp_info["FecCodec"];
+            if (fec_tx_)
+            {
+                fec_tx_->QueryInfo(fec_info);
+                fec_info["PathLoss"] = path_loss_;
+            }
+            if (fec_rx_)
+                fec_rx_->QueryInfo(fec_info);
+        }
+        if (options.inject_loss > 0)
+            dp_info["InjectedDrops"] = (Json::UInt64)rx_injected_drops_;
+        if (mp_channel_)
+        {
+            Json::Value &mp_info = dp_info["Paths"];
+            mp_channel_->QueryInfo(mp_info);
+            reorder_->QueryInfo(mp_info["Reorder"]);
+        }
     }
 
     void
@@ -148,6 +766,21 @@ namespace tincan
     {
         local_candidates_.insert(local_candidates_.end(), candidates.begin(),
                                  candidates.end());
+        // once CreateLink has been answered, by the deadline or by continual
+        // gathering finding a new network, late candidates are pushed to the
+        // controller even when trickle is off
+        if (!vlink_desc_->trickle && !cas_answered_)
+            return;
+        // the first batch completes the pending CreateLink, later batches
+        // are pushed to the controller as they arrive
+        if (cas_ready_id_)
+        {
+            CompleteCasReady();
+        }
+        else
+        {
+            SignalLocalCasUpdated(vlink_desc_->uid, CandidatesToString(candidates), false);
+        }
         return;
     }
 
@@ -155,10 +788,16 @@ namespace tincan
         cricket::IceGatheringState gather_state)
     {
         // gather_state_ = gather_state;
+        if (gather_state == cricket::kIceGatheringComplete && ice_restarts_ == 0)
+            gather_time_ = std::chrono::duration_cast<milliseconds>(steady_clock::now() - setup_start_);
         if (cas_ready_id_ && gather_state == cricket::kIceGatheringComplete)
         {
-            SignalLocalCasReady(cas_ready_id_, Candidates());
-            cas_ready_id_ = 0;
+            CompleteCasReady();
+        }
+        else if ((vlink_desc_->trickle || cas_answered_) &&
+                 gather_state == cricket::kIceGatheringComplete)
+        {
+            SignalLocalCasUpdated(vlink_desc_->uid, string(), true);
         }
         return;
     }
@@ -168,12 +807,34 @@ namespace tincan
     {
         if (transport->writable())
         {
+            if (connect_time_.count() == 0)
+                connect_time_ = std::chrono::duration_cast<milliseconds>(steady_clock::now() - setup_start_);
+            unwritable_time_ = 0;
             RTC_LOG(LS_INFO) << "Connection established to: " << peer_desc_->uid;
+            RestartPathMtuSearch();
+            if (tx_blocked_)
+            {
+                tx_blocked_ = false;
+                if (egress_queue_)
+                    ScheduleEgressDrain(0);
+            }
+            if (fec_tx_ && vlink_desc_->options.fec_m == 0 && !fec_adapt_pending_)
+            {
+                fec_adapt_pending_ = true;
+                AdaptFec();
+            }
+            if (vlink_desc_->options.Framed() && !peer_caps_known_)
+                SendCapabilities();
+            StartNative();
             SignalLinkUp(vlink_desc_->uid);
         }
         else
         {
             RTC_LOG(LS_INFO) << "Link NOT writeable: " << peer_desc_->uid;
+            if (unwritable_time_ == 0)
+                unwritable_time_ = rtc::TimeMillis();
+            // without ICE consent the native path may not be used either
+            StopNative();
             SignalLinkDown(vlink_desc_->uid);
         }
     }
@@ -184,6 +845,9 @@ namespace tincan
         dtls_transport_->SignalReadPacket.connect(this, &VirtualLink::OnReadPacket);
         dtls_transport_->SignalSentPacket.connect(this, &VirtualLink::OnSentPacket);
         dtls_transport_->SignalWritableState.connect(this, &VirtualLink::OnWriteableState);
+        dtls_transport_->SignalReadyToSend.connect(this, &VirtualLink::OnReadyToSend);
+        dtls_transport_->ice_transport()->SignalCandidatePairChanged.connect(
+            this, &VirtualLink::OnCandidatePairChanged);
 
         transport_ctlr_->SignalIceCandidatesGathered.connect(
             this, &VirtualLink::OnCandidatesGathered);
@@ -193,16 +857,525 @@ namespace tincan
 
     void VirtualLink::Transmit(Iob&& frame)
     {
-        int status = dtls_transport_->SendPacket(frame.data(), frame.size(), packet_options_, 0);
+        if (vlink_desc_->options.outer_dscp != LinkOptions::kOuterDscpDefault)
+        {
+            // a record carries a single marking
+            const uint8_t dscp = OuterDscp(frame);
+            if (batch_frames_ > 0 && dscp != batch_dscp_)
+                FlushBatch();
+            batch_dscp_ = dscp;
+        }
+        if (!vlink_desc_->options.Framed())
+        {
+            SetOuterDscp(batch_dscp_);
+            SendRecord(frame.data(), frame.size());
+            bp.put(std::move(frame));
+            return;
+        }
+        const bool encode = vlink_desc_->options.Encoded();
+        const size_t limit = BatchLimit();
+        const size_t need = LinkRecord::kLenSz + frame.size() + (encode ? LinkRecord::kEncodingSz : 0);
+        if (batch_frames_ > 0 && batch_len_ + need > limit)
+            FlushBatch();
+        char *pos = tx_record_.data() + kRecordHeadroom + batch_len_;
+        size_t frame_len = frame.size();
+        if (encode)
+        {
+            // a header definition may use whatever the batch has left
+            const size_t cap = std::max(frame.size() + LinkRecord::kEncodingSz,
+                                        limit - std::min(limit, batch_len_ + LinkRecord::kLenSz));
+            frame_len = codec_->Encode(frame.data(), frame.size(), pos + LinkRecord::kLenSz, cap);
+        }
+        else
+            memcpy(pos + LinkRecord::kLenSz, frame.data(), frame_len);
+        LinkRecord::WriteLength(pos, frame_len);
+        batch_len_ += LinkRecord::kLenSz + frame_len;
+        ++batch_frames_;
         bp.put(std::move(frame));
-        if (status < 0)
-            RTC_LOG(LS_INFO) << "Vlink send failed. ERRNO: " << dtls_transport_->GetError();
+        if (!vlink_desc_->options.batching || batch_len_ >= limit)
+            FlushBatch();
+    }
+
+    void VirtualLink::Enqueue(Iob&& frame)
+    {
+        egress_queue_->Enqueue(std::move(frame), rtc::TimeMicros());
+        ScheduleEgressDrain(0);
+    }
+
+    /* A shaped link always queues, so a rate limit builds its queue where
+    FQ-CoDel keeps it short and fair. The queue is only ever added, frames
+    already posted to Transmit are sent ahead of it.
+    */
+    void VirtualLink::CreateEgressQueue()
+    {
+        const LinkOptions &options = vlink_desc_->options;
+        FqCodelQueue::Params params;
+        if (options.fq_codel_limit > 0)
+            params.limit = options.fq_codel_limit;
+        if (options.codel_target > 0)
+            params.target_us = options.codel_target * 1000;
+        if (options.codel_interval > 0)
+            params.interval_us = options.codel_interval * 1000;
+        params.ecn = options.ecn;
+        params.diffserv = options.priority_queuing;
+        params.ack_priority = options.ack_priority;
+        params.ack_filter = options.ack_filter;
+        egress_queue_ = make_unique<FqCodelQueue>(params);
+        drained_.reserve(1);
+        egress_queued_ = true;
+    }
+
+    void
+    VirtualLink::SetRate(
+        uint64_t rate,
+        size_t burst)
+    {
+        if (!egress_queue_ && rate > 0)
+            CreateEgressQueue();
+        shaper_.Configure(rate, burst, rtc::TimeMicros());
+        RTC_LOG(LS_INFO) << "Vlink " << content_name_ << " egress rate set to " << rate
+                         << " bps, burst " << burst << " bytes";
+        if (egress_queue_)
+            ScheduleEgressDrain(0);
+    }
+
+    void
+    VirtualLink::ScheduleEgressDrain(
+        int delay_ms)
+    {
+        if (drain_pending_.exchange(true))
+            return;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        auto drain = [wk_vlink]()
+        {
+            if (auto vlink = wk_vlink.lock())
+                vlink->DrainEgress();
+        };
+        if (delay_ms > 0)
+            network_thread_->PostDelayedTask(RTC_FROM_HERE, drain, delay_ms);
+        else
+            network_thread_->PostTask(RTC_FROM_HERE, drain);
+    }
+
+    /* Sends a bounded number of queued frames and reposts itself while more
+    are queued. While the transport is blocked the frames stay queued,
+    where CoDel sees their delay, instead of piling up as tasks.
+    */
+    void VirtualLink::DrainEgress()
+    {
+        drain_pending_ = false;
+        if (tx_blocked_)
+            return;
+        const int64_t now = rtc::TimeMicros();
+        const bool paced = cc_ && cc_->Active(now);
+        // one frame at a time, so a transport that blocks midway leaves the
+        // rest queued for OnReadyToSend
+        for (size_t sent = 0; sent < kEgressDrainBudget && !tx_blocked_; ++sent)
+        {
+            if (!shaper_.Admit(now) || (paced && !(pacer_.Admit(now) && cc_->CanSend(now))))
+                break;
+            if (egress_queue_->Dequeue(now, 1, drained_) == 0)
+                break;
+            Iob frame = std::move(drained_.back());
+            drained_.clear();
+            if (shaper_.Limited())
+                shaper_.Consume(frame.size());
+            if (paced)
+                pacer_.Consume(frame.size());
+            Transmit(std::move(frame));
+        }
+        FlushBatch();
+        if (cc_)
+        {
+            cc_->SetAppLimited(egress_queue_->Length() == 0);
+            if (!ping_pending_)
+                SendPing();
+        }
+        if (tx_blocked_ || egress_queue_->Length() == 0)
+            return;
+        // a full window waits for the feedback, or the ping timer if none
+        // comes
+        if (paced && !cc_->CanSend(now))
+            return;
+        // out of tokens, the next drain waits until they are back
+        int64_t wait_us = shaper_.WaitUs();
+        if (paced)
+            wait_us = std::max(wait_us, pacer_.WaitUs());
+        ScheduleEgressDrain(static_cast<int>((wait_us + 999) / 1000));
+    }
+
+    void
+    VirtualLink::OnReadyToSend(
+        PacketTransportInternal *)
+    {
+        if (!tx_blocked_)
+            return;
+        tx_blocked_ = false;
+        if (egress_queue_)
+            ScheduleEgressDrain(0);
+    }
+
+    /* Pings the peer every kPingIntervalUs while there is data queued or in
+    flight. The ping is sent at once, behind the records already sent, so
+    its echo measures the path and the queue on it but not the egress
+    queue.
+    */
+    void VirtualLink::SendPing()
+    {
+        ping_pending_ = false;
+        if (!IsReady())
+            return;
+        const int64_t now = rtc::TimeMicros();
+        const bool queued = egress_queue_->Length() > 0;
+        if (!queued && !(cc_->Active(now) && cc_->InFlight() > 0))
+            return;
+        array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> ping;
+        size_t pos = LinkRecord::WriteHeader(ping.data(), LinkRecord::kControl, 0);
+        pos += LinkRecord::WriteControl(ping.data() + pos, LinkRecord::kPing, cc_->OnPing(now), 0);
+        SendRecord(ping.data(), pos);
+        // restarts a drain held by a window that no feedback will open
+        if (queued)
+            ScheduleEgressDrain(0);
+        SchedulePing();
+    }
+
+    void VirtualLink::SchedulePing()
+    {
+        if (ping_pending_)
+            return;
+        ping_pending_ = true;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink]()
+            {
+                if (auto vlink = wk_vlink.lock())
+                    vlink->SendPing(); },
+            BbrController::kPingIntervalUs / 1000);
+    }
+
+    /* Opens the native socket on the local address of the selected pair
+    and offers its port to the peer over DTLS. The peer's socket is at the
+    remote address of the pair and the port it offers. Both only carry
+    records once a probe has made the round trip on them, so a NAT or
+    firewall that lets ICE through but not the new ports leaves the link
+    on DTLS.
+    */
+    void VirtualLink::StartNative()
+    {
+        const LinkOptions &options = vlink_desc_->options;
+        // the records are striped over every pair in multipath mode
+        if (!options.native_datapath || options.multipath || !vlink_desc_->dtls_enabled || native_)
+            return;
+        const cricket::Connection *conn = dtls_transport_->ice_transport()->selected_connection();
+        // the socket is bound to the local host address and offered by its
+        // own port, which the peer only reaches when neither side is behind
+        // a NAT or relay, so only host to host pairs use it
+        if (!conn || conn->local_candidate().type() != cricket::LOCAL_PORT_TYPE ||
+            conn->remote_candidate().type() != cricket::LOCAL_PORT_TYPE)
+            return;
+        if (!native_crypto_)
+        {
+            array<uint8_t, NativeCrypto::kMaterialSz> material;
+            rtc::SSLRole role = rtc::SSL_CLIENT;
+            if (!dtls_transport_->GetDtlsRole(&role) ||
+                !dtls_transport_->ExportKeyingMaterial(kNativeKeyLabel, nullptr, 0, false,
+                                                       material.data(), material.size()))
+            {
+                RTC_LOG(LS_WARNING) << "vlink " << content_name_ << " failed to export the native keys";
+                return;
+            }
+            auto crypto = make_unique<NativeCrypto>();
+            if (!crypto->Initialize(material.data(), role == rtc::SSL_CLIENT))
+                return;
+            native_crypto_ = std::move(crypto);
+        }
+        auto channel = make_unique<NativeChannel>(
+            static_cast<rtc::PhysicalSocketServer *>(network_thread_->socketserver()), *native_crypto_);
+        if (!channel->Open(conn->local_candidate().address().ipaddr()))
+            return;
+        if (tx_dscp_ != 0)
+            channel->SetDscp(tx_dscp_);
+        channel->SignalRecordReceived.connect(this, &VirtualLink::ReceiveRecord);
+        channel->SignalReadyToSend.connect(this, &VirtualLink::OnNativeReadyToSend);
+        native_ = std::move(channel);
+        array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> offer;
+        size_t pos = LinkRecord::WriteHeader(offer.data(), LinkRecord::kControl, 0);
+        pos += LinkRecord::WriteControl(offer.data() + pos, LinkRecord::kNativeOffer, native_->Port(), 0);
+        SendRecord(offer.data(), pos);
+    }
+
+    void VirtualLink::StopNative()
+    {
+        if (!native_)
+            return;
+        // the peer stops sending to the closed port at once instead of
+        // after kNativeTimeout
+        array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> withdraw;
+        size_t pos = LinkRecord::WriteHeader(withdraw.data(), LinkRecord::kControl, 0);
+        pos += LinkRecord::WriteControl(withdraw.data() + pos, LinkRecord::kNativeWithdraw, native_->Port(), 0);
+        native_tx_ = false;
+        SendRecord(withdraw.data(), pos);
+        CloseNative();
+    }
+
+    void VirtualLink::CloseNative()
+    {
+        if (!native_)
+            return;
+        native_tx_ = false;
+        ++native_timer_id_;
+        const bool blocked = native_->Blocked();
+        native_.reset();
+        // records go back on DTLS, which has not refused any
+        if (blocked)
+            OnNativeReadyToSend();
+    }
+
+    void VirtualLink::OnNativeReadyToSend()
+    {
+        OnReadyToSend(nullptr);
+    }
+
+    // a full native socket holds the egress like a blocked DTLS transport
+    void VirtualLink::CheckNativeBlocked()
+    {
+        if (tx_blocked_ || !native_->Blocked())
+            return;
+        tx_blocked_ = true;
+        ++tx_blocked_count_;
+    }
+
+    void
+    VirtualLink::OnNativeOffer(
+        uint16_t port)
+    {
+        // the offer may come before this side has started
+        StartNative();
+        const cricket::Connection *conn = dtls_transport_->ice_transport()->selected_connection();
+        if (!native_ || !conn)
+            return;
+        const rtc::SocketAddress peer(conn->remote_candidate().address().ipaddr(), port);
+        if (peer == native_->Peer())
+            return;
+        // a new socket of the peer's is unproven
+        native_tx_ = false;
+        if (!native_->Connect(peer))
+            return;
+        RTC_LOG(LS_INFO) << "vlink " << content_name_ << " probing the native path to " << peer.ToString();
+        ProbeNative();
+    }
+
+    void VirtualLink::ProbeNative()
+    {
+        if (!native_ || !native_->Connected())
+            return;
+        if (native_tx_ && rtc::TimeMillis() - native_ack_ms_ > kNativeTimeout)
+        {
+            native_tx_ = false;
+            ++native_fallbacks_;
+            RTC_LOG(LS_INFO) << "vlink " << content_name_ << " lost the native path, back on DTLS";
+            if (native_->Blocked())
+                OnNativeReadyToSend();
+        }
+        array<char, LinkRecord::kMaxHeaderSz + LinkRecord::kControlSz> probe;
+        size_t pos = LinkRecord::WriteHeader(probe.data(), LinkRecord::kControl, 0);
+        pos += LinkRecord::WriteControl(probe.data() + pos, LinkRecord::kNativeProbe, ++native_probe_id_, 0);
+        native_->Send(probe.data(), pos);
+        native_->Flush();
+        // only the latest scheduled probe runs
+        const uint32_t timer_id = ++native_timer_id_;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink, timer_id]()
+            {
+                auto vlink = wk_vlink.lock();
+                if (vlink && vlink->native_timer_id_ == timer_id)
+                    vlink->ProbeNative(); },
+            kNativeProbeInterval);
+    }
+
+    /* Records sent on the native socket are gathered for the rest of the
+    current task, a TAP burst or an egress drain, and leave together.
+    */
+    void VirtualLink::ScheduleNativeFlush()
+    {
+        if (native_flush_pending_)
+            return;
+        native_flush_pending_ = true;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostTask(
+            RTC_FROM_HERE, [wk_vlink]()
+            {
+                if (auto vlink = wk_vlink.lock())
+                {
+                    vlink->native_flush_pending_ = false;
+                    if (vlink->native_)
+                    {
+                        vlink->native_->Flush();
+                        vlink->CheckNativeBlocked();
+                    }
+                } });
+    }
+
+    size_t VirtualLink::RecordLimit() const
+    {
+        // the parity of a full sized record must fit the path as well
+        return pmtu_->Plpmtu() - (fec_tx_ ? kFecOverhead : 0);
+    }
+
+    size_t VirtualLink::BatchLimit() const
+    {
+        // batches stay within the path MTU, only an oversized frame is
+        // sent in fragments
+        if (pmtu_)
+            return std::min(batch_limit_, RecordLimit() - LinkRecord::kMaxHeaderSz);
+        return batch_limit_;
+    }
+
+    uint8_t
+    VirtualLink::OuterDscp(
+        const Iob &frame) const
+    {
+        FrameInfo info;
+        if (!FrameInfo::Parse(frame.data(), frame.size(), info))
+            return 0;
+        if (vlink_desc_->options.outer_dscp == LinkOptions::kOuterDscpCopy)
+            return info.dscp;
+        static const uint8_t kClassDscp[FqCodelQueue::kTins] = {46, 34, 0, 8};
+        return kClassDscp[FqCodelQueue::TinForDscp(info.dscp)];
+    }
+
+    /* The marking is a socket option, it is only set when it changes. The
+    priority queue sends each class in a run, so that is rarely per frame.
+    */
+    void
+    VirtualLink::SetOuterDscp(
+        uint8_t dscp)
+    {
+        if (dscp == tx_dscp_)
+            return;
+        tx_dscp_ = dscp;
+        packet_options_.dscp = static_cast<rtc::DiffServCodePoint>(dscp);
+        dtls_transport_->SetOption(rtc::Socket::OPT_DSCP, dscp);
+        if (native_)
+            native_->SetDscp(dscp);
+        ++dscp_changes_;
+    }
+
+    void VirtualLink::FlushBatch()
+    {
+        if (batch_frames_ == 0)
+            return;
+        SetOuterDscp(batch_dscp_);
+        uint8_t flags = 0;
+        if (vlink_desc_->options.multipath)
+            flags |= LinkRecord::kSequenced;
+        if (vlink_desc_->options.Encoded())
+            flags |= LinkRecord::kEncoded;
+        char *payload = tx_record_.data() + kRecordHeadroom;
+        size_t payload_len = batch_len_;
+        if (batch_frames_ == 1)
+        {
+            // a lone frame goes without its length prefix
+            payload += LinkRecord::kLenSz;
+            payload_len -= LinkRecord::kLenSz;
+        }
+        else
+        {
+            flags |= LinkRecord::kBatch;
+            ++tx_batches_;
+            tx_batched_frames_ += batch_frames_;
+        }
+        batch_len_ = 0;
+        batch_frames_ = 0;
+        if (pmtu_ && LinkRecord::HeaderSize(flags) + payload_len > RecordLimit())
+        {
+            SendFragments(flags, payload, payload_len);
+            return;
+        }
+        char *record = payload - LinkRecord::HeaderSize(flags);
+        LinkRecord::WriteHeader(record, flags, tx_seq_++);
+        SendRecord(record, payload + payload_len - record);
+    }
+
+    void
+    VirtualLink::SendFragments(
+        uint8_t flags,
+        char *payload,
+        size_t payload_len)
+    {
+        flags |= LinkRecord::kFragment;
+        const size_t hdr_len = LinkRecord::HeaderSize(flags) + LinkRecord::kFragmentHeaderSz;
+        const size_t chunk = RecordLimit() - hdr_len;
+        const uint16_t id = tx_frag_id_++;
+        ++tx_fragmented_;
+        for (size_t offset = 0; offset < payload_len; offset += chunk)
+        {
+            const size_t len = std::min(chunk, payload_len - offset);
+            // the headers overwrite the tail of the piece sent before
+            char *record = payload + offset - hdr_len;
+            const size_t pos = LinkRecord::WriteHeader(record, flags, tx_seq_++);
+            LinkRecord::WriteFragmentHeader(record + pos, id, offset, offset + len == payload_len);
+            SendRecord(record, hdr_len + len);
+            ++tx_fragments_;
+        }
+    }
+
+    void
+    VirtualLink::SendRecord(
+        const char *data,
+        size_t len)
+    {
+        // control records are answered at once and never protected
+        if (fec_tx_ && fec_tx_->Redundancy() > 0 && !(data[0] & LinkRecord::kControl))
+        {
+            fec_tx_->Protect(data, len);
+            ScheduleFecFlush();
+            return;
+        }
+        TransportSend(data, len);
+    }
+
+    void
+    VirtualLink::TransportSend(
+        const char *data,
+        size_t len)
+    {
+        if (native_tx_)
+        {
+            native_->Send(data, len);
+            ScheduleNativeFlush();
+            CheckNativeBlocked();
+        }
+        else if (dtls_transport_->SendPacket(data, len, packet_options_, 0) < 0)
+        {
+            const int error = dtls_transport_->GetError();
+            if (rtc::IsBlockingError(error))
+            {
+                tx_blocked_ = true;
+                ++tx_blocked_count_;
+                return;
+            }
+            RTC_LOG(LS_INFO) << "Vlink send failed. ERRNO: " << error;
+            return;
+        }
+        if (cc_ && !(data[0] & LinkRecord::kControl))
+            cc_->OnSent(len);
     }
 
     string VirtualLink::Candidates()
+    {
+        if (!network_thread_->IsCurrent())
+            return network_thread_->Invoke<string>(RTC_FROM_HERE, [this]()
+                                                   { return CandidatesToString(local_candidates_); });
+        return CandidatesToString(local_candidates_);
+    }
+
+    string VirtualLink::CandidatesToString(
+        const cricket::Candidates &candidates)
     {
         std::ostringstream oss;
-        for (auto &cnd : local_candidates_)
+        for (auto &cnd : candidates)
         {
             oss << cnd.component()
                 << kCandidateDelim << cnd.protocol()
@@ -227,9 +1400,8 @@ namespace tincan
     VirtualLink::PeerCandidates(
         const string &peer_cas)
     {
-        peer_desc_->cas = peer_cas;
-        if (peer_desc_->cas.length() != 0)
-            AddRemoteCandidates(peer_desc_->cas);
+        if (peer_cas.length() != 0 && AddRemoteCandidates(peer_cas) != 0)
+            peer_desc_->cas = CandidatesToString(remote_candidates_);
     }
 
     void
@@ -269,6 +1441,134 @@ namespace tincan
             }
     }
 
+    void
+    VirtualLink::GetSetupInfo(Json::Value &setup_info)
+    {
+        const IceProfile &profile = vlink_desc_->ice_profile;
+        Json::Value &prof = setup_info["IceProfile"];
+        prof["GatherTimeout"] = profile.gather_timeout;
+        prof["CheckInterval"] = profile.check_interval;
+        prof["ReceivingTimeout"] = profile.receiving_timeout;
+        prof["AggressiveNomination"] = profile.aggressive_nomination;
+        if (profile.prune_policy == webrtc::NO_PRUNE)
+            prof["PrunePolicy"] = "None";
+        else if (profile.prune_policy == webrtc::KEEP_FIRST_READY)
+            prof["PrunePolicy"] = "KeepFirstReady";
+        else
+            prof["PrunePolicy"] = "Priority";
+        prof["ContinualGathering"] = profile.continual_gathering;
+        prof["WarmStandby"] = profile.warm_standby;
+        prof["Trickle"] = vlink_desc_->trickle;
+        Json::Value &times = setup_info["SetupTimes"];
+        times["CasReadyMs"] = (Json::Int64)cas_ready_time_.count();
+        times["GatherCompleteMs"] = (Json::Int64)gather_time_.count();
+        times["ConnectedMs"] = (Json::Int64)connect_time_.count();
+        times["GatherTimedOut"] = gather_timed_out_;
+        times["PreGathered"] = pre_gathered_;
+        times["Resumed"] = resume_count_;
+        times["IceRestarts"] = ice_restarts_;
+        times["IceRestartMs"] = (Json::Int64)restart_time_.count();
+        times["NetworkChanges"] = network_changes_;
+        times["Handovers"] = handovers_;
+        times["HandoverGapMs"] = (Json::Int64)handover_gap_.count();
+        times["Failovers"] = failovers_;
+        times["FailoverMs"] = (Json::Int64)failover_time_;
+    }
+
+    bool
+    VirtualLink::CanResume(
+        const PeerDescriptor &peer_desc,
+        const VlinkDescriptor &vlink_desc,
+        cricket::IceRole ice_role)
+    {
+        if (peer_desc.uid != peer_desc_->uid ||
+            peer_desc.fingerprint != peer_desc_->fingerprint || ice_role != ice_role_)
+            return false;
+        // the options fixed the record format and the ICE config at setup
+        if (!(vlink_desc.options == vlink_desc_->options) ||
+            !(vlink_desc.ice_profile == vlink_desc_->ice_profile))
+            return false;
+        // a CAS without credentials comes from an agent that never restarted
+        string ufrag = kIceUfrag, pwd = kIcePwd;
+        CredentialsFromCas(peer_desc.cas, ufrag, pwd);
+        return ufrag == remote_ufrag_ && pwd == remote_pwd_;
+    }
+
+    void
+    VirtualLink::Resume()
+    {
+        resumed_ = true;
+        ++resume_count_;
+        RTC_LOG(LS_INFO) << "Resuming vlink " << vlink_desc_->uid
+                         << " with peer " << peer_desc_->uid
+                         << ", skipped setup of " << connect_time_.count() << " ms";
+    }
+
+    void
+    VirtualLink::ApplyTransportDescriptions()
+    {
+        // renomination lets the controlling agent nominate on every check
+        // and move to a better pair without waiting for checks to settle
+        vector<string> transport_options;
+        if (vlink_desc_->ice_profile.aggressive_nomination)
+            transport_options.push_back(cricket::ICE_OPTION_RENOMINATION);
+        cricket::ConnectionRole remote_conn_role = cricket::CONNECTIONROLE_ACTIVE;
+        if (cricket::ICEROLE_CONTROLLED == ice_role_)
+            remote_conn_role = cricket::CONNECTIONROLE_ACTPASS;
+
+        cricket::TransportDescription local_transport_desc(
+            transport_options, local_ufrag_, local_pwd_,
+            cricket::ICEMODE_FULL, local_conn_role_, local_fingerprint_.get());
+
+        cricket::TransportDescription remote_transport_desc(
+            transport_options, remote_ufrag_, remote_pwd_,
+            cricket::ICEMODE_FULL, remote_conn_role, remote_fingerprint_.get());
+
+        cricket::ContentGroup bundle_group(cricket::GROUP_TYPE_BUNDLE);
+        bundle_group.AddContentName(content_name_);
+
+        // the controller keeps pointers to the applied descriptions so the
+        // previous pair is only released once the new one is in place
+        auto local_description = make_unique<cricket::SessionDescription>();
+        auto remote_description = make_unique<cricket::SessionDescription>();
+        std::unique_ptr<cricket::SctpDataContentDescription> data(
+            new cricket::SctpDataContentDescription());
+        data->set_rtcp_mux(true);
+        local_description->AddContent(content_name_, cricket::MediaProtocolType::kSctp, move(data));
+        local_description->AddGroup(bundle_group);
+        local_description->AddTransportInfo(cricket::TransportInfo(content_name_, local_transport_desc));
+
+        data.reset(new cricket::SctpDataContentDescription());
+        remote_description->AddContent(content_name_, cricket::MediaProtocolType::kSctp, move(data));
+        remote_description->AddGroup(bundle_group);
+        remote_description->AddTransportInfo(cricket::TransportInfo(content_name_, remote_transport_desc));
+
+        webrtc::RTCError err;
+        if (ice_role_ == cricket::ICEROLE_CONTROLLING)
+        {
+            err = transport_ctlr_->SetLocalDescription(SdpType::kOffer, local_description.get());
+            if (err.ok())
+                err = transport_ctlr_->SetRemoteDescription(SdpType::kAnswer, remote_description.get());
+        }
+        else if (ice_role_ == cricket::ICEROLE_CONTROLLED)
+        {
+            // when receiving an offer the remote description with the offer must be set first.
+            err = transport_ctlr_->SetRemoteDescription(SdpType::kOffer, remote_description.get());
+            if (err.ok())
+                err = transport_ctlr_->SetLocalDescription(SdpType::kAnswer, local_description.get());
+        }
+        else
+        {
+            RTC_LOG(LS_ERROR) << "Invalid ice role specified " << ice_role_;
+            return;
+        }
+        if (!err.ok())
+            RTC_LOG(LS_ERROR) << "Failed to apply transport descriptions on vlink "
+                              << content_name_ << " - " << err.message();
+        local_description_ = move(local_description);
+        remote_description_ = move(remote_description);
+    }
+
     void
     VirtualLink::SetupICE(
         unique_ptr<SSLIdentity> sslid,
@@ -278,6 +1578,7 @@ namespace tincan
         if (vlink_desc_->dtls_enabled)
         {
             transport_ctlr_->SetLocalCertificate(RTCCertificate::Create(move(sslid)));
+            local_fingerprint_ = move(local_fingerprint);
 
             size_t pos = peer_desc_->fingerprint.find(' ');
             string alg, fp;
@@ -291,64 +1592,67 @@ namespace tincan
         }
         else
         {
-            local_fingerprint.release();
             RTC_LOG(LS_INFO) << "Not using DTLS on vlink " << content_name_ << "\n";
         }
+        const IceProfile &profile = vlink_desc_->ice_profile;
         cricket::IceConfig ic;
         ic.continual_gathering_policy = cricket::GATHER_ONCE;
+        if (profile.continual_gathering)
+        {
+            ic.continual_gathering_policy = cricket::GATHER_CONTINUALLY;
+            net_manager_->SignalNetworksChanged.connect(this, &VirtualLink::OnNetworksChanged);
+        }
+        if (profile.check_interval > 0)
+        {
+            ic.ice_check_interval_strong_connectivity = profile.check_interval;
+            ic.ice_check_interval_weak_connectivity = profile.check_interval;
+        }
+        if (profile.receiving_timeout > 0)
+            ic.receiving_timeout = profile.receiving_timeout;
+        if (profile.warm_standby)
+            ApplyStandbyConfig(ic);
+        else if (vlink_desc_->options.multipath)
+        {
+            // every usable pair carries traffic, keep the backups validated
+            ic.backup_connection_ping_interval = kStandbyPingInterval;
+        }
         transport_ctlr_->SetIceConfig(ic);
-        cricket::ConnectionRole remote_conn_role = cricket::CONNECTIONROLE_ACTIVE;
         local_conn_role_ = cricket::CONNECTIONROLE_ACTPASS;
         if (cricket::ICEROLE_CONTROLLED == ice_role)
-        {
             local_conn_role_ = cricket::CONNECTIONROLE_ACTIVE;
-            remote_conn_role = cricket::CONNECTIONROLE_ACTPASS;
-        }
-
-        cricket::TransportDescription local_transport_desc(
-            vector<string>(), kIceUfrag, kIcePwd,
-            cricket::ICEMODE_FULL, local_conn_role_, local_fingerprint.get());
-
-        cricket::TransportDescription remote_transport_desc(
-            vector<string>(), kIceUfrag, kIcePwd,
-            cricket::ICEMODE_FULL, remote_conn_role, remote_fingerprint_.get());
-
-        cricket::ContentGroup bundle_group(cricket::GROUP_TYPE_BUNDLE);
-        bundle_group.AddContentName(content_name_);
-
-        std::unique_ptr<cricket::SctpDataContentDescription> data(
-            new cricket::SctpDataContentDescription());
-        data->set_rtcp_mux(true);
-        local_description_->AddContent(content_name_, cricket::MediaProtocolType::kSctp, move(data));
-        local_description_->AddGroup(bundle_group);
-        local_description_->AddTransportInfo(cricket::TransportInfo(content_name_, local_transport_desc));
-
-        data.reset(new cricket::SctpDataContentDescription());
-        remote_description_->AddContent(content_name_, cricket::MediaProtocolType::kSctp, move(data));
-        remote_description_->AddGroup(bundle_group);
-        remote_description_->AddTransportInfo(cricket::TransportInfo(content_name_, remote_transport_desc));
-
         if (ice_role == cricket::ICEROLE_CONTROLLING)
-        {
             RTC_LOG(LS_INFO) << "Creating CONTROLLING vlink to peer " << peer_desc_->uid;
-            transport_ctlr_->SetLocalDescription(SdpType::kOffer, local_description_.get());
-            transport_ctlr_->SetRemoteDescription(SdpType::kAnswer, remote_description_.get());
-        }
         else if (ice_role == cricket::ICEROLE_CONTROLLED)
-        {
-            // when receiving an offer the remote description with the offer must be set first.
             RTC_LOG(LS_INFO) << "Creating CONTROLLED vlink to peer " << peer_desc_->uid;
-            transport_ctlr_->SetRemoteDescription(SdpType::kOffer, remote_description_.get());
-            transport_ctlr_->SetLocalDescription(SdpType::kAnswer, local_description_.get());
-        }
-        else
+        ApplyTransportDescriptions();
+    }
+
+    unique_ptr<cricket::PortAllocator>
+    VirtualLink::CreatePortAllocator(
+        NetworkResources &net_resources,
+        rtc::Thread *network_thread,
+        rtc::NetworkManager *net_manager,
+        const VlinkDescriptor &vlink_desc,
+        int candidate_pool_size)
+    {
+        unique_ptr<cricket::PortAllocator> port_allocator = make_unique<TincanPortAllocator>(
+            net_manager, make_unique<TincanSocketFactory>(network_thread, vlink_desc.socket_options));
+        if (candidate_pool_size > 0)
         {
-            RTC_LOG(LS_ERROR) << "Invalid ice role specified " << ice_role;
+            port_allocator->set_flags(port_allocator->flags() | cricket::PORTALLOCATOR_DISABLE_TCP);
+            port_allocator->Initialize();
         }
+        port_allocator->SetConfiguration(
+            SetupSTUN(net_resources, network_thread, vlink_desc.stun_servers),
+            SetupTURN(net_resources, network_thread, vlink_desc.turn_descs),
+            candidate_pool_size, vlink_desc.ice_profile.prune_policy);
+        return port_allocator;
     }
 
     cricket::ServerAddresses
     VirtualLink::SetupSTUN(
+        NetworkResources &net_resources,
+        rtc::Thread *network_thread,
         vector<string> stun_servers)
     {
         cricket::ServerAddresses stun_addrs;
@@ -358,15 +1662,15 @@ namespace tincan
         }
         for (auto stun_server : stun_servers)
         {
-            rtc::SocketAddress stun_addr;
-            stun_addr.FromString(stun_server);
-            stun_addrs.insert(stun_addr);
+            stun_addrs.insert(net_resources.ResolveServer(network_thread, stun_server));
         }
         return stun_addrs;
     }
 
     vector<cricket::RelayServerConfig>
     VirtualLink::SetupTURN(
+        NetworkResources &net_resources,
+        rtc::Thread *network_thread,
         const vector<TurnDescriptor> turn_descs)
     {
         if (turn_descs.empty())
@@ -392,6 +1696,8 @@ namespace tincan
             }
             cricket::RelayServerConfig relay_config_udp(addr_port[0], stoi(addr_port[1]),
                                                         turn_desc.username, turn_desc.password, cricket::PROTO_UDP);
+            relay_config_udp.ports.front().address =
+                net_resources.ResolveServer(network_thread, turn_desc.server_hostname);
             turn_servers.push_back(relay_config_udp);
         }
         return turn_servers;
@@ -404,11 +1710,244 @@ namespace tincan
             InitializePortAllocator();
         if (peer_desc_->cas.length() != 0)
             AddRemoteCandidates(peer_desc_->cas);
+        setup_start_ = steady_clock::now();
         transport_ctlr_->MaybeStartGathering();
+        ScheduleGatherTimeout();
+    }
+
+    void VirtualLink::ScheduleGatherTimeout()
+    {
+        int timeout = vlink_desc_->ice_profile.gather_timeout;
+        // continual gathering never reports completion, so the deadline is
+        // what answers a non-trickle CreateLink
+        if (timeout <= 0 && vlink_desc_->ice_profile.continual_gathering)
+            timeout = kContinualGatherTimeout;
+        // a deadline left over from an earlier generation must not answer
+        // the CAS of a restart with its partial candidate set
+        const uint32_t gen = ++gather_gen_;
+        if (timeout <= 0)
+            return;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink, gen]()
+            {
+                auto vlink = wk_vlink.lock();
+                if (vlink && vlink->gather_gen_ == gen)
+                    vlink->OnGatherTimeout(); },
+            timeout);
+    }
+
+    bool
+    VirtualLink::IceRestart(
+        const string &peer_cas,
+        uint64_t cas_ready_id)
+    {
+        string ufrag, pwd;
+        const bool has_peer_creds = CredentialsFromCas(peer_cas, ufrag, pwd);
+        if (restart_pending_ && has_peer_creds)
+        {
+            // the peer answered a restart started here, only its new
+            // credentials and candidates are needed
+            SetRemoteCredentials(ufrag, pwd);
+            restart_pending_ = false;
+            ApplyTransportDescriptions();
+            PeerCandidates(peer_cas);
+            return false;
+        }
+        RTC_LOG(LS_INFO) << "Restarting ICE on vlink " << content_name_;
+        ++ice_restarts_;
+        restart_start_ = steady_clock::now();
+        restart_switch_pending_ = true;
+        local_ufrag_ = rtc::CreateRandomString(cricket::ICE_UFRAG_LENGTH);
+        local_pwd_ = rtc::CreateRandomString(cricket::ICE_PWD_LENGTH);
+        restart_pending_ = !has_peer_creds;
+        if (has_peer_creds)
+            SetRemoteCredentials(ufrag, pwd);
+        local_candidates_.clear();
+        cas_ready_id_ = cas_ready_id;
+        cas_answered_ = false;
+        ApplyTransportDescriptions();
+        // new local credentials start a new gathering generation, the
+        // current pair keeps carrying DTLS traffic until it is replaced
+        transport_ctlr_->MaybeStartGathering();
+        ScheduleGatherTimeout();
+        if (has_peer_creds)
+            PeerCandidates(peer_cas);
+        return true;
+    }
+
+    void
+    VirtualLink::SetRemoteCredentials(
+        const string &ufrag,
+        const string &pwd)
+    {
+        if (ufrag == remote_ufrag_ && pwd == remote_pwd_)
+            return;
+        remote_ufrag_ = ufrag;
+        remote_pwd_ = pwd;
+        // candidates from the previous generation must not mask new ones
+        remote_candidates_.clear();
+    }
+
+    bool
+    VirtualLink::CredentialsFromCas(
+        const string &cas,
+        string &ufrag,
+        string &pwd)
+    {
+        std::istringstream iss(cas);
+        string candidate_str;
+        iss >> candidate_str;
+        vector<string> fields;
+        if (rtc::split(candidate_str, kCandidateDelim, &fields) < 10)
+            return false;
+        ufrag = fields[5];
+        pwd = fields[6];
+        return !ufrag.empty() && !pwd.empty();
+    }
+
+    void
+    VirtualLink::OnCandidatePairChanged(
+        const cricket::CandidatePairChangeEvent &event)
+    {
+        const cricket::CandidatePairInterface &pair = event.selected_candidate_pair;
+        // the new pair may take a different route
+        if (IsReady())
+        {
+            RestartPathMtuSearch();
+            // the native socket follows the pair's addresses
+            StopNative();
+            StartNative();
+        }
+        // with a warm standby the switch away from a dead pair is the
+        // failover, timed from when the link went unwritable on the old
+        // pair; a standby that takes over as soon as the old pair is
+        // detected failed leaves the link writable and takes 0 ms
+        if (vlink_desc_->ice_profile.warm_standby && !vlink_desc_->options.multipath && HasConnected() &&
+            event.last_data_received_ms > 0 && !handover_pending_ && !restart_switch_pending_)
+        {
+            ++failovers_;
+            failover_time_ = unwritable_time_ > 0 ? rtc::TimeMillis() - unwritable_time_ : 0;
+            RTC_LOG(LS_INFO) << "vlink " << content_name_ << " failed over to "
+                             << pair.local_candidate().address().ToString() << " -> "
+                             << pair.remote_candidate().address().ToString()
+                             << " after " << failover_time_ << " ms, reason: " << event.reason;
+        }
+        if (handover_pending_)
+        {
+            handover_pending_ = false;
+            ++handover_timer_id_;
+            ++handovers_;
+            handover_gap_ = std::chrono::duration_cast<milliseconds>(steady_clock::now() - network_change_time_);
+            RTC_LOG(LS_INFO) << "vlink " << content_name_ << " handed over to "
+                             << pair.local_candidate().address().ToString()
+                             << " after " << handover_gap_.count() << " ms";
+        }
+        if (!restart_switch_pending_)
+            return;
+        if (pair.local_candidate().username() != local_ufrag_ ||
+            pair.remote_candidate().username() != remote_ufrag_)
+            return;
+        restart_switch_pending_ = false;
+        restart_time_ = std::chrono::duration_cast<milliseconds>(steady_clock::now() - restart_start_);
+        RTC_LOG(LS_INFO) << "vlink " << content_name_ << " switched to restarted pair "
+                         << pair.local_candidate().address().ToString() << " -> "
+                         << pair.remote_candidate().address().ToString()
+                         << " after " << restart_time_.count() << " ms";
+    }
+
+    void VirtualLink::OnGatherTimeout()
+    {
+        if (!cas_ready_id_)
+            return;
+        RTC_LOG(LS_INFO) << "Candidate gathering deadline reached on vlink " << content_name_
+                         << ", responding with " << local_candidates_.size() << " candidates";
+        gather_timed_out_ = true;
+        CompleteCasReady();
+    }
+
+    void VirtualLink::CompleteCasReady()
+    {
+        // setup times describe the initial connection, not later restarts
+        if (ice_restarts_ == 0)
+            cas_ready_time_ = std::chrono::duration_cast<milliseconds>(steady_clock::now() - setup_start_);
+        SignalLocalCasReady(cas_ready_id_, Candidates());
+        cas_ready_id_ = 0;
+        cas_answered_ = true;
+    }
+
+    void
+    VirtualLink::ApplyStandbyConfig(
+        cricket::IceConfig &ic)
+    {
+        const IceProfile &profile = vlink_desc_->ice_profile;
+        // backup pairs are normally pinged every 25s, keep them warm instead
+        ic.backup_connection_ping_interval = profile.standby_ping_interval > 0
+                                                 ? profile.standby_ping_interval
+                                                 : kStandbyPingInterval;
+        const int checks = profile.unwritable_checks > 0 ? profile.unwritable_checks
+                                                         : kStandbyUnwritableChecks;
+        const int check_interval = profile.check_interval > 0 ? profile.check_interval
+                                                              : kStandbyCheckInterval;
+        ic.ice_check_interval_strong_connectivity = check_interval;
+        ic.ice_check_interval_weak_connectivity = check_interval;
+        ic.ice_unwritable_min_checks = checks;
+        ic.ice_unwritable_timeout = checks * check_interval;
+        // data received counts as a heartbeat, so a silent selected pair is
+        // abandoned after the same number of missed checks
+        if (profile.receiving_timeout <= 0)
+            ic.receiving_timeout = checks * check_interval;
+    }
+
+    void VirtualLink::OnNetworksChanged()
+    {
+        // the allocator session adds ports for the new networks on its own,
+        // this only times how long traffic takes to move off a network that
+        // went away
+        if (!HasConnected())
+            return;
+        ++network_changes_;
+        const cricket::Connection *conn = dtls_transport_->ice_transport()->selected_connection();
+        if (!conn || SelectedNetworkUp(*conn))
+            return;
+        handover_pending_ = true;
+        network_change_time_ = steady_clock::now();
+        RTC_LOG(LS_INFO) << "The network of the selected pair went away on vlink " << content_name_
+                         << ", gathering candidates on the new networks";
+        // a pair switch long after is not this handover
+        const uint32_t timer_id = ++handover_timer_id_;
+        weak_ptr<VirtualLink> wk_vlink = shared_from_this();
+        network_thread_->PostDelayedTask(
+            RTC_FROM_HERE, [wk_vlink, timer_id]()
+            {
+                auto vlink = wk_vlink.lock();
+                if (vlink && vlink->handover_timer_id_ == timer_id)
+                    vlink->handover_pending_ = false; },
+            kHandoverTimeout);
+    }
+
+    bool
+    VirtualLink::SelectedNetworkUp(
+        const cricket::Connection &conn)
+    {
+        const rtc::Network *network = conn.port()->Network();
+        rtc::NetworkManager::NetworkList networks;
+        net_manager_->GetNetworks(&networks);
+        if (std::find(networks.begin(), networks.end(), network) == networks.end())
+            return false;
+        // a host candidate also needs its address to still be assigned
+        const cricket::Candidate &local = conn.local_candidate();
+        if (local.type() != cricket::LOCAL_PORT_TYPE)
+            return true;
+        const rtc::IPAddress &addr = local.address().ipaddr();
+        const vector<rtc::InterfaceAddress> &ips = network->GetIPs();
+        return std::any_of(ips.begin(), ips.end(), [&addr](const rtc::IPAddress &ip)
+                           { return ip == addr; });
     }
 
     void VirtualLink::Disconnect()
     {
+        StopNative();
         dtls_transport_->disconnect_all();
     }
 
@@ -37,7 +37,21 @@
 #include "p2p/base/packet_transport_internal.h"
 #include "p2p/base/p2p_transport_channel.h"
 #include "p2p/client/basic_port_allocator.h"
+#include "bbr_controller.h"
+#include "fec_codec.h"
+#include "fq_codel_queue.h"
+#include "fragment_buffer.h"
+#include "frame_codec.h"
+#include "link_record.h"
+#include "mss_clamper.h"
+#include "multipath_channel.h"
+#include "native_channel.h"
+#include "network_resources.h"
+#include "path_mtu_prober.h"
 #include "peer_descriptor.h"
+#include "reorder_buffer.h"
+#include "tincan_socket_factory.h"
+#include "token_bucket.h"
 #include "turn_descriptor.h"
 
 namespace tincan
@@ -51,23 +65,213 @@ namespace tincan
     using webrtc::JsepTransportController;
     using webrtc::SdpType;
 
+    /* ICE tuning for a single vlink, supplied by the controller in
+    CreateLink. Zero values keep the WebRTC defaults.
+    */
+    struct IceProfile
+    {
+        IceProfile() = default;
+        IceProfile(const Json::Value &desc) : gather_timeout{desc["GatherTimeout"].asInt()},
+                                              check_interval{desc["CheckInterval"].asInt()},
+                                              receiving_timeout{desc["ReceivingTimeout"].asInt()},
+                                              aggressive_nomination{desc["AggressiveNomination"].asBool()},
+                                              continual_gathering{desc["ContinualGathering"].asBool()},
+                                              warm_standby{desc["WarmStandby"].asBool()},
+                                              standby_ping_interval{desc["StandbyPingInterval"].asInt()},
+                                              unwritable_checks{desc["UnwritableChecks"].asInt()}
+        {
+            string prune = desc["PrunePolicy"].asString();
+            // a standby relay path is only useful if its port is kept
+            if (prune == "None" || (prune.empty() && warm_standby))
+                prune_policy = webrtc::NO_PRUNE;
+            else if (prune == "KeepFirstReady")
+                prune_policy = webrtc::KEEP_FIRST_READY;
+        }
+        // ms before CreateLink is answered with the candidates gathered so far
+        int gather_timeout = 0;
+        int check_interval = 0;
+        int receiving_timeout = 0;
+        bool aggressive_nomination = false;
+        // keep gathering as interfaces come and go, for nodes that roam
+        bool continual_gathering = false;
+        // keep the next best pair validated so a dead pair fails over at once
+        bool warm_standby = false;
+        int standby_ping_interval = 0;
+        // missed checks before the selected pair is declared unwritable
+        int unwritable_checks = 0;
+        webrtc::PortPrunePolicy prune_policy = webrtc::PRUNE_BASED_ON_PRIORITY;
+
+        bool operator==(const IceProfile &other) const
+        {
+            return gather_timeout == other.gather_timeout &&
+                   check_interval == other.check_interval &&
+                   receiving_timeout == other.receiving_timeout &&
+                   aggressive_nomination == other.aggressive_nomination &&
+                   continual_gathering == other.continual_gathering &&
+                   warm_standby == other.warm_standby &&
+                   standby_ping_interval == other.standby_ping_interval &&
+                   unwritable_checks == other.unwritable_checks &&
+                   prune_policy == other.prune_policy;
+        }
+    };
+
+    /* Datapath features of a vlink. Some change the record format so the
+    controller must give both peers the same options.
+    */
+    struct LinkOptions
+    {
+        LinkOptions() = default;
+        LinkOptions(const Json::Value &desc) : multipath{desc["Multipath"].asBool()},
+                                               batching{desc["Batching"].asBool()},
+                                               batch_limit{desc["BatchLimit"].asUInt()},
+                                               compression{desc["Compression"].asBool()},
+                                               header_compression{desc["HeaderCompression"].asBool()},
+                                               path_mtu_discovery{desc["PathMtuDiscovery"].asBool()},
+                                               fec{desc["Fec"].asBool()},
+                                               fec_k{desc["FecK"].asUInt()},
+                                               fec_m{desc["FecM"].asUInt()},
+                                               inject_loss{desc["InjectLoss"].asDouble()},
+                                               fq_codel{desc["FqCodel"].asBool()},
+                                               fq_codel_limit{desc["FqCodelLimit"].asUInt()},
+                                               codel_target{desc["CodelTarget"].asUInt()},
+                                               codel_interval{desc["CodelInterval"].asUInt()},
+                                               ecn{desc.get("Ecn", true).asBool()},
+                                               rate{desc["Rate"].asUInt64()},
+                                               burst{desc["Burst"].asUInt()},
+                                               priority_queuing{desc["PriorityQueuing"].asBool()},
+                                               ack_priority{desc["AckPriority"].asBool()},
+                                               ack_filter{desc["AckFilter"].asBool()},
+                                               congestion_control{desc["CongestionControl"].asBool()},
+                                               native_datapath{desc["NativeDatapath"].asBool()}
+        {
+            string outer = desc["OuterDscp"].asString();
+            if (outer == "Copy")
+                outer_dscp = kOuterDscpCopy;
+            else if (outer == "Class")
+                outer_dscp = kOuterDscpClass;
+        }
+        // stripe records over every usable candidate pair
+        bool multipath = false;
+        // pack the frames of a TAP read burst into as few records as fit
+        bool batching = false;
+        // record payload limit in bytes, 0 uses the largest TAP frame
+        size_t batch_limit = 0;
+        // adaptive LZ4 block compression of frames
+        bool compression = false;
+        // per-flow Ethernet/IPv4/TCP header compression
+        bool header_compression = false;
+        // probe the path MTU and fragment records that exceed it
+        bool path_mtu_discovery = false;
+        // forward error correction over groups of fec_k records
+        bool fec = false;
+        // records per group, 0 uses the default
+        size_t fec_k = 0;
+        // parity records per group, 0 adapts it to the loss on the path
+        size_t fec_m = 0;
+        // percent of the received records dropped on purpose, for testing
+        double inject_loss = 0;
+        // fair queuing and CoDel between the TAP and the link
+        bool fq_codel = false;
+        // frames queued, 0 uses the default
+        size_t fq_codel_limit = 0;
+        // ms, 0 uses the RFC 8289 defaults of 5 and 100
+        uint32_t codel_target = 0;
+        uint32_t codel_interval = 0;
+        // mark ECN capable frames instead of dropping them
+        bool ecn = true;
+        // bits per second of TAP frames sent on the link, 0 is unlimited
+        uint64_t rate = 0;
+        // bytes sent at once after an idle period
+        size_t burst = 0;
+        // queue by the inner DSCP, voice first and the rest by weight
+        bool priority_queuing = false;
+        enum OuterDscp
+        {
+            kOuterDscpDefault,
+            // the inner DSCP as is
+            kOuterDscpCopy,
+            // EF, AF41, default or CS1 by the priority class of the inner DSCP
+            kOuterDscpClass,
+        };
+        // how records are marked for QoS on the underlay
+        OuterDscp outer_dscp = kOuterDscpDefault;
+        // pure TCP ACKs skip ahead of the bulk data
+        bool ack_priority = false;
+        // drop queued TCP ACKs that a later ACK supersedes
+        bool ack_filter = false;
+        // pace the egress to a BBR style estimate of the path, the peer
+        // answers the pings it needs whether or not it paces
+        bool congestion_control = false;
+        // once DTLS is up send the records on a UDP socket of the vlink's
+        // own, back on DTLS whenever that path stops answering
+        bool native_datapath = false;
+
+        bool Queued() const
+        {
+            return fq_codel || rate > 0 || priority_queuing || ack_priority || ack_filter ||
+                   congestion_control;
+        }
+
+        bool Encoded() const
+        {
+            return compression || header_compression;
+        }
+
+        // records carry a LinkRecord header
+        bool Framed() const
+        {
+            return multipath || batching || Encoded() || path_mtu_discovery || fec ||
+                   congestion_control || native_datapath;
+        }
+
+        bool operator==(const LinkOptions &other) const
+        {
+            return multipath == other.multipath && batching == other.batching &&
+                   batch_limit == other.batch_limit && compression == other.compression &&
+                   header_compression == other.header_compression &&
+                   path_mtu_discovery == other.path_mtu_discovery && fec == other.fec &&
+                   fec_k == other.fec_k && fec_m == other.fec_m &&
+                   inject_loss == other.inject_loss && fq_codel == other.fq_codel &&
+                   fq_codel_limit == other.fq_codel_limit &&
+                   codel_target == other.codel_target &&
+                   codel_interval == other.codel_interval && ecn == other.ecn &&
+                   rate == other.rate && burst == other.burst &&
+                   priority_queuing == other.priority_queuing &&
+                   outer_dscp == other.outer_dscp && ack_priority == other.ack_priority &&
+                   ack_filter == other.ack_filter &&
+                   congestion_control == other.congestion_control &&
+                   native_datapath == other.native_datapath;
+        }
+    };
+
     struct VlinkDescriptor
     {
         bool dtls_enabled = true;
+        // report local candidates to the controller as they are gathered
+        bool trickle = false;
         string uid;
         vector<string> stun_servers;
         vector<TurnDescriptor> turn_descs;
+        IceProfile ice_profile;
+        LinkOptions options;
+        SocketOptions socket_options;
+        // MAC of the local TAP device, used to elide frame addresses
+        MacAddressType local_mac{};
+        // told the usable path MTU when it is probed
+        shared_ptr<MssClamper> mss_clamper;
     };
 
     class VirtualLink : public JsepTransportController::Observer,
-                        public sigslot::has_slots<>
+                        public sigslot::has_slots<>,
+                        public std::enable_shared_from_this<VirtualLink>
     {
     public:
         VirtualLink(
             unique_ptr<VlinkDescriptor> vlink_desc,
             unique_ptr<PeerDescriptor> peer_desc,
             rtc::Thread *signaling_thread,
-            rtc::Thread *network_thread);
+            rtc::Thread *network_thread,
+            shared_ptr<NetworkResources> net_resources);
 
         string Name();
 
@@ -75,7 +279,17 @@ namespace tincan
             unique_ptr<SSLIdentity> sslid,
             unique_ptr<SSLFingerprint> local_fingerprint,
             cricket::IceRole ice_role,
-            const vector<string> &ignored_list);
+            const vector<string> &ignored_list,
+            unique_ptr<cricket::PortAllocator> port_allocator);
+
+        // A non zero candidate pool size starts gathering immediately, so it
+        // must be called on the network thread.
+        static unique_ptr<cricket::PortAllocator> CreatePortAllocator(
+            NetworkResources &net_resources,
+            rtc::Thread *network_thread,
+            rtc::NetworkManager *net_manager,
+            const VlinkDescriptor &vlink_desc,
+            int candidate_pool_size);
 
         PeerDescriptor &PeerInfo()
         {
@@ -88,8 +302,49 @@ namespace tincan
 
         bool IsReady();
 
+        // true once ICE and the DTLS handshake have completed at least once
+        bool HasConnected()
+        {
+            return connect_time_.count() != 0;
+        }
+
+        // A parked link can serve a new CreateLink only for the same peer in
+        // the same ICE role, asking for the same options, from a peer that
+        // kept its ICE credentials. It need not be writable, ICE recovers a
+        // link that flapped on the candidates sent with the request.
+        bool CanResume(
+            const PeerDescriptor &peer_desc,
+            const VlinkDescriptor &vlink_desc,
+            cricket::IceRole ice_role);
+
+        // marks a parked link as handed back to a new CreateLink request
+        void Resume();
+
+        bool IsResumed()
+        {
+            return resumed_;
+        }
+
         void Transmit(Iob&& frame);
 
+        bool EgressQueued() const
+        {
+            return egress_queued_;
+        }
+
+        // Queues a TAP frame for the network thread, callable from any thread.
+        void Enqueue(Iob&& frame);
+
+        // Shapes the egress to rate bits per second, 0 removes the limit.
+        void SetRate(
+            uint64_t rate,
+            size_t burst);
+
+        // sends the frames batched so far, called at the end of a TAP burst
+        void FlushBatch();
+
+        // safe to call from any thread, the candidates are read on the
+        // network thread that gathers them
         string Candidates();
 
         string PeerCandidates();
@@ -102,6 +357,10 @@ namespace tincan
         }
         void GetStats(Json::Value &infos);
 
+        void GetSetupInfo(Json::Value &setup_info);
+
+        void GetDatapathInfo(Json::Value &dp_info);
+
         cricket::IceRole IceRole()
         {
             return ice_role_;
@@ -119,16 +378,28 @@ namespace tincan
 
         void SetCasReadyId(uint64_t id) noexcept;
 
+        // Regenerates the local ICE credentials and gathers a new candidate
+        // generation on the live transport. Returns false when peer_cas only
+        // completes a restart that was started locally.
+        bool IceRestart(
+            const string &peer_cas,
+            uint64_t cas_ready_id);
+
         sigslot::signal1<string, single_threaded> SignalLinkUp;
         sigslot::signal1<string, single_threaded> SignalLinkDown;
         sigslot::signal2<uint64_t, string> SignalLocalCasReady;
+        sigslot::signal3<string, string, bool> SignalLocalCasUpdated;
         sigslot::signal2<const char *, size_t> SignalMessageReceived;
 
     private:
-        cricket::ServerAddresses SetupSTUN(
+        static cricket::ServerAddresses SetupSTUN(
+            NetworkResources &net_resources,
+            rtc::Thread *network_thread,
             vector<string> stun_servers);
 
-        vector<cricket::RelayServerConfig> SetupTURN(
+        static vector<cricket::RelayServerConfig> SetupTURN(
+            NetworkResources &net_resources,
+            rtc::Thread *network_thread,
             vector<TurnDescriptor>);
 
         void OnCandidatesGathered(
@@ -138,14 +409,142 @@ namespace tincan
         void OnGatheringState(
             cricket::IceGatheringState gather_state);
 
+        void OnGatherTimeout();
+
+        void ScheduleGatherTimeout();
+
+        void CompleteCasReady();
+
+        void OnNetworksChanged();
+
+        bool SelectedNetworkUp(
+            const cricket::Connection &conn);
+
+        void OnRecordReady(
+            uint8_t flags,
+            const char *data,
+            size_t len);
+
+        void ReceiveRecord(
+            const char *data,
+            size_t len);
+
+        void ProcessRecord(
+            const char *data,
+            size_t len);
+
+        void SendRecord(
+            const char *data,
+            size_t len);
+
+        void TransportSend(
+            const char *data,
+            size_t len);
+
+        void ScheduleFecFlush();
+
+        void DrainEgress();
+
+        void CreateEgressQueue();
+
+        uint8_t OuterDscp(
+            const Iob &frame) const;
+
+        void SetOuterDscp(
+            uint8_t dscp);
+
+        void ScheduleEgressDrain(
+            int delay_ms);
+
+        void OnReadyToSend(
+            PacketTransportInternal *transport);
+
+        void SendPing();
+
+        void SchedulePing();
+
+        void StartNative();
+
+        // closes the native socket and tells the peer
+        void StopNative();
+
+        void CloseNative();
+
+        void OnNativeOffer(
+            uint16_t port);
+
+        void ProbeNative();
+
+        void ScheduleNativeFlush();
+
+        void OnNativeReadyToSend();
+
+        void CheckNativeBlocked();
+
+        void SendCapabilities();
+
+        void OnCapabilities(
+            uint16_t caps,
+            bool has_ours);
+
+        void AdaptFec();
+
+        void DeliverFrame(
+            uint8_t flags,
+            const char *data,
+            size_t len);
+
+        unique_ptr<FrameCodec> MakeCodec();
+
+        void SendContextRequests();
+
+        size_t RecordLimit() const;
+
+        size_t BatchLimit() const;
+
+        void SendFragments(
+            uint8_t flags,
+            char *payload,
+            size_t payload_len);
+
+        void OnControlRecord(
+            const char *data,
+            size_t len);
+
+        void ProbePathMtu();
+
+        void RestartPathMtuSearch();
+
+        void ScheduleReorderFlush();
+
+        void ApplyStandbyConfig(
+            cricket::IceConfig &ic);
+
+        void OnCandidatePairChanged(
+            const cricket::CandidatePairChangeEvent &event);
+
+        void ApplyTransportDescriptions();
+
+        void SetRemoteCredentials(
+            const string &ufrag,
+            const string &pwd);
+
+        static bool CredentialsFromCas(
+            const string &cas,
+            string &ufrag,
+            string &pwd);
+
         void OnWriteableState(
             PacketTransportInternal *transport);
 
         void RegisterLinkEventHandlers();
 
-        void AddRemoteCandidates(
+        size_t AddRemoteCandidates(
             const string &candidates);
 
+        static string CandidatesToString(
+            const cricket::Candidates &candidates);
+
         void SetupICE(
             unique_ptr<SSLIdentity> sslid,
             unique_ptr<SSLFingerprint> local_fingerprint,
@@ -163,28 +562,159 @@ namespace tincan
             const SentPacket &packet);
 
         static const char kCandidateDelim = ':';
+        static const int kContinualGatherTimeout = 2000;
+        // a pair switch this long after the network went away is not timed
+        static const int kHandoverTimeout = 10000;
+        static const int kStandbyPingInterval = 1000;
+        static const int kStandbyUnwritableChecks = 3;
+        static const int kStandbyCheckInterval = 250;
+        static const size_t kReorderWindow = 64;
+        static const int64_t kReorderTimeout = 30;
+        // records up to this size are assumed to pass before any probing,
+        // it leaves room for DTLS, TURN and IPv6 overheads in 1280 bytes
+        static const size_t kBasePlpmtu = 1100;
+        static const size_t kRecordHeadroom = LinkRecord::kMaxHeaderSz + LinkRecord::kFragmentHeaderSz;
+        static const size_t kReassemblySlots = 4;
+        static const int64_t kReassemblyTimeout = 1000;
+        static const size_t kDefaultFecK = 8;
+        // a parity record adds a flags byte, the FEC header and a length
+        static const size_t kFecOverhead = 1 + LinkRecord::kFecHeaderSz + LinkRecord::kLenSz;
+        // a partly filled group is closed after this long
+        static const int kFecFlushDelay = 10;
+        static const int kFecAdaptInterval = 2000;
+        // fewer ping requests than this are not a loss sample
+        static const uint64_t kFecMinPings = 4;
+        // frames sent per network thread task, so reads are not held off
+        static const size_t kEgressDrainBudget = 64;
+        static const int kNativeProbeInterval = 1000;
+        // unanswered probes for this long and records go back to DTLS
+        static const int64_t kNativeTimeout = 3000;
+        // capabilities are resent until the peer's arrive
+        static const int kCapsInterval = 1000;
         const string kIceUfrag = {"+001EVIOICEUFRAG"};
         const string kIcePwd = {"+00000001EVIOICEPASSWORD"};
+        const string kNativeKeyLabel = {"EXTRACTOR-tincan-native"};
         unique_ptr<VlinkDescriptor> vlink_desc_;
         unique_ptr<PeerDescriptor> peer_desc_;
         cricket::Candidates local_candidates_;
+        cricket::Candidates remote_candidates_;
         cricket::IceRole ice_role_;
         ConnectionRole local_conn_role_;
         cricket::DtlsTransportInternal *dtls_transport_;
         unique_ptr<cricket::SessionDescription> local_description_;
         unique_ptr<cricket::SessionDescription> remote_description_;
+        unique_ptr<SSLFingerprint> local_fingerprint_;
         unique_ptr<SSLFingerprint> remote_fingerprint_;
         string content_name_;
-        const PacketOptions packet_options_;
+        PacketOptions packet_options_;
         JsepTransportController::Config config_;
         rtc::Thread *signaling_thread_;
         rtc::Thread *network_thread_;
         uint64_t cas_ready_id_;
+        bool gather_timed_out_;
+        // only the deadline of the latest gathering generation is acted on
+        uint32_t gather_gen_;
+        // the pending CAS request was answered, later candidates are pushed
+        bool cas_answered_;
+        bool pre_gathered_;
+        bool resumed_;
+        uint32_t resume_count_;
+        string local_ufrag_;
+        string local_pwd_;
+        string remote_ufrag_;
+        string remote_pwd_;
+        uint32_t ice_restarts_;
+        // local credentials changed, waiting on the peer's
+        bool restart_pending_;
+        bool restart_switch_pending_;
+        steady_clock::time_point restart_start_;
+        milliseconds restart_time_;
+        uint32_t network_changes_;
+        uint32_t handovers_;
+        // the selected pair's network went away and no pair replaced it yet
+        bool handover_pending_;
+        uint32_t handover_timer_id_;
+        steady_clock::time_point network_change_time_;
+        milliseconds handover_gap_;
+        uint32_t failovers_;
+        int64_t failover_time_;
+        // when the link last went unwritable, 0 while it is writable
+        int64_t unwritable_time_;
+        steady_clock::time_point setup_start_;
+        milliseconds cas_ready_time_;
+        milliseconds gather_time_;
+        milliseconds connect_time_;
         bool pa_init_;
-        rtc::BasicNetworkManager net_manager_;
+        shared_ptr<NetworkResources> net_resources_;
+        shared_ptr<rtc::BasicNetworkManager> net_manager_;
         unique_ptr<cricket::PortAllocator> port_allocator_;
         unique_ptr<webrtc::IceTransportFactory> ice_transport_factory_;
         unique_ptr<JsepTransportController> transport_ctlr_;
+        // owned by the ice transport, only set in multipath mode
+        MultipathTransportChannel *mp_channel_;
+        unique_ptr<ReorderBuffer> reorder_;
+        bool reorder_flush_pending_;
+        uint32_t tx_seq_;
+        uint64_t rx_malformed_;
+        // a record is assembled after kRecordHeadroom bytes of headroom, the
+        // header is written right aligned once its flags are known
+        array<char, kRecordHeadroom + LinkRecord::kLenSz +
+                        LinkRecord::kEncodingSz + Iob::kFrameBufferSz>
+            tx_record_;
+        array<char, Iob::kFrameBufferSz> rx_frame_;
+        unique_ptr<FrameCodec> codec_;
+        size_t batch_limit_;
+        size_t batch_len_;
+        size_t batch_frames_;
+        uint64_t tx_batches_;
+        uint64_t tx_batched_frames_;
+        unique_ptr<PathMtuProber> pmtu_;
+        uint32_t pmtu_timer_id_;
+        vector<char> probe_;
+        unique_ptr<FragmentBuffer> fragments_;
+        uint16_t tx_frag_id_;
+        uint64_t tx_fragmented_;
+        uint64_t tx_fragments_;
+        unique_ptr<FecEncoder> fec_tx_;
+        unique_ptr<FecDecoder> fec_rx_;
+        uint32_t fec_timer_id_;
+        bool fec_adapt_pending_;
+        // smoothed loss of the ICE checks on the selected pair
+        double path_loss_;
+        uint64_t pings_sent_;
+        uint64_t pings_answered_;
+        uint64_t rx_injected_drops_;
+        unique_ptr<FqCodelQueue> egress_queue_;
+        // set once egress_queue_ exists, the TAP thread reads it
+        atomic_bool egress_queued_;
+        TokenBucket shaper_;
+        std::atomic<bool> drain_pending_;
+        // the transport refused a send, draining waits for it to be ready
+        bool tx_blocked_;
+        uint64_t tx_blocked_count_;
+        vector<Iob> drained_;
+        // the outer DSCP of the batch being built and of the transport
+        uint8_t batch_dscp_;
+        uint8_t tx_dscp_;
+        uint64_t dscp_changes_;
+        unique_ptr<BbrController> cc_;
+        TokenBucket pacer_;
+        bool ping_pending_;
+        // bytes of the data records received, echoed in the feedback
+        uint32_t rx_bytes_;
+        // kept across native sockets so a sequence number is never reused
+        unique_ptr<NativeCrypto> native_crypto_;
+        unique_ptr<NativeChannel> native_;
+        // the native path answers probes, records are sent on it
+        bool native_tx_;
+        uint16_t native_probe_id_;
+        int64_t native_ack_ms_;
+        uint32_t native_timer_id_;
+        bool native_flush_pending_;
+        uint64_t native_fallbacks_;
+        bool peer_caps_known_;
+        uint16_t peer_caps_;
+        uint32_t caps_timer_id_;
     };
 } // namespace tincan
 #endif // !TINCAN_VIRTUAL_LINK_H_